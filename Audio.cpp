@@ -0,0 +1,762 @@
+#include "Audio.h"
+
+#include <assert.h>
+#include <cstring>
+
+#include "Memory.h"
+#include "Cpu.h"
+
+
+namespace
+{
+    constexpr byte LENGTH_TABLE[ 32 ] =
+    {
+        10, 254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
+        12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+    };
+
+    constexpr byte DUTY_TABLE[ 4 ][ 8 ] =
+    {
+        { 0, 1, 0, 0, 0, 0, 0, 0 },
+        { 0, 1, 1, 0, 0, 0, 0, 0 },
+        { 0, 1, 1, 1, 1, 0, 0, 0 },
+        { 1, 0, 0, 1, 1, 1, 1, 1 },
+    };
+
+    constexpr byte TRIANGLE_SEQUENCE[ 32 ] =
+    {
+        15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+         0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15
+    };
+
+    /* NTSC periods in CPU cycles */
+    constexpr word NOISE_PERIOD_TABLE[ 16 ] = { 4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068 };
+    constexpr word DMC_RATE_TABLE[ 16 ] = { 428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54 };
+
+    /* Frame counter steps in CPU cycles since the frame counter was reset */
+    constexpr u32 FOUR_STEP_SEQUENCE[ 4 ] = { 7457, 14913, 22371, 29829 };
+    constexpr u32 FIVE_STEP_SEQUENCE[ 5 ] = { 7457, 14913, 22371, 29829, 37281 };
+
+    /*
+        Linear approximation of the mixer so every channel can report its own deltas:
+        pulse 0.00752, triangle 0.00851, noise 0.00494 and DMC 0.00335 of full scale per step
+     */
+    constexpr i32 FULL_SCALE        = 30000;
+    constexpr i32 PULSE_VOLUME      = static_cast< i32 >( 0.00752 * FULL_SCALE );
+    constexpr i32 TRIANGLE_VOLUME   = static_cast< i32 >( 0.00851 * FULL_SCALE );
+    constexpr i32 NOISE_VOLUME      = static_cast< i32 >( 0.00494 * FULL_SCALE );
+    constexpr i32 DMC_VOLUME        = static_cast< i32 >( 0.00335 * FULL_SCALE );
+
+    /* Enough room for a few frames in case the host doesn't read every frame */
+    constexpr u32 BLIP_BUFFER_MILLISECONDS = 100;
+}
+
+
+Audio::Audio()
+    : memory( nullptr )
+    , cpu( nullptr )
+    , blipBuffer( SAMPLE_RATE, BLIP_BUFFER_MILLISECONDS )
+    , rateAdjustment( 1.0 )
+{
+    blipBuffer.SetRates( CPU_CLOCK_RATE, SAMPLE_RATE );
+    Reset();
+}
+
+void Audio::Init( Memory *memorySystem, Cpu *cpuSystem )
+{
+    memory = memorySystem;
+    cpu = cpuSystem;
+}
+
+void Audio::Reset()
+{
+    memset( pulses, 0x00, sizeof( pulses ) );
+    memset( &triangle, 0x00, sizeof( triangle ) );
+    memset( &noise, 0x00, sizeof( noise ) );
+    memset( &dmc, 0x00, sizeof( dmc ) );
+
+    pulses[ 0 ].onesComplementSweep = true;
+    noise.shiftRegister = 0x0001;
+    noise.timerPeriod = NOISE_PERIOD_TABLE[ 0 ];
+    dmc.timerPeriod = DMC_RATE_TABLE[ 0 ];
+    dmc.bitsRemaining = 8;
+    dmc.silence = true;
+    dmc.currentAddress = 0xC000;
+
+    fiveStepMode = false;
+    irqInhibit = false;
+    frameIrqFlag = false;
+
+    currentTime = 0u;
+    renderedTime = 0u;
+    ScheduleFrameCounter( 0u );
+
+    blipBuffer.Clear();
+}
+
+void Audio::EndFrame()
+{
+    CatchUp();
+
+    /* Rebase every timestamp on the start of the next frame */
+    const u32 frameLength = currentTime;
+    for ( Pulse &pulse : pulses )
+    {
+        pulse.nextClock -= frameLength;
+    }
+    triangle.nextClock -= frameLength;
+    noise.nextClock -= frameLength;
+    dmc.nextClock -= frameLength;
+    nextFrameCounterClock -= frameLength;
+
+    currentTime = 0u;
+    renderedTime = 0u;
+
+    /* Drop the oldest samples if nobody has been reading them */
+    const u32 samplesPerFrame = ( frameLength * SAMPLE_RATE ) / CPU_CLOCK_RATE + 1;
+    if ( blipBuffer.GetSamplesAvailable() + samplesPerFrame * 2 > blipBuffer.GetCapacity() )
+    {
+        blipBuffer.RemoveSamples( samplesPerFrame * 2 );
+    }
+
+    blipBuffer.EndFrame( frameLength );
+
+    /* The deltas of a frame are placed with the rate the frame ends with, it only changes in between */
+    blipBuffer.SetRates( CPU_CLOCK_RATE, SAMPLE_RATE * rateAdjustment );
+}
+
+u32 Audio::GetSamplesAvailable() const
+{
+    return blipBuffer.GetSamplesAvailable();
+}
+
+u32 Audio::ReadSamples( i16 *samples, u32 count )
+{
+    return blipBuffer.ReadSamples( samples, count );
+}
+
+void Audio::SetRateAdjustment( r64 adjustment )
+{
+    rateAdjustment = adjustment;
+}
+
+bool Audio::IsIrqPending() const
+{
+    return frameIrqFlag || dmc.irqFlag;
+}
+
+
+/* ------------------- REGISTERS -------------------*/
+
+byte Audio::ReadStatus()
+{
+    CatchUp();
+
+    byte status = 0x00;
+    status |= ( pulses[ 0 ].lengthCounter > 0 ) ? 0b0000'0001 : 0x00;
+    status |= ( pulses[ 1 ].lengthCounter > 0 ) ? 0b0000'0010 : 0x00;
+    status |= ( triangle.lengthCounter > 0 )    ? 0b0000'0100 : 0x00;
+    status |= ( noise.lengthCounter > 0 )       ? 0b0000'1000 : 0x00;
+    status |= ( dmc.bytesRemaining > 0 )        ? 0b0001'0000 : 0x00;
+    status |= frameIrqFlag                      ? 0b0100'0000 : 0x00;
+    status |= dmc.irqFlag                       ? 0b1000'0000 : 0x00;
+
+    /* Reading the status acknowledges the frame interrupt */
+    frameIrqFlag = false;
+    cpu->SetIrqLine( Cpu::InterruptLine::ApuIrq, IsIrqPending() );
+
+    return status;
+}
+
+void Audio::WriteRegister( word address, byte data )
+{
+    CatchUp();
+
+    switch ( address )
+    {
+        case 0x4000: case 0x4001: case 0x4002: case 0x4003:
+        {
+            WritePulseRegister( pulses[ 0 ], address - 0x4000, data );
+            UpdatePulseOutput( pulses[ 0 ], currentTime );
+        }
+        break;
+
+        case 0x4004: case 0x4005: case 0x4006: case 0x4007:
+        {
+            WritePulseRegister( pulses[ 1 ], address - 0x4004, data );
+            UpdatePulseOutput( pulses[ 1 ], currentTime );
+        }
+        break;
+
+        case 0x4008:
+        {
+            triangle.control = ( data & 0b1000'0000 ) != 0;
+            triangle.linearCounterPeriod = data & 0b0111'1111;
+        }
+        break;
+
+        case 0x400A:
+        {
+            triangle.timerPeriod = ( triangle.timerPeriod & 0x0700 ) | data;
+        }
+        break;
+
+        case 0x400B:
+        {
+            triangle.timerPeriod = ( triangle.timerPeriod & 0x00FF ) | ( ( data & 0b0000'0111 ) << 8 );
+            if ( triangle.enabled )
+            {
+                triangle.lengthCounter = LENGTH_TABLE[ data >> 3 ];
+            }
+            triangle.linearCounterReload = true;
+        }
+        break;
+
+        case 0x400C:
+        {
+            noise.lengthHalt = ( data & 0b0010'0000 ) != 0;
+            noise.envelope.loop = noise.lengthHalt;
+            noise.envelope.constantVolume = ( data & 0b0001'0000 ) != 0;
+            noise.envelope.period = data & 0b0000'1111;
+            UpdateNoiseOutput( currentTime );
+        }
+        break;
+
+        case 0x400E:
+        {
+            noise.shortMode = ( data & 0b1000'0000 ) != 0;
+            noise.timerPeriod = NOISE_PERIOD_TABLE[ data & 0b0000'1111 ];
+        }
+        break;
+
+        case 0x400F:
+        {
+            if ( noise.enabled )
+            {
+                noise.lengthCounter = LENGTH_TABLE[ data >> 3 ];
+            }
+            noise.envelope.start = true;
+            UpdateNoiseOutput( currentTime );
+        }
+        break;
+
+        case 0x4010:
+        {
+            dmc.irqEnabled = ( data & 0b1000'0000 ) != 0;
+            dmc.loop = ( data & 0b0100'0000 ) != 0;
+            dmc.timerPeriod = DMC_RATE_TABLE[ data & 0b0000'1111 ];
+            if ( !dmc.irqEnabled )
+            {
+                dmc.irqFlag = false;
+            }
+        }
+        break;
+
+        case DMC_LOAD_REGISTER:
+        {
+            dmc.outputLevel = data & 0b0111'1111;
+            UpdateOutput( dmc.output, dmc.outputLevel * DMC_VOLUME, currentTime );
+        }
+        break;
+
+        case 0x4012:
+        {
+            dmc.sampleAddress = 0xC000 + ( data << 6 );
+        }
+        break;
+
+        case LAST_CHANNEL_REGISTER:
+        {
+            dmc.sampleLength = ( data << 4 ) + 1;
+        }
+        break;
+
+        case STATUS_REGISTER:
+        {
+            pulses[ 0 ].enabled = ( data & 0b0000'0001 ) != 0;
+            pulses[ 1 ].enabled = ( data & 0b0000'0010 ) != 0;
+            triangle.enabled = ( data & 0b0000'0100 ) != 0;
+            noise.enabled = ( data & 0b0000'1000 ) != 0;
+
+            for ( Pulse &pulse : pulses )
+            {
+                if ( !pulse.enabled )
+                {
+                    pulse.lengthCounter = 0;
+                    UpdatePulseOutput( pulse, currentTime );
+                }
+            }
+            triangle.lengthCounter = triangle.enabled ? triangle.lengthCounter : 0;
+            if ( !noise.enabled )
+            {
+                noise.lengthCounter = 0;
+                UpdateNoiseOutput( currentTime );
+            }
+
+            dmc.irqFlag = false;
+            if ( ( data & 0b0001'0000 ) == 0 )
+            {
+                dmc.bytesRemaining = 0;
+            }
+            else if ( dmc.bytesRemaining == 0 )
+            {
+                dmc.currentAddress = dmc.sampleAddress;
+                dmc.bytesRemaining = dmc.sampleLength;
+                FillDmcSampleBuffer();
+            }
+        }
+        break;
+
+        case FRAME_COUNTER_REGISTER:
+        {
+            fiveStepMode = ( data & 0b1000'0000 ) != 0;
+            irqInhibit = ( data & 0b0100'0000 ) != 0;
+            if ( irqInhibit )
+            {
+                frameIrqFlag = false;
+            }
+
+            /* Entering the 5 step mode clocks every unit immediately */
+            if ( fiveStepMode )
+            {
+                ClockQuarterFrame();
+                ClockHalfFrame();
+            }
+            ScheduleFrameCounter( currentTime );
+        }
+        break;
+
+        default:
+        {
+            // 0x4009 and 0x400D are unused
+        }
+    }
+
+    /* $4010, $4015 and $4017 can acknowledge interrupts */
+    cpu->SetIrqLine( Cpu::InterruptLine::ApuIrq, IsIrqPending() );
+}
+
+void Audio::WritePulseRegister( Pulse &pulse, word reg, byte data )
+{
+    switch ( reg )
+    {
+        case 0:
+        {
+            pulse.duty = data >> 6;
+            pulse.lengthHalt = ( data & 0b0010'0000 ) != 0;
+            pulse.envelope.loop = pulse.lengthHalt;
+            pulse.envelope.constantVolume = ( data & 0b0001'0000 ) != 0;
+            pulse.envelope.period = data & 0b0000'1111;
+        }
+        break;
+
+        case 1:
+        {
+            pulse.sweepEnabled = ( data & 0b1000'0000 ) != 0;
+            pulse.sweepPeriod = ( data & 0b0111'0000 ) >> 4;
+            pulse.sweepNegate = ( data & 0b0000'1000 ) != 0;
+            pulse.sweepShift = data & 0b0000'0111;
+            pulse.sweepReload = true;
+        }
+        break;
+
+        case 2:
+        {
+            pulse.timerPeriod = ( pulse.timerPeriod & 0x0700 ) | data;
+        }
+        break;
+
+        case 3:
+        {
+            pulse.timerPeriod = ( pulse.timerPeriod & 0x00FF ) | ( ( data & 0b0000'0111 ) << 8 );
+            if ( pulse.enabled )
+            {
+                pulse.lengthCounter = LENGTH_TABLE[ data >> 3 ];
+            }
+            pulse.dutyStep = 0;
+            pulse.envelope.start = true;
+        }
+        break;
+    }
+}
+
+
+/* ------------------- SYNTHESIS -------------------*/
+
+void Audio::CatchUp()
+{
+    assert( cpu != nullptr );
+
+    /* The DMC interrupt is only noticed here, so it may be late by up to a quarter of a frame */
+    RunUntil( currentTime );
+    cpu->SetIrqLine( Cpu::InterruptLine::ApuIrq, IsIrqPending() );
+}
+
+void Audio::RunUntil( u32 time )
+{
+    /* Channels only change their volume on frame counter clocks, run them in segments between those */
+    while ( renderedTime < time )
+    {
+        const u32 segmentEnd = ( nextFrameCounterClock < time ) ? nextFrameCounterClock : time;
+
+        RunPulse( pulses[ 0 ], segmentEnd );
+        RunPulse( pulses[ 1 ], segmentEnd );
+        RunTriangle( segmentEnd );
+        RunNoise( segmentEnd );
+        RunDmc( segmentEnd );
+        renderedTime = segmentEnd;
+
+        if ( renderedTime == nextFrameCounterClock )
+        {
+            ClockFrameCounter();
+        }
+    }
+}
+
+void Audio::UpdateOutput( i32 &output, i32 newOutput, u32 time )
+{
+    if ( newOutput != output )
+    {
+        blipBuffer.AddDelta( time, newOutput - output );
+        output = newOutput;
+    }
+}
+
+void Audio::RunPulse( Pulse &pulse, u32 endTime )
+{
+    /* The pulse timer is clocked every other CPU cycle */
+    const u32 period = ( pulse.timerPeriod + 1u ) * 2u;
+
+    if ( pulse.nextClock < renderedTime )
+    {
+        pulse.nextClock = renderedTime;
+    }
+
+    if ( pulse.IsMuted() )
+    {
+        /* Nothing is heard, just keep the sequencer in phase */
+        if ( pulse.nextClock < endTime )
+        {
+            const u32 clocks = ( endTime - pulse.nextClock + period - 1 ) / period;
+            pulse.dutyStep = ( pulse.dutyStep + clocks ) & 0b0000'0111;
+            pulse.nextClock += clocks * period;
+        }
+        UpdateOutput( pulse.output, 0, renderedTime );
+        return;
+    }
+
+    const i32 volume = pulse.envelope.GetVolume() * PULSE_VOLUME;
+    const byte *duty = DUTY_TABLE[ pulse.duty ];
+    UpdateOutput( pulse.output, duty[ pulse.dutyStep ] * volume, renderedTime );
+
+    for ( ; pulse.nextClock < endTime; pulse.nextClock += period )
+    {
+        pulse.dutyStep = ( pulse.dutyStep + 1 ) & 0b0000'0111;
+        UpdateOutput( pulse.output, duty[ pulse.dutyStep ] * volume, pulse.nextClock );
+    }
+}
+
+void Audio::RunTriangle( u32 endTime )
+{
+    const u32 period = triangle.timerPeriod + 1u;
+
+    if ( triangle.nextClock < renderedTime )
+    {
+        triangle.nextClock = renderedTime;
+    }
+
+    /* Ultrasonic periods are silenced like most emulators do instead of producing aliasing */
+    const bool isHalted = triangle.lengthCounter == 0 || triangle.linearCounter == 0 || triangle.timerPeriod < 2;
+    if ( isHalted )
+    {
+        if ( triangle.nextClock < endTime )
+        {
+            triangle.nextClock += ( ( endTime - triangle.nextClock + period - 1 ) / period ) * period;
+        }
+        return;
+    }
+
+    for ( ; triangle.nextClock < endTime; triangle.nextClock += period )
+    {
+        triangle.step = ( triangle.step + 1 ) & 0b0001'1111;
+        UpdateOutput( triangle.output, TRIANGLE_SEQUENCE[ triangle.step ] * TRIANGLE_VOLUME, triangle.nextClock );
+    }
+}
+
+void Audio::RunNoise( u32 endTime )
+{
+    const u32 period = noise.timerPeriod;
+
+    if ( noise.nextClock < renderedTime )
+    {
+        noise.nextClock = renderedTime;
+    }
+
+    const i32 volume = ( noise.lengthCounter > 0 ) ? noise.envelope.GetVolume() * NOISE_VOLUME : 0;
+    if ( volume == 0 )
+    {
+        /* The phase of the random sequence can't be heard, don't clock it every 4 cycles while silent */
+        if ( noise.nextClock < endTime )
+        {
+            noise.nextClock += ( ( endTime - noise.nextClock + period - 1 ) / period ) * period;
+        }
+        UpdateOutput( noise.output, 0, renderedTime );
+        return;
+    }
+
+    const byte feedbackBit = noise.shortMode ? 6 : 1;
+
+    for ( ; noise.nextClock < endTime; noise.nextClock += period )
+    {
+        const word feedback = ( noise.shiftRegister ^ ( noise.shiftRegister >> feedbackBit ) ) & 0x0001;
+        noise.shiftRegister = ( noise.shiftRegister >> 1 ) | ( feedback << 14 );
+        UpdateOutput( noise.output, ( noise.shiftRegister & 0x0001 ) ? 0 : volume, noise.nextClock );
+    }
+}
+
+void Audio::RunDmc( u32 endTime )
+{
+    const u32 period = dmc.timerPeriod;
+
+    if ( dmc.nextClock < renderedTime )
+    {
+        dmc.nextClock = renderedTime;
+    }
+
+    for ( ; dmc.nextClock < endTime; dmc.nextClock += period )
+    {
+        if ( !dmc.silence )
+        {
+            if ( dmc.shiftRegister & 0x01 )
+            {
+                dmc.outputLevel = ( dmc.outputLevel <= 125 ) ? dmc.outputLevel + 2 : dmc.outputLevel;
+            }
+            else
+            {
+                dmc.outputLevel = ( dmc.outputLevel >= 2 ) ? dmc.outputLevel - 2 : dmc.outputLevel;
+            }
+            UpdateOutput( dmc.output, dmc.outputLevel * DMC_VOLUME, dmc.nextClock );
+        }
+
+        dmc.shiftRegister >>= 1;
+        if ( --dmc.bitsRemaining == 0 )
+        {
+            dmc.bitsRemaining = 8;
+            dmc.silence = !dmc.sampleBufferFull;
+            if ( dmc.sampleBufferFull )
+            {
+                dmc.shiftRegister = dmc.sampleBuffer;
+                dmc.sampleBufferFull = false;
+                FillDmcSampleBuffer();
+            }
+        }
+    }
+}
+
+void Audio::FillDmcSampleBuffer()
+{
+    if ( dmc.sampleBufferFull || dmc.bytesRemaining == 0 )
+    {
+        return;
+    }
+
+    /* Memory stalls the CPU for the fetch */
+    assert( memory != nullptr );
+    dmc.sampleBuffer = memory->ReadDmcSample( dmc.currentAddress );
+    dmc.sampleBufferFull = true;
+    dmc.currentAddress = ( dmc.currentAddress == 0xFFFF ) ? 0x8000 : dmc.currentAddress + 1;
+
+    if ( --dmc.bytesRemaining == 0 )
+    {
+        if ( dmc.loop )
+        {
+            dmc.currentAddress = dmc.sampleAddress;
+            dmc.bytesRemaining = dmc.sampleLength;
+        }
+        else if ( dmc.irqEnabled )
+        {
+            dmc.irqFlag = true;
+        }
+    }
+}
+
+void Audio::UpdatePulseOutput( Pulse &pulse, u32 time )
+{
+    const i32 volume = pulse.IsMuted() ? 0 : pulse.envelope.GetVolume() * PULSE_VOLUME;
+    UpdateOutput( pulse.output, DUTY_TABLE[ pulse.duty ][ pulse.dutyStep ] * volume, time );
+}
+
+void Audio::UpdateNoiseOutput( u32 time )
+{
+    const i32 volume = ( noise.lengthCounter > 0 ) ? noise.envelope.GetVolume() * NOISE_VOLUME : 0;
+    UpdateOutput( noise.output, ( noise.shiftRegister & 0x0001 ) ? 0 : volume, time );
+}
+
+
+/* ------------------- FRAME COUNTER -------------------*/
+
+void Audio::ScheduleFrameCounter( u32 fromTime )
+{
+    frameCounterStep = 0;
+    nextFrameCounterClock = fromTime + FOUR_STEP_SEQUENCE[ 0 ];
+}
+
+void Audio::ClockFrameCounter()
+{
+    const u32 *sequence = fiveStepMode ? FIVE_STEP_SEQUENCE : FOUR_STEP_SEQUENCE;
+    const u32 stepCount = fiveStepMode ? 5 : 4;
+    const u32 sequenceStart = nextFrameCounterClock - sequence[ frameCounterStep ];
+
+    if ( fiveStepMode )
+    {
+        /* 5 step: Q, Q+H, Q, -, Q+H */
+        if ( frameCounterStep != 3 )
+        {
+            ClockQuarterFrame();
+        }
+        if ( frameCounterStep == 1 || frameCounterStep == 4 )
+        {
+            ClockHalfFrame();
+        }
+    }
+    else
+    {
+        /* 4 step: Q, Q+H, Q, Q+H+IRQ */
+        ClockQuarterFrame();
+        if ( frameCounterStep == 1 || frameCounterStep == 3 )
+        {
+            ClockHalfFrame();
+        }
+        if ( frameCounterStep == 3 && !irqInhibit )
+        {
+            frameIrqFlag = true;
+        }
+    }
+
+    /* The sequence restarts one cycle after its last step */
+    ++frameCounterStep;
+    u32 nextSequenceStart = sequenceStart;
+    if ( frameCounterStep == stepCount )
+    {
+        frameCounterStep = 0;
+        nextSequenceStart = sequenceStart + sequence[ stepCount - 1 ] + 1;
+    }
+    nextFrameCounterClock = nextSequenceStart + sequence[ frameCounterStep ];
+
+    /* Volumes may have changed */
+    UpdatePulseOutput( pulses[ 0 ], renderedTime );
+    UpdatePulseOutput( pulses[ 1 ], renderedTime );
+    UpdateNoiseOutput( renderedTime );
+}
+
+void Audio::ClockQuarterFrame()
+{
+    pulses[ 0 ].envelope.Clock();
+    pulses[ 1 ].envelope.Clock();
+    noise.envelope.Clock();
+
+    if ( triangle.linearCounterReload )
+    {
+        triangle.linearCounter = triangle.linearCounterPeriod;
+    }
+    else if ( triangle.linearCounter > 0 )
+    {
+        --triangle.linearCounter;
+    }
+
+    if ( !triangle.control )
+    {
+        triangle.linearCounterReload = false;
+    }
+}
+
+void Audio::ClockHalfFrame()
+{
+    for ( Pulse &pulse : pulses )
+    {
+        if ( !pulse.lengthHalt && pulse.lengthCounter > 0 )
+        {
+            --pulse.lengthCounter;
+        }
+        pulse.ClockSweep();
+    }
+
+    if ( !triangle.control && triangle.lengthCounter > 0 )
+    {
+        --triangle.lengthCounter;
+    }
+
+    if ( !noise.lengthHalt && noise.lengthCounter > 0 )
+    {
+        --noise.lengthCounter;
+    }
+}
+
+
+/* ------------------- UNITS -------------------*/
+
+void Audio::Envelope::Clock()
+{
+    if ( start )
+    {
+        start = false;
+        decay = 15;
+        divider = period;
+    }
+    else if ( divider == 0 )
+    {
+        divider = period;
+        if ( decay > 0 )
+        {
+            --decay;
+        }
+        else if ( loop )
+        {
+            decay = 15;
+        }
+    }
+    else
+    {
+        --divider;
+    }
+}
+
+byte Audio::Envelope::GetVolume() const
+{
+    return constantVolume ? period : decay;
+}
+
+word Audio::Pulse::GetSweepTarget() const
+{
+    const word change = timerPeriod >> sweepShift;
+    if ( sweepNegate )
+    {
+        /* Pulse 1 adds the ones' complement, pulse 2 the two's complement */
+        const word negatedChange = onesComplementSweep ? change + 1 : change;
+        return ( negatedChange > timerPeriod ) ? 0 : timerPeriod - negatedChange;
+    }
+    return timerPeriod + change;
+}
+
+bool Audio::Pulse::IsMuted() const
+{
+    return lengthCounter == 0 || timerPeriod < 8 || GetSweepTarget() > 0x07FF;
+}
+
+void Audio::Pulse::ClockSweep()
+{
+    if ( sweepDivider == 0 && sweepEnabled && sweepShift > 0 && !IsMuted() )
+    {
+        timerPeriod = GetSweepTarget();
+    }
+
+    if ( sweepDivider == 0 || sweepReload )
+    {
+        sweepDivider = sweepPeriod;
+        sweepReload = false;
+    }
+    else
+    {
+        --sweepDivider;
+    }
+}
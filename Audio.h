@@ -0,0 +1,219 @@
+#pragma once
+
+#include "Types.h"
+#include "BlipBuffer.h"
+
+
+/*
+
+    +---------------------------------------------------+
+    |                                                   |
+    |  APU registers                                    |
+    +---------------------+-----------------------------+
+    |                     |                             |
+    |  0x4000 - 0x4003    |  Pulse 1                    |
+    |                     |                             |
+    |  0x4004 - 0x4007    |  Pulse 2                    |
+    |                     |                             |
+    |  0x4008 - 0x400B    |  Triangle                   |
+    |                     |                             |
+    |  0x400C - 0x400F    |  Noise                      |
+    |                     |                             |
+    |  0x4010 - 0x4013    |  DMC                        |
+    |                     |                             |
+    |  0x4015             |  Channel enable / status    |
+    |                     |                             |
+    |  0x4017             |  Frame counter              |
+    |                     |                             |
+    +---------------------+-----------------------------+
+
+    The APU runs lazily: Update() only accounts the CPU cycles and the channels catch up when a
+    register is accessed, the frame counter is clocked or the frame ends. Channels don't tick every cycle, they jump from one
+    timer reload to the next and report their output changes to the BlipBuffer, which produces
+    the 48KHz samples once per frame.
+
+*/
+
+
+class Memory;
+class Cpu;
+
+class Audio
+{
+public:
+
+    static constexpr u32 CPU_CLOCK_RATE                 = 1789773;
+    static constexpr u32 SAMPLE_RATE                    = 48000;
+
+    /* APU register addresses */
+    static constexpr word PULSE_1_CONTROL_REGISTER      = 0x4000;
+    static constexpr word DMC_LOAD_REGISTER             = 0x4011;
+    static constexpr word LAST_CHANNEL_REGISTER         = 0x4013;
+    static constexpr word STATUS_REGISTER               = 0x4015;
+    static constexpr word FRAME_COUNTER_REGISTER        = 0x4017;
+
+
+    Audio();
+
+    void Init( Memory *memorySystem, Cpu *cpuSystem );
+    void Reset();
+
+    /* Accounts the CPU cycles executed since the last call */
+    void Update( u32 cycles );
+
+    /* Closes the current audio frame and makes its samples available */
+    void EndFrame();
+
+    /* CPU side */
+    byte ReadStatus();
+    void WriteRegister( word address, byte data );
+    bool IsIrqPending() const;
+
+    /* Host side, signed 16 bit mono samples at SAMPLE_RATE */
+    u32 GetSamplesAvailable() const;
+    u32 ReadSamples( i16 *samples, u32 count );
+
+    /* Scales the output rate from the next frame on, used to follow the audio device clock. The current frame keeps its rate */
+    void SetRateAdjustment( r64 adjustment );
+
+private:
+
+    struct Envelope
+    {
+        bool    start;
+        bool    loop;
+        bool    constantVolume;
+        byte    period;
+        byte    divider;
+        byte    decay;
+
+        void Clock();
+        byte GetVolume() const;
+    };
+
+    struct Pulse
+    {
+        Envelope    envelope;
+        bool        enabled;
+        bool        lengthHalt;
+        byte        lengthCounter;
+        byte        duty;
+        byte        dutyStep;
+        bool        sweepEnabled;
+        bool        sweepNegate;
+        bool        sweepReload;
+        byte        sweepPeriod;
+        byte        sweepShift;
+        byte        sweepDivider;
+        word        timerPeriod;
+        u32         nextClock;
+        i32         output;
+        bool        onesComplementSweep;
+
+        word GetSweepTarget() const;
+        bool IsMuted() const;
+        void ClockSweep();
+    };
+
+    struct Triangle
+    {
+        bool        enabled;
+        bool        control;
+        byte        lengthCounter;
+        byte        linearCounterPeriod;
+        byte        linearCounter;
+        bool        linearCounterReload;
+        byte        step;
+        word        timerPeriod;
+        u32         nextClock;
+        i32         output;
+    };
+
+    struct Noise
+    {
+        Envelope    envelope;
+        bool        enabled;
+        bool        lengthHalt;
+        byte        lengthCounter;
+        bool        shortMode;
+        word        shiftRegister;
+        word        timerPeriod;
+        u32         nextClock;
+        i32         output;
+    };
+
+    struct Dmc
+    {
+        bool        irqEnabled;
+        bool        loop;
+        bool        irqFlag;
+        word        timerPeriod;
+        u32         nextClock;
+        byte        outputLevel;
+        word        sampleAddress;
+        word        sampleLength;
+        word        currentAddress;
+        word        bytesRemaining;
+        byte        sampleBuffer;
+        bool        sampleBufferFull;
+        byte        shiftRegister;
+        byte        bitsRemaining;
+        bool        silence;
+        i32         output;
+    };
+
+    /* Associated Systems */
+    Memory          *memory;
+    Cpu             *cpu;
+
+    /* Channels */
+    Pulse           pulses[ 2 ];
+    Triangle        triangle;
+    Noise           noise;
+    Dmc             dmc;
+
+    /* Frame counter */
+    bool            fiveStepMode;
+    bool            irqInhibit;
+    bool            frameIrqFlag;
+    u32             frameCounterStep;
+    u32             nextFrameCounterClock;
+
+    /* Time in CPU cycles since the start of the audio frame */
+    u32             currentTime;
+    u32             renderedTime;
+
+    BlipBuffer      blipBuffer;
+    r64             rateAdjustment;
+
+    void RunUntil( u32 time );
+    void CatchUp();
+    void RunPulse( Pulse &pulse, u32 endTime );
+    void RunTriangle( u32 endTime );
+    void RunNoise( u32 endTime );
+    void RunDmc( u32 endTime );
+
+    void ClockFrameCounter();
+    void ClockQuarterFrame();
+    void ClockHalfFrame();
+    void ScheduleFrameCounter( u32 fromTime );
+
+    void UpdateOutput( i32 &output, i32 newOutput, u32 time );
+    void UpdatePulseOutput( Pulse &pulse, u32 time );
+    void UpdateNoiseOutput( u32 time );
+    void FillDmcSampleBuffer();
+
+    void WritePulseRegister( Pulse &pulse, word reg, byte data );
+};
+
+
+inline void Audio::Update( u32 cycles )
+{
+    currentTime += cycles;
+
+    /* Only the frame counter can raise an interrupt on its own, catch up when it is clocked */
+    if ( currentTime >= nextFrameCounterClock )
+    {
+        CatchUp();
+    }
+}
@@ -0,0 +1,89 @@
+#include "AudioRing.h"
+
+#include <cstring>
+
+
+namespace
+{
+    u32 RoundUpToPowerOfTwo( u32 value )
+    {
+        u32 powerOfTwo = 1u;
+        while ( powerOfTwo < value )
+        {
+            powerOfTwo <<= 1;
+        }
+        return powerOfTwo;
+    }
+}
+
+
+AudioRing::AudioRing( u32 capacity )
+    : samples( RoundUpToPowerOfTwo( capacity ), 0 )
+    , mask( static_cast< u32 >( samples.size() ) - 1 )
+    , lastSample( 0 )
+    , writeIndex( 0u )
+    , readIndex( 0u )
+{
+}
+
+u32 AudioRing::Write( const i16 *data, u32 count )
+{
+    const u32 write = writeIndex.load( std::memory_order_relaxed );
+    const u32 read = readIndex.load( std::memory_order_acquire );
+
+    const u32 freeSpace = GetCapacity() - ( write - read );
+    count = ( count < freeSpace ) ? count : freeSpace;
+
+    /* Copy in at most two pieces when the ring wraps */
+    const u32 start = write & mask;
+    const u32 firstPart = ( count < GetCapacity() - start ) ? count : GetCapacity() - start;
+    memcpy( &samples[ start ], data, firstPart * sizeof( i16 ) );
+    memcpy( &samples[ 0 ], data + firstPart, ( count - firstPart ) * sizeof( i16 ) );
+
+    writeIndex.store( write + count, std::memory_order_release );
+    return count;
+}
+
+u32 AudioRing::Read( i16 *data, u32 count )
+{
+    const u32 read = readIndex.load( std::memory_order_relaxed );
+    const u32 write = writeIndex.load( std::memory_order_acquire );
+
+    const u32 available = write - read;
+    const u32 readCount = ( count < available ) ? count : available;
+
+    const u32 start = read & mask;
+    const u32 firstPart = ( readCount < GetCapacity() - start ) ? readCount : GetCapacity() - start;
+    memcpy( data, &samples[ start ], firstPart * sizeof( i16 ) );
+    memcpy( data + firstPart, &samples[ 0 ], ( readCount - firstPart ) * sizeof( i16 ) );
+
+    readIndex.store( read + readCount, std::memory_order_release );
+
+    if ( readCount > 0 )
+    {
+        lastSample = data[ readCount - 1 ];
+    }
+    for ( u32 i = readCount; i < count; ++i )
+    {
+        data[ i ] = lastSample;
+    }
+
+    return readCount;
+}
+
+u32 AudioRing::GetAvailable() const
+{
+    return writeIndex.load( std::memory_order_acquire ) - readIndex.load( std::memory_order_acquire );
+}
+
+u32 AudioRing::GetCapacity() const
+{
+    return mask + 1;
+}
+
+r64 AudioRing::GetRateAdjustment() const
+{
+    /* Empty ring: produce up to MAX_RATE_DEVIATION more samples, full ring: that much less */
+    const r64 fill = static_cast< r64 >( GetAvailable() ) / GetCapacity();
+    return 1.0 + MAX_RATE_DEVIATION * ( 1.0 - 2.0 * fill );
+}
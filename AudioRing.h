@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Lock free single producer / single consumer ring of audio samples between the emulation
+    thread and the audio device callback. The producer only writes writeIndex and the consumer
+    only writes readIndex, so neither side ever waits for the other.
+
+    Video and audio run from two different clocks, the display refresh and the sound card,
+    which never match exactly. Instead of dropping or repeating samples when the ring runs
+    full or empty, the producer asks GetRateAdjustment() once per frame and resamples the next
+    frame slightly faster or slower, which keeps the ring around half full. The pitch change
+    is a fraction of a percent and can't be heard.
+
+    Producer, once per frame:
+        samples = audio.ReadSamples( buffer, count );
+        ring.Write( buffer, samples );
+        audio.SetRateAdjustment( ring.GetRateAdjustment() );
+
+    Consumer, from the device callback:
+        ring.Read( output, requested );
+ */
+
+class AudioRing
+{
+public:
+
+    static constexpr u32 CACHE_LINE_SIZE        = 64;
+
+    /* Largest change applied to the output rate, 0.5% */
+    static constexpr r64 MAX_RATE_DEVIATION     = 0.005;
+
+    /* The capacity is rounded up to a power of two */
+    AudioRing( u32 capacity );
+    AudioRing( AudioRing & ) = delete;
+
+    /* Producer side, returns the samples written, the ones that don't fit are dropped */
+    u32 Write( const i16 *data, u32 count );
+
+    /* Consumer side, always fills count samples and returns how many came from the ring */
+    u32 Read( i16 *data, u32 count );
+
+    u32 GetAvailable() const;
+    u32 GetCapacity() const;
+
+    /* Ratio to apply to the output sample rate so the fill level converges to half */
+    r64 GetRateAdjustment() const;
+
+private:
+
+    std::vector< i16 >      samples;
+    const u32               mask;
+
+    /* Last sample read, repeated on underrun so an empty ring doesn't click */
+    i16                     lastSample;
+
+    /* Free running indices, each one on its own cache line */
+    alignas( CACHE_LINE_SIZE ) std::atomic< u32 > writeIndex;
+    alignas( CACHE_LINE_SIZE ) std::atomic< u32 > readIndex;
+};
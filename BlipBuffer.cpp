@@ -0,0 +1,133 @@
+#include "BlipBuffer.h"
+
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+
+
+const BlipBuffer::Kernel& BlipBuffer::GetKernel()
+{
+    static const struct KernelTable
+    {
+        Kernel taps;
+
+        KernelTable()
+        {
+            /* Blackman windowed sinc with the cutoff just below the output Nyquist frequency */
+            constexpr r64 PI = 3.14159265358979323846;
+            constexpr r64 CUTOFF = 0.45;
+            constexpr r64 HALF_WIDTH = KERNEL_WIDTH / 2.0;
+
+            for ( u32 phase = 0; phase < PHASE_COUNT; ++phase )
+            {
+                r64 impulse[ KERNEL_WIDTH ];
+                r64 sum = 0.0;
+                for ( u32 tap = 0; tap < KERNEL_WIDTH; ++tap )
+                {
+                    /* Tap distance to the step, the whole kernel is delayed by HALF_WIDTH - 1 samples */
+                    const r64 t = tap - ( HALF_WIDTH - 1.0 ) - static_cast< r64 >( phase ) / PHASE_COUNT;
+                    const r64 x = 2.0 * CUTOFF * t;
+                    const r64 sinc = ( std::fabs( x ) < 1e-9 ) ? 1.0 : std::sin( PI * x ) / ( PI * x );
+                    const r64 window = ( std::fabs( t ) >= HALF_WIDTH ) ? 0.0 : 0.42 + 0.5 * std::cos( PI * t / HALF_WIDTH ) + 0.08 * std::cos( 2.0 * PI * t / HALF_WIDTH );
+                    impulse[ tap ] = sinc * window;
+                    sum += impulse[ tap ];
+                }
+
+                /* Every phase must add up to exactly one step or the integrator would drift */
+                i32 total = 0;
+                for ( u32 tap = 0; tap < KERNEL_WIDTH; ++tap )
+                {
+                    taps[ phase ][ tap ] = static_cast< i16 >( std::lround( impulse[ tap ] / sum * ( 1 << KERNEL_BITS ) ) );
+                    total += taps[ phase ][ tap ];
+                }
+                taps[ phase ][ KERNEL_WIDTH / 2 ] += static_cast< i16 >( ( 1 << KERNEL_BITS ) - total );
+            }
+        }
+    } KERNEL_TABLE;
+
+    return KERNEL_TABLE.taps;
+}
+
+BlipBuffer::BlipBuffer( u32 sampleRate, u32 bufferMilliseconds )
+    : kernel( GetKernel() )
+    , factor( 0u )
+{
+    buffer.resize( ( sampleRate * bufferMilliseconds ) / 1000 + KERNEL_WIDTH + 1 );
+    Clear();
+}
+
+void BlipBuffer::Clear()
+{
+    std::fill( buffer.begin(), buffer.end(), 0 );
+    offset = 0u;
+    integrator = 0;
+    highPass = 0;
+}
+
+void BlipBuffer::SetRates( r64 clockRate, r64 sampleRate )
+{
+    factor = static_cast< u64 >( std::llround( sampleRate / clockRate * 4294967296.0 ) );
+}
+
+void BlipBuffer::EndFrame( u32 clockDuration )
+{
+    offset += clockDuration * factor;
+    assert( GetSamplesAvailable() + KERNEL_WIDTH <= buffer.size() && "The blip buffer overflowed, read it more often" );
+}
+
+u32 BlipBuffer::GetSamplesAvailable() const
+{
+    return static_cast< u32 >( offset >> 32 );
+}
+
+u32 BlipBuffer::GetCapacity() const
+{
+    return static_cast< u32 >( buffer.size() ) - KERNEL_WIDTH - 1;
+}
+
+u32 BlipBuffer::ReadSamples( i16 *samples, u32 count )
+{
+    const u32 available = GetSamplesAvailable();
+    count = ( count < available ) ? count : available;
+
+    i32 sum = integrator;
+    i32 dc = highPass;
+    for ( u32 i = 0; i < count; ++i )
+    {
+        sum += buffer[ i ];
+
+        /* One pole high pass to remove the DC offset, the NES output is AC coupled as well */
+        const i32 sample = ( sum >> KERNEL_BITS ) - ( dc >> 10 );
+        dc += ( sum >> KERNEL_BITS ) - ( dc >> 10 );
+
+        samples[ i ] = static_cast< i16 >( ( sample > 32767 ) ? 32767 : ( sample < -32768 ) ? -32768 : sample );
+    }
+    integrator = sum;
+    highPass = dc;
+
+    DiscardSamples( count );
+    return count;
+}
+
+void BlipBuffer::RemoveSamples( u32 count )
+{
+    const u32 available = GetSamplesAvailable();
+    count = ( count < available ) ? count : available;
+
+    /* Samples dropped without reading them still have to go through the integrator */
+    for ( u32 i = 0; i < count; ++i )
+    {
+        integrator += buffer[ i ];
+    }
+
+    DiscardSamples( count );
+}
+
+void BlipBuffer::DiscardSamples( u32 count )
+{
+    const u32 remaining = static_cast< u32 >( buffer.size() ) - count;
+    memmove( buffer.data(), &buffer[ count ], remaining * sizeof( i32 ) );
+    memset( &buffer[ remaining ], 0, count * sizeof( i32 ) );
+
+    offset -= static_cast< u64 >( count ) << 32;
+}
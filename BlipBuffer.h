@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Band limited step synthesis.
+
+    Instead of generating the waveform at the CPU clock and filtering it down, the sound
+    channels only report the clock at which their output changes and by how much. Every change
+    is added to the output buffer as a windowed sinc impulse at its fractional sample position,
+    and reading the buffer integrates those impulses back into band limited steps at the
+    output rate. The cost depends on the number of transitions, not on the clock rate.
+
+    Times are in source clocks relative to the start of the current frame.
+ */
+
+class BlipBuffer
+{
+public:
+
+    static constexpr u32 PHASE_BITS     = 5;
+    static constexpr u32 PHASE_COUNT    = 1 << PHASE_BITS;
+    static constexpr u32 KERNEL_WIDTH   = 16;
+    static constexpr u32 KERNEL_BITS    = 14;
+
+    BlipBuffer( u32 sampleRate, u32 bufferMilliseconds );
+
+    void Clear();
+
+    /* Ratio between the clock of the deltas and the output sample rate */
+    void SetRates( r64 clockRate, r64 sampleRate );
+
+    void AddDelta( u32 clockTime, i32 delta );
+    void EndFrame( u32 clockDuration );
+
+    u32 GetSamplesAvailable() const;
+    u32 GetCapacity() const;
+    u32 ReadSamples( i16 *samples, u32 count );
+    void RemoveSamples( u32 count );
+
+private:
+
+    using Kernel = i16[ PHASE_COUNT ][ KERNEL_WIDTH ];
+
+    std::vector< i32 >  buffer;
+    const Kernel        &kernel;
+    u64                 factor;
+
+    /* Position of the current frame start in 32.32 fixed point output samples */
+    u64                 offset;
+    i32                 integrator;
+    i32                 highPass;
+
+    static const Kernel& GetKernel();
+    void DiscardSamples( u32 count );
+};
+
+
+inline void BlipBuffer::AddDelta( u32 clockTime, i32 delta )
+{
+    const u64 position = clockTime * factor + offset;
+    const u32 index = static_cast< u32 >( position >> 32 );
+    const u32 phase = static_cast< u32 >( position >> ( 32 - PHASE_BITS ) ) & ( PHASE_COUNT - 1 );
+
+    i32 *output = &buffer[ index ];
+    const i16 *taps = kernel[ phase ];
+    for ( u32 i = 0; i < KERNEL_WIDTH; ++i )
+    {
+        output[ i ] += delta * taps[ i ];
+    }
+}
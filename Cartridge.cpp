@@ -1,13 +1,61 @@
 #include <iostream>
-#include <fstream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Cartridge.h"
+#include "Hash.h"
+#include "RomDatabase.h"
+#include "RomArchive.h"
+
+
+namespace
+{
+    constexpr u32 HEADER_SIZE   = 16;
+    constexpr u32 TRAINER_SIZE  = 512;
+
+    /* A NES 2.0 header counting in units stays below 64MB, the exponent notation goes up to 2^63 * 7 bytes */
+    constexpr u64 MAX_ROM_SIZE_KB           = 64 * 1024;
+    constexpr byte MAX_ROM_SIZE_EXPONENT    = 26;
+
+    /* NES 2.0 RAM sizes are shift counts, 0 means none */
+    u32 GetRamSize( byte shiftCount )
+    {
+        return ( shiftCount == 0 ) ? 0 : 64u << shiftCount;
+    }
+
+    /* NES 2.0 ROM sizes, in units unless the upper nibble is 0xF which makes the lower byte an exponent and a multiplier */
+    bool TryGetRomSizeKB( byte lowerByte, byte upperNibble, u32 unitKB, u32 &sizeKB )
+    {
+        u64 size = ( ( static_cast< u64 >( upperNibble ) << 8 ) | lowerByte ) * unitKB;
+        if ( upperNibble == 0x0F )
+        {
+            const byte exponent = lowerByte >> 2;
+            if ( exponent > MAX_ROM_SIZE_EXPONENT )
+            {
+                return false;
+            }
+            size = ( ( 1ull << exponent ) * ( ( lowerByte & 0x03 ) * 2 + 1 ) + 1_KB - 1 ) / 1_KB;
+        }
+
+        if ( size > MAX_ROM_SIZE_KB )
+        {
+            return false;
+        }
+        sizeKB = static_cast< u32 >( size );
+        return true;
+    }
+}
 
 
 Cartridge::Cartridge( const char *fileName )
     : cartridgeSize( 0 )
     , romFileName( fileName )
     , rom( nullptr )
+    , ownedRom( nullptr )
     , isLoaded( false )
 {
     if ( fileName != nullptr )
@@ -16,9 +64,42 @@ Cartridge::Cartridge( const char *fileName )
     }
 }
 
+Cartridge::Cartridge( const byte *data, u32 size, const char *name )
+    : cartridgeSize( size )
+    , romFileName( name )
+    , rom( nullptr )
+    , ownedRom( nullptr )
+    , isLoaded( false )
+{
+    if ( data != nullptr && size > 0 )
+    {
+        ownedRom = new byte[ size ];
+        memcpy( ownedRom, data, size );
+        rom = ownedRom;
+        isLoaded = TryLoadHeader();
+    }
+}
+
+Cartridge::Cartridge( const RomArchive &archive, u32 entryIndex )
+    : cartridgeSize( 0 )
+    , romFileName( entryIndex < archive.GetEntries().size() ? archive.GetEntries()[ entryIndex ].name.c_str() : "" )
+    , rom( nullptr )
+    , ownedRom( nullptr )
+    , isLoaded( false )
+{
+    isLoaded = TryLoadFromArchive( archive, static_cast< i32 >( entryIndex ) );
+}
+
 Cartridge::~Cartridge()
 {
-    delete rom;
+    if ( ownedRom != nullptr )
+    {
+        delete[] ownedRom;
+    }
+    else if ( rom != nullptr )
+    {
+        munmap( const_cast< byte * >( rom ), cartridgeSize );
+    }
 }
 
 bool Cartridge::IsLoaded() const
@@ -33,16 +114,37 @@ bool Cartridge::TryLoad( const char* romFile )
         return false;
     }
 
-    std::basic_ifstream<byte> cartridgeFile( romFile, std::ios::binary | std::ios::in | std::ios::ate );
-    if ( cartridgeFile.is_open() )
+    /* The ROM is mapped read only so several emulator instances can share the same pages */
+    const i32 fileDescriptor = open( romFile, O_RDONLY );
+    if ( fileDescriptor < 0 )
+    {
+        return false;
+    }
+
+    struct stat fileStatus;
+    if ( fstat( fileDescriptor, &fileStatus ) == 0 && fileStatus.st_size > 0 )
+    {
+        cartridgeSize = static_cast< u32 >( fileStatus.st_size );
+        void *mapping = mmap( nullptr, cartridgeSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0 );
+        if ( mapping != MAP_FAILED )
+        {
+            rom = static_cast< const byte * >( mapping );
+        }
+    }
+    close( fileDescriptor );
+
+    /* Compressed ROMs are inflated from the mapping of the archive into a buffer of the ROM size */
+    if ( RomArchive::IsArchive( rom, cartridgeSize ) )
     {
-        cartridgeSize = static_cast< u32 >( cartridgeFile.tellg() );
-        cartridgeFile.seekg( 0 );
+        const RomArchive archive( rom, cartridgeSize );
+        const byte *archiveMapping = rom;
+        const u32 archiveSize = cartridgeSize;
 
-        rom = new byte[ cartridgeSize ];
-        cartridgeFile.read( rom, cartridgeSize );
+        rom = nullptr;
+        const bool isLoadedFromArchive = TryLoadFromArchive( archive, archive.FindRomEntry() );
+        munmap( const_cast< byte * >( archiveMapping ), archiveSize );
+        return isLoadedFromArchive;
     }
-    cartridgeFile.close();
 
     if ( rom != nullptr )
     {
@@ -52,6 +154,32 @@ bool Cartridge::TryLoad( const char* romFile )
     return false;
 }
 
+bool Cartridge::TryLoadFromArchive( const RomArchive &archive, i32 entryIndex )
+{
+    if ( !archive.IsOpen() || entryIndex < 0 || static_cast< size_t >( entryIndex ) >= archive.GetEntries().size() )
+    {
+        return false;
+    }
+
+    const RomArchive::Entry &entry = archive.GetEntries()[ entryIndex ];
+    if ( entry.size == 0 || entry.size > RomArchive::MAX_ENTRY_SIZE )
+    {
+        return false;
+    }
+
+    ownedRom = new byte[ entry.size ];
+    if ( !archive.TryExtract( static_cast< u32 >( entryIndex ), ownedRom ) )
+    {
+        delete[] ownedRom;
+        ownedRom = nullptr;
+        return false;
+    }
+
+    rom = ownedRom;
+    cartridgeSize = entry.size;
+    return TryLoadHeader();
+}
+
 bool Cartridge::TryLoadHeader()
 {
     static constexpr u64 ROM_CONSTANT_HEADER = 0x4E45531A;
@@ -79,24 +207,107 @@ bool Cartridge::TryLoadHeader()
         return false;
     }
 
+    header = Header();
     header.prgRomSizeKB = static_cast< u32 >( rom[ 0x04 ] ) * 16;
     header.chrRomSizeKB = static_cast< u32 >( rom[ 0x05 ] ) * 8;
 
     /* Flags 6 */
     header.mirroringType = MirroringType( rom[ 0x06 ] & 0b0000'0001 );
-    header.hasPRGRam = rom[ 0x06 ] & 0b0000'0010;
+    header.hasPersistentMemory = rom[ 0x06 ] & 0b0000'0010;
     header.has512BTrainer = rom[ 0x06 ] & 0b0000'0100;
     header.ignoreMirroring = rom[ 0x06 ] & 0b0000'1000;
     const byte lowerNibbleMapper = ( rom[ 0x06 ] & 0b1111'0000 ) >> 4;
-    
-    /* Flags 7 */
+
+    /* Flags 7, NES 2.0 headers have 0b10 in bits 2 and 3 */
     const byte upperNibbleMapper = rom[ 0x07 ] & 0b1111'0000;
-    header.mapper = upperNibbleMapper | lowerNibbleMapper;
+    header.isNes20 = ( rom[ 0x07 ] & 0b0000'1100 ) == 0b0000'1000;
+
+    /* Old dumping tools wrote their name from byte 7 on ( "DiskDude!" ), only a zeroed tail can be trusted */
+    const bool hasCleanTail = ( rom[ 0x07 ] & 0b0000'1100 ) == 0 && rom[ 0x0C ] == 0 && rom[ 0x0D ] == 0 && rom[ 0x0E ] == 0 && rom[ 0x0F ] == 0;
+
+    if ( header.isNes20 )
+    {
+        header.mapper = upperNibbleMapper | lowerNibbleMapper;
+        if ( !TryLoadNes20Header() )
+        {
+            return false;
+        }
+    }
+    else if ( hasCleanTail )
+    {
+        header.mapper = upperNibbleMapper | lowerNibbleMapper;
 
-    // TODO (Jonathan): Implement support for iNES 2.0
+        /* Flags 8 and 9, 0 PRG RAM banks of 8KB means one, battery backed when flags 6 says so */
+        const u32 prgRamSize = ( rom[ 0x08 ] == 0 ? 1 : rom[ 0x08 ] ) * 8_KB;
+        header.prgRamSize = header.hasPersistentMemory ? 0 : prgRamSize;
+        header.prgNvramSize = header.hasPersistentMemory ? prgRamSize : 0;
+        header.timingRegion = ( rom[ 0x09 ] & 0b0000'0001 ) ? TimingRegion::Pal : TimingRegion::Ntsc;
+    }
+    else
+    {
+        header.mapper = lowerNibbleMapper;
+        header.prgNvramSize = header.hasPersistentMemory ? 8_KB : 0;
+    }
+
+    /* A battery is only there to keep the PRG RAM */
+    header.hasPRGRam = header.prgRamSize > 0 || header.prgNvramSize > 0;
+
+    ApplyRomDatabase();
     return true;
 }
 
+bool Cartridge::TryLoadNes20Header()
+{
+    /* Flags 8, mapper bits 8 to 11 and submapper */
+    header.mapper |= static_cast< u16 >( rom[ 0x08 ] & 0b0000'1111 ) << 8;
+    header.submapper = rom[ 0x08 ] >> 4;
+
+    /* Flags 9, upper nibbles of the ROM sizes */
+    if ( !TryGetRomSizeKB( rom[ 0x04 ], rom[ 0x09 ] & 0b0000'1111, 16, header.prgRomSizeKB )
+        || !TryGetRomSizeKB( rom[ 0x05 ], rom[ 0x09 ] >> 4, 8, header.chrRomSizeKB ) )
+    {
+        return false;
+    }
+
+    /* Flags 10 and 11, volatile and battery backed RAM sizes */
+    header.prgRamSize = GetRamSize( rom[ 0x0A ] & 0b0000'1111 );
+    header.prgNvramSize = GetRamSize( rom[ 0x0A ] >> 4 );
+    header.chrRamSize = GetRamSize( rom[ 0x0B ] & 0b0000'1111 );
+    header.chrNvramSize = GetRamSize( rom[ 0x0B ] >> 4 );
+
+    /* Flags 12 */
+    header.timingRegion = TimingRegion( rom[ 0x0C ] & 0b0000'0011 );
+    return true;
+}
+
+void Cartridge::ApplyRomDatabase()
+{
+    /* The checksum covers the ROM the header announces, or what the file really has when it is shorter */
+    const u64 romOffset = HEADER_SIZE + ( header.has512BTrainer ? TRAINER_SIZE : 0 );
+    const u64 romSize = ( static_cast< u64 >( header.prgRomSizeKB ) + header.chrRomSizeKB ) * 1_KB;
+    const u64 availableSize = ( cartridgeSize > romOffset ) ? cartridgeSize - romOffset : 0;
+    header.crc32 = Crc32( &rom[ romOffset ], static_cast< size_t >( ( romSize < availableSize ) ? romSize : availableSize ), 0 );
+
+    const romdatabase::Entry *entry = romdatabase::Find( header.crc32 );
+    if ( entry == nullptr )
+    {
+        return;
+    }
+
+    header.mapper = entry->mapper;
+    header.submapper = entry->submapper;
+    header.mirroringType = ( entry->mirroringType == MirroringType::FourScreen ) ? header.mirroringType : entry->mirroringType;
+    header.ignoreMirroring = entry->mirroringType == MirroringType::FourScreen;
+    header.hasPersistentMemory = entry->hasPersistentMemory;
+    header.timingRegion = entry->timingRegion;
+    header.prgRamSize = entry->prgRamSize;
+    header.prgNvramSize = entry->prgNvramSize;
+    header.chrRamSize = entry->chrRamSize;
+    header.chrNvramSize = entry->chrNvramSize;
+    header.hasPRGRam = header.prgRamSize > 0 || header.prgNvramSize > 0;
+    header.isFromDatabase = true;
+}
+
 void Cartridge::PrintDetails() const
 {
     std::cout << "Cartridge: " << romFileName << "\n"
@@ -108,7 +319,13 @@ void Cartridge::PrintDetails() const
         << "Contains PRG RAM: " << header.hasPRGRam << "\n"
         << "Contains 512B trainer: " << header.has512BTrainer << "\n"
         << "Ignores Mirroring: " << header.ignoreMirroring << "\n"
-        << "Mapper: " << static_cast< u32 >( header.mapper );
+        << "Mapper: " << static_cast< u32 >( header.mapper ) << "\n"
+        << "NES 2.0 header: " << header.isNes20 << "\n"
+        << "Submapper: " << static_cast< u32 >( header.submapper ) << "\n"
+        << "PRG RAM / NVRAM Size (bytes): " << header.prgRamSize << " / " << header.prgNvramSize << "\n"
+        << "CHR RAM / NVRAM Size (bytes): " << header.chrRamSize << " / " << header.chrNvramSize << "\n"
+        << "Timing: " << TimingRegionString[ static_cast< byte >( header.timingRegion ) ] << "\n"
+        << "CRC32: " << std::hex << header.crc32 << std::dec << ( header.isFromDatabase ? " ( header from the ROM database )" : "" );
 
     std::cout << std::endl;
 }
@@ -121,4 +338,15 @@ const Cartridge::Header& Cartridge::GetHeader() const
 const byte* const Cartridge::GetRom() const
 {
     return rom;
-}
\ No newline at end of file
+}
+
+u32 Cartridge::GetRomSize() const
+{
+    return cartridgeSize;
+}
+
+bool Cartridge::IsImageComplete() const
+{
+    const u64 imageSize = HEADER_SIZE + ( header.has512BTrainer ? TRAINER_SIZE : 0 ) + ( static_cast< u64 >( header.prgRomSizeKB ) + header.chrRomSizeKB ) * 1_KB;
+    return isLoaded && cartridgeSize >= imageSize;
+}
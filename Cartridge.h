@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cstddef>
+
 #include "Types.h"
 
 
+class RomArchive;
+
 class Cartridge
 {
 public:
@@ -12,13 +16,40 @@ public:
         Horizontal = 0,
         Vertical,
 
+        /* Only selected by mappers or by the four screen bit of the header */
+        SingleScreenLower,
+        SingleScreenUpper,
+        FourScreen,
+
         Count
     };
 
     static constexpr const char* MirroringTypeString [ static_cast< size_t >( MirroringType::Count ) ] =
     {
         "Horizontal",
-        "Vertical"
+        "Vertical",
+        "Single Screen Lower",
+        "Single Screen Upper",
+        "Four Screen"
+    };
+
+    /* CPU and PPU timing the cartridge was made for */
+    enum class TimingRegion : byte
+    {
+        Ntsc = 0,
+        Pal,
+        MultiRegion,
+        Dendy,
+
+        Count
+    };
+
+    static constexpr const char* TimingRegionString [ static_cast< size_t >( TimingRegion::Count ) ] =
+    {
+        "NTSC",
+        "PAL",
+        "Multi Region",
+        "Dendy"
     };
 
     struct Header
@@ -30,7 +61,20 @@ public:
         bool                        hasPRGRam;
         bool                        has512BTrainer;
         bool                        ignoreMirroring;
-        byte                        mapper;
+        u16                         mapper;
+
+        /* Only known from NES 2.0 headers or from the ROM database, the RAM sizes are in bytes */
+        bool                        isNes20;
+        byte                        submapper;
+        u32                         prgRamSize;
+        u32                         prgNvramSize;
+        u32                         chrRamSize;
+        u32                         chrNvramSize;
+        Cartridge::TimingRegion     timingRegion;
+
+        /* CRC-32 of the PRG and CHR ROM, the header was replaced by the ROM database entry of that CRC */
+        u32                         crc32;
+        bool                        isFromDatabase;
 
         Header()
             : prgRomSizeKB( 0 )
@@ -40,28 +84,49 @@ public:
             , hasPRGRam( false )
             , has512BTrainer( false )
             , ignoreMirroring( false )
-            , mapper( 0x00 )
+            , mapper( 0x0000 )
+            , isNes20( false )
+            , submapper( 0x00 )
+            , prgRamSize( 0 )
+            , prgNvramSize( 0 )
+            , chrRamSize( 0 )
+            , chrNvramSize( 0 )
+            , timingRegion( Cartridge::TimingRegion::Ntsc )
+            , crc32( 0 )
+            , isFromDatabase( false )
         {
         }
     };
 
 
     Cartridge( const char *fileName );
+    /* Loads a copy of an iNES image that is already in memory, name is only used for display */
+    Cartridge( const byte *data, u32 size, const char *name );
+    /* Inflates an entry of a .zip or .gz archive, the entry name is used for display and must outlive the cartridge */
+    Cartridge( const RomArchive &archive, u32 entryIndex );
     ~Cartridge();
 
     void PrintDetails() const;
     bool IsLoaded() const;    
     const Header& GetHeader() const;
     const byte * const GetRom() const;
+    /* Size of the iNES image GetRom points to, header included */
+    u32 GetRomSize() const;
+    /* Whether the image holds the trainer, PRG ROM and CHR ROM the header announces, truncated dumps don't */
+    bool IsImageComplete() const;
 
 private:
 
     u32                 cartridgeSize;
     const char*         romFileName;
-    byte*               rom;
+    const byte*         rom;
+    byte*               ownedRom;
     bool                isLoaded;
     Cartridge::Header   header;
 
     bool TryLoad( const char *romFile );
+    bool TryLoadFromArchive( const RomArchive &archive, i32 entryIndex );
     bool TryLoadHeader();
+    bool TryLoadNes20Header();
+    void ApplyRomDatabase();
 };
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "CodeDataLogger.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "Cartridge.h"
+#include "CpuTypes.h"
+
+
+CodeDataLogger::CodeDataLogger( const Cartridge *cartridge, const Memory *memory )
+    : prgFlags( static_cast< size_t >( cartridge->GetHeader().prgRomSizeKB ) * 1_KB, 0x00 )
+    , chrRomSize( cartridge->GetHeader().chrRomSizeKB * 1_KB )
+    , memory( memory )
+    , instructionAddress( 0x0000 )
+    , instructionLength( 0 )
+    , readFlags( DATA )
+    , isIndirectJump( false )
+{
+    /* Unknown opcodes are logged as single byte instructions */
+    memset( instructionLengths, 1, sizeof( instructionLengths ) );
+    memset( instructionReadFlags, DATA, sizeof( instructionReadFlags ) );
+
+    for ( const auto &[ opcode, info ] : NES_OPCODE_INFO )
+    {
+        const bool isIndirect = info.addressMode == CpuAddressMode::IndexedX || info.addressMode == CpuAddressMode::IndexedY;
+        instructionLengths[ opcode ] = ADDRESS_MODE_OPCODE_LENGTH[ static_cast< byte >( info.addressMode ) ];
+        instructionReadFlags[ opcode ] = DATA | ( isIndirect ? INDIRECT_DATA : 0 );
+    }
+}
+
+void CodeDataLogger::Clear()
+{
+    std::fill( prgFlags.begin(), prgFlags.end(), 0x00 );
+    isIndirectJump = false;
+}
+
+u32 CodeDataLogger::GetPrgRomSize() const
+{
+    return static_cast< u32 >( prgFlags.size() );
+}
+
+byte CodeDataLogger::GetFlags( u32 prgOffset ) const
+{
+    return ( prgOffset < prgFlags.size() ) ? prgFlags[ prgOffset ] : 0x00;
+}
+
+byte CodeDataLogger::GetFlagsAt( word address ) const
+{
+    return ( address >= 0x8000 ) ? GetFlags( memory->GetPrgRomOffset( address ) ) : 0x00;
+}
+
+u32 CodeDataLogger::CountBytes( byte flags ) const
+{
+    u32 count = 0;
+    for ( const byte prgFlag : prgFlags )
+    {
+        count += ( prgFlag & flags ) ? 1 : 0;
+    }
+    return count;
+}
+
+bool CodeDataLogger::Export( const char *fileName ) const
+{
+    FILE *file = fopen( fileName, "wb" );
+    if ( file == nullptr )
+    {
+        return false;
+    }
+
+    std::vector< byte > cdl( prgFlags.size() + chrRomSize, 0x00 );
+    for ( size_t i = 0; i < prgFlags.size(); ++i )
+    {
+        cdl[ i ] = prgFlags[ i ] & ~OPCODE;
+    }
+
+    const bool isWritten = fwrite( cdl.data(), 1, cdl.size(), file ) == cdl.size();
+    return ( fclose( file ) == 0 ) && isWritten;
+}
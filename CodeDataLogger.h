@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.h"
+#include "Memory.h"
+
+
+class Cartridge;
+
+/*
+    Code/Data logger. Keeps one byte of flags per PRG ROM byte, indexed by the ROM offset so
+    every bank has its own flags whatever is mapped at the time. The CPU marks the opcode and
+    operands of every instruction it executes, Memory marks the PRG bytes read by instructions
+    and by the DMC. Logging is a lookup in a table of 256 opcodes and a few ORs per access, and
+    only happens while a logger is set on the Emulator.
+
+    The file export is the .cdl format of FCEUX and Mesen: the PRG flags followed by one byte
+    per CHR ROM byte. CHR accesses are not logged, that part is left empty.
+ */
+
+class CodeDataLogger
+{
+public:
+
+    /* Low 7 bits as in the .cdl format, the bank bits are bits 13 and 14 of the CPU address */
+    enum Flags : byte
+    {
+        CODE            = 0b0000'0001,
+        DATA            = 0b0000'0010,
+        BANK_MASK       = 0b0000'1100,
+        INDIRECT_CODE   = 0b0001'0000,
+        INDIRECT_DATA   = 0b0010'0000,
+        PCM_DATA        = 0b0100'0000,
+
+        /* Only kept in memory, the first byte of an instruction */
+        OPCODE          = 0b1000'0000,
+    };
+
+    CodeDataLogger( const Cartridge *cartridge, const Memory *memory );
+    CodeDataLogger( CodeDataLogger & ) = delete;
+
+    void Clear();
+
+    inline void LogInstruction( word address, byte opcode );
+    inline void LogRead( word address );
+    inline void LogDmcRead( word address );
+
+    u32 GetPrgRomSize() const;
+    byte GetFlags( u32 prgOffset ) const;
+
+    /* Flags of the PRG byte mapped at a CPU address, 0 below 0x8000 */
+    byte GetFlagsAt( word address ) const;
+
+    /* PRG bytes that have any of the flags */
+    u32 CountBytes( byte flags ) const;
+
+    bool Export( const char *fileName ) const;
+
+private:
+
+    std::vector< byte >     prgFlags;
+    u32                     chrRomSize;
+    const Memory            *memory;
+
+    /* Per opcode, filled from NES_OPCODE_INFO */
+    byte                    instructionLengths[ 256 ];
+    byte                    instructionReadFlags[ 256 ];
+
+    /* Bytes of the instruction being executed, reading them is already logged as code */
+    word                    instructionAddress;
+    byte                    instructionLength;
+    byte                    readFlags;
+    bool                    isIndirectJump;
+
+    static byte GetBankFlags( word address );
+};
+
+
+inline byte CodeDataLogger::GetBankFlags( word address )
+{
+    return static_cast< byte >( ( ( address >> 13 ) & 0b11 ) << 2 );
+}
+
+inline void CodeDataLogger::LogInstruction( word address, byte opcode )
+{
+    /* The code an indirect JMP lands on is marked as indirect code */
+    const byte codeFlags = CODE | ( isIndirectJump ? INDIRECT_CODE : 0 );
+
+    instructionAddress = address;
+    instructionLength = instructionLengths[ opcode ];
+    readFlags = instructionReadFlags[ opcode ];
+    isIndirectJump = opcode == 0x6C;
+
+    if ( address < 0x8000 )
+    {
+        return;
+    }
+
+    prgFlags[ memory->GetPrgRomOffset( address ) ] |= codeFlags | OPCODE | GetBankFlags( address );
+    for ( byte i = 1; i < instructionLength && address + i <= 0xFFFF; ++i )
+    {
+        const word operandAddress = static_cast< word >( address + i );
+        prgFlags[ memory->GetPrgRomOffset( operandAddress ) ] |= codeFlags | GetBankFlags( operandAddress );
+    }
+}
+
+inline void CodeDataLogger::LogRead( word address )
+{
+    if ( static_cast< word >( address - instructionAddress ) >= instructionLength )
+    {
+        prgFlags[ memory->GetPrgRomOffset( address ) ] |= readFlags | GetBankFlags( address );
+    }
+}
+
+inline void CodeDataLogger::LogDmcRead( word address )
+{
+    prgFlags[ memory->GetPrgRomOffset( address ) ] |= DATA | PCM_DATA | GetBankFlags( address );
+}
@@ -0,0 +1,48 @@
+#include "Controller.h"
+
+
+Controller::Controller()
+{
+    Reset();
+}
+
+void Controller::Reset()
+{
+    buttons = 0x00;
+    shiftRegister = 0x00;
+    strobe = false;
+}
+
+void Controller::SetButtons( byte pressedButtons )
+{
+    buttons = pressedButtons;
+}
+
+byte Controller::GetButtons() const
+{
+    return buttons;
+}
+
+void Controller::Write( byte data )
+{
+    strobe = ( data & 0b0000'0001 ) == 0b0000'0001;
+    if ( strobe )
+    {
+        shiftRegister = buttons;
+    }
+}
+
+byte Controller::Read()
+{
+    if ( strobe )
+    {
+        return ( buttons & 0b0000'0001 ) | 0b0100'0000;
+    }
+
+    /* Once the 8 buttons have been shifted out official controllers report 1 */
+    const byte data = shiftRegister & 0b0000'0001;
+    shiftRegister = ( shiftRegister >> 1 ) | 0b1000'0000;
+
+    /* The upper bits are open bus, which usually holds the high byte of the address 0x40 */
+    return data | 0b0100'0000;
+}
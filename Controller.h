@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Types.h"
+
+
+/*
+    Standard NES controller. The buttons are latched while the strobe bit of 0x4016 is high
+    and then shifted out one per read in the order A, B, Select, Start, Up, Down, Left, Right.
+ */
+
+class Controller
+{
+public:
+
+    enum class Button : byte
+    {
+        A       = 0b0000'0001,
+        B       = 0b0000'0010,
+        Select  = 0b0000'0100,
+        Start   = 0b0000'1000,
+        Up      = 0b0001'0000,
+        Down    = 0b0010'0000,
+        Left    = 0b0100'0000,
+        Right   = 0b1000'0000,
+    };
+
+    Controller();
+
+    void Reset();
+
+    /* Host side, one bit per Button */
+    void SetButtons( byte pressedButtons );
+    byte GetButtons() const;
+
+    /* CPU side */
+    void Write( byte data );
+    byte Read();
+
+private:
+    byte    buttons;
+    byte    shiftRegister;
+    bool    strobe;
+};
@@ -4,10 +4,26 @@
 #include <unordered_map>
 
 #include "Memory.h"
+#include "InstructionTracer.h"
+#include "CodeDataLogger.h"
+#include "CycleProfiler.h"
+#include "MemoryHeatmap.h"
 
 
+namespace
+{
+    constexpr word NMI_VECTOR   = 0xFFFA;
+    constexpr word IRQ_VECTOR   = 0xFFFE;
+
+    /* Not a real line, makes the next poll use the I flag from before CLI, SEI or PLP */
+    constexpr byte INTERRUPT_POLL_DELAYED = 0b1000'0000;
+}
+
 Cpu::Cpu( Memory *memory )
     : memory( memory )
+    , codeDataLogger( nullptr )
+    , cycleProfiler( nullptr )
+    , memoryHeatmap( nullptr )
 {
     Reset();
 }
@@ -24,12 +40,167 @@ void Cpu::Reset()
     accumulator = 0x00;
     xRegisterIndex = 0x00;
     yRegisterIndex = 0x00;
+
+    /* The reset sequence takes 7 cycles before the first instruction is fetched */
+    cycles = 7;
+
+    interruptLines = 0x00;
+    delayedInterruptDisable = true;
+}
+
+void Cpu::SoftReset()
+{
+    PC.low = memory->Read( 0xFFFC );
+    PC.hi = memory->Read( 0xFFFD );
+
+    stackPointer -= 3;
+    RaiseFlag( Flags::InterruptDisable );
+    cycles += 7;
+
+    interruptLines = 0x00;
+    delayedInterruptDisable = true;
 }
 
 word Cpu::Update()
 {
+    return Step< false >( nullptr );
+}
+
+word Cpu::Update( InstructionTracer &tracer )
+{
+    return Step< true >( &tracer );
+}
+
+void Cpu::SetCodeDataLogger( CodeDataLogger *logger )
+{
+    codeDataLogger = logger;
+}
+
+void Cpu::SetCycleProfiler( CycleProfiler *profiler )
+{
+    cycleProfiler = profiler;
+}
+
+void Cpu::SetMemoryHeatmap( MemoryHeatmap *heatmap )
+{
+    memoryHeatmap = heatmap;
+}
+
+template< bool TRACE_ENABLED >
+word Cpu::Step( InstructionTracer *tracer )
+{
+    /* The untraced instantiation doesn't contain any tracing code at all */
+    if constexpr ( TRACE_ENABLED )
+    {
+        tracer->Record( *this, *memory );
+    }
+
+    if ( codeDataLogger != nullptr )
+    {
+        codeDataLogger->LogInstruction( PC.value, memory->Peek( PC.value ) );
+    }
+
+    const word instructionAddress = PC.value;
     const byte opcode = GetNextOpcode();
-    return ExecuteInstruction( opcode );
+    if ( memoryHeatmap != nullptr )
+    {
+        memoryHeatmap->LogExecute( instructionAddress, opcode );
+    }
+
+    word instructionCycles = ExecuteInstruction( opcode );
+
+    /* The CPU is halted while OAM DMA runs, one more cycle to align on a read cycle when it starts on an odd one */
+    if ( memory->IsOamDmaPending() )
+    {
+        memory->AcknowledgeOamDma();
+        instructionCycles += Memory::OAM_DMA_CYCLES + ( ( cycles + instructionCycles ) & 1 );
+    }
+
+    /* Same for the DMC sample fetches, the APU only fetches when it catches up so the stall can come a few instructions late */
+    if ( memory->GetPendingDmcDmaCycles() != 0 )
+    {
+        instructionCycles += memory->GetPendingDmcDmaCycles();
+        memory->AcknowledgeDmcDma();
+    }
+
+    word interruptCycles = 0;
+    if ( interruptLines != 0x00 )
+    {
+        interruptCycles = PollInterrupts();
+        instructionCycles += interruptCycles;
+    }
+
+    if ( cycleProfiler != nullptr )
+    {
+        cycleProfiler->LogInstruction( instructionAddress, opcode, instructionCycles - interruptCycles, interruptCycles, *this );
+    }
+
+    cycles += instructionCycles;
+    return instructionCycles;
+}
+
+void Cpu::RaiseNmi()
+{
+    interruptLines |= static_cast< byte >( InterruptLine::Nmi );
+}
+
+void Cpu::SetIrqLine( InterruptLine line, bool isAsserted )
+{
+    assert( line != InterruptLine::Nmi );
+
+    if ( isAsserted )
+    {
+        interruptLines |= static_cast< byte >( line );
+    }
+    else
+    {
+        interruptLines &= ~static_cast< byte >( line );
+    }
+}
+
+word Cpu::PollInterrupts()
+{
+    bool isIrqDisabled = IsFlagSet( Flags::InterruptDisable );
+    if ( interruptLines & INTERRUPT_POLL_DELAYED )
+    {
+        isIrqDisabled = delayedInterruptDisable;
+        interruptLines &= ~INTERRUPT_POLL_DELAYED;
+    }
+
+    if ( interruptLines & static_cast< byte >( InterruptLine::Nmi ) )
+    {
+        interruptLines &= ~static_cast< byte >( InterruptLine::Nmi );
+        return ServiceInterrupt( NMI_VECTOR );
+    }
+
+    /* IRQ lines stay asserted until their source is acknowledged, they are polled again after every instruction */
+    if ( interruptLines != 0x00 && !isIrqDisabled )
+    {
+        return ServiceInterrupt( IRQ_VECTOR );
+    }
+
+    return 0;
+}
+
+word Cpu::ServiceInterrupt( word vectorAddress )
+{
+    PushToStack( PC.hi );
+    PushToStack( PC.low );
+
+    /* Unlike BRK hardware interrupts push the P register with the Break flag clear */
+    PushToStack( ( pRegister & ~static_cast< byte >( Flags::Break ) ) | 0b0010'0000 );
+    RaiseFlag( Flags::InterruptDisable );
+
+    PC.low = memory->Read( vectorAddress );
+    PC.hi = memory->Read( vectorAddress + 1 );
+
+    return 7;
+}
+
+void Cpu::DelayInterruptPolling()
+{
+    delayedInterruptDisable = IsFlagSet( Flags::InterruptDisable );
+    interruptLines |= INTERRUPT_POLL_DELAYED;
 }
 
 short Cpu::ExecuteInstruction( byte opcode )
@@ -423,6 +594,11 @@ Register Cpu::GetPC() const
     return PC;
 }
 
+void Cpu::SetPC( word address )
+{
+    PC.value = address;
+}
+
 byte Cpu::GetStackPointer() const
 {
     return stackPointer;
@@ -448,6 +624,11 @@ byte Cpu::GetRegisterY() const
     return yRegisterIndex;
 }
 
+u64 Cpu::GetCycles() const
+{
+    return cycles;
+}
+
 
 
 /* ------------------- MAPPABLE INSTRUCTIONS -------------------*/
@@ -892,9 +1073,10 @@ short Cpu::JSR()
 
 short Cpu::RTI()
 {
+    /* The PC was pushed most significant part first so the low part comes out first */
     PopFromStack( pRegister );
-    PopFromStack( PC.hi );
     PopFromStack( PC.low );
+    PopFromStack( PC.hi );
     return 6;
 }
 
@@ -932,6 +1114,7 @@ short Cpu::PHP()
 
 short Cpu::PLP()
 {
+    DelayInterruptPolling();
     PopFromStack( pRegister );
     return 4;
 }
@@ -1010,12 +1193,14 @@ short Cpu::SEC()
 
 short Cpu::CLI()
 { 
+    DelayInterruptPolling();
     ClearFlag( Cpu::Flags::InterruptDisable );
     return 2; 
 }
 
 short Cpu::SEI()
 { 
+    DelayInterruptPolling();
     RaiseFlag( Cpu::Flags::InterruptDisable );
     return 2; 
 }
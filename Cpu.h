@@ -6,6 +6,10 @@
 
 
 class Memory;
+class InstructionTracer;
+class CodeDataLogger;
+class CycleProfiler;
+class MemoryHeatmap;
 
 class Cpu
 {
@@ -23,6 +27,14 @@ public:
         Carry               = 0b0000'0001,
     };
 
+    /* Interrupt request lines, NMI is edge triggered and every IRQ source is level triggered */
+    enum class InterruptLine : byte
+    {
+        Nmi                 = 0b0000'0001,
+        ApuIrq              = 0b0000'0010,
+        MapperIrq           = 0b0000'0100,
+    };
+
     inline static const std::unordered_map< Cpu::Flags, const char * > FLAGS_STRING  =
     {
         { Cpu::Flags::Carry,            "Carry"             },
@@ -39,7 +51,22 @@ public:
 
     void Reset();
 
+    /* Reset button, A X Y and the flags but I are kept and the stack pointer moves down 3 bytes without writing them */
+    void SoftReset();
+
     word Update();
+    word Update( InstructionTracer &tracer );
+
+    /* Marks the opcode and operands of every executed instruction while a logger is set, nullptr disables it */
+    void SetCodeDataLogger( CodeDataLogger *logger );
+
+    /* Adds the cycles of every executed instruction to the profiler while one is set, nullptr disables it */
+    void SetCycleProfiler( CycleProfiler *profiler );
+    void SetMemoryHeatmap( MemoryHeatmap *heatmap );
+
+    /* Interrupts are serviced at the end of the current instruction */
+    void RaiseNmi();
+    void SetIrqLine( InterruptLine line, bool isAsserted );
 
     bool IsFlagSet( Flags flag ) const;
     void RaiseFlag( Flags flag );
@@ -47,11 +74,13 @@ public:
     void ClearFlag( Flags flag );
 
     Register    GetPC() const;
+    void        SetPC( word address );
     byte        GetStackPointer() const;
     byte        GetStateRegister() const;
     byte        GetAccumulator() const;
     byte        GetRegisterX() const;
     byte        GetRegisterY() const;
+    u64         GetCycles() const;
 
     /* Stack operations */
     word GetAbsoluteStackAddress() const;
@@ -69,11 +98,25 @@ private:
     byte        xRegisterIndex;
     byte        yRegisterIndex;
 
+    /* Cycles executed since reset */
+    u64         cycles;
+
+    /* Interrupt lines currently asserted, nothing is polled while this is 0 */
+    byte        interruptLines;
+
+    /* CLI, SEI and PLP change the I flag after the interrupts were polled, the old value is kept for the next poll */
+    bool        delayedInterruptDisable;
+
     /* Systems */
-    Memory      *memory;
+    Memory          *memory;
+    CodeDataLogger  *codeDataLogger;
+    CycleProfiler   *cycleProfiler;
+    MemoryHeatmap   *memoryHeatmap;
 
 
     /* Opcode handling */
+    template< bool TRACE_ENABLED >
+    word Step( InstructionTracer *tracer );
     byte GetNextOpcode();
     short ExecuteInstruction( byte opcode );
     short ExecuteSubroutineOrInterruptInstruction( byte opcode );
@@ -84,6 +127,11 @@ private:
     short ExecuteInstructionCC10( byte opcode );
     short ExecuteSingleByteInstruction( byte opcode );
 
+    /* Interrupt handling */
+    word PollInterrupts();
+    word ServiceInterrupt( word vectorAddress );
+    void DelayInterruptPolling();
+
     /* Addressing mode handling */
     word GetImmediateAddress();
     word GetZeroPageAddress();
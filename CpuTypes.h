@@ -218,7 +218,7 @@ static const std::unordered_map<byte, OpcodeInfo> NES_OPCODE_INFO =
     { 0xE4, { "CPX", CpuAddressMode::ZeroPage } },
     { 0xE5, { "SBC", CpuAddressMode::ZeroPage } },
     { 0xE6, { "INC", CpuAddressMode::ZeroPage } },
-    { 0xE8, { "INC", CpuAddressMode::Implicit } },
+    { 0xE8, { "INX", CpuAddressMode::Implicit } },
     { 0xE9, { "SBC", CpuAddressMode::Immediate } },
     { 0xEA, { "NOP", CpuAddressMode::Implicit } },
     { 0xEC, { "CPX", CpuAddressMode::Absolute } },
@@ -0,0 +1,221 @@
+#include "CycleProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Cartridge.h"
+
+
+CycleProfiler::CycleProfiler( const Cartridge *cartridge, const Memory *memory )
+    : locationCycles( 0x8000 + static_cast< size_t >( cartridge->GetHeader().prgRomSizeKB ) * 1_KB, 0 )
+    , totalCycles( 0 )
+    , memory( memory )
+    , currentFunction( nullptr )
+{
+    callStack.reserve( MAX_CALL_DEPTH );
+    Clear();
+}
+
+void CycleProfiler::Clear()
+{
+    std::fill( locationCycles.begin(), locationCycles.end(), 0 );
+    totalCycles = 0;
+    functions.clear();
+    edges.clear();
+    callStack.clear();
+
+    /* The reset vector is read through Peek, the root is never popped */
+    const word resetAddress = memory->Peek( 0xFFFC ) | ( memory->Peek( 0xFFFD ) << 8 );
+    currentFunction = &functions[ ROOT_FUNCTION ];
+    *currentFunction = { resetAddress, 1, 0, 0, 0 };
+}
+
+u64 CycleProfiler::GetEdgeKey( u32 caller, u32 callee )
+{
+    return ( static_cast< u64 >( caller ) << 32 ) | callee;
+}
+
+void CycleProfiler::PushFrame( word address, byte stackPointer )
+{
+    /* Deeper calls than the stack can hold only happen when the game never returns, they are counted as self cycles */
+    if ( callStack.size() == MAX_CALL_DEPTH )
+    {
+        return;
+    }
+
+    const u32 callee = GetLocation( address );
+    const u32 caller = callStack.empty() ? ROOT_FUNCTION : callStack.back().function;
+    callStack.push_back( { callee, caller, totalCycles, stackPointer } );
+
+    currentFunction = &functions[ callee ];
+    currentFunction->address = address;
+    ++currentFunction->calls;
+    ++currentFunction->activeFrames;
+
+    EdgeStats &edge = edges[ GetEdgeKey( caller, callee ) ];
+    ++edge.calls;
+    ++edge.activeFrames;
+}
+
+void CycleProfiler::PopFrames( byte stackPointer )
+{
+    while ( !callStack.empty() && callStack.back().stackPointer <= stackPointer )
+    {
+        const Frame &frame = callStack.back();
+        const u64 inclusiveCycles = totalCycles - frame.startCycle;
+
+        FunctionStats &function = functions[ frame.function ];
+        if ( --function.activeFrames == 0 )
+        {
+            function.inclusiveCycles += inclusiveCycles;
+        }
+
+        EdgeStats &edge = edges[ GetEdgeKey( frame.caller, frame.function ) ];
+        if ( --edge.activeFrames == 0 )
+        {
+            edge.inclusiveCycles += inclusiveCycles;
+        }
+        callStack.pop_back();
+    }
+
+    currentFunction = &functions[ callStack.empty() ? ROOT_FUNCTION : callStack.back().function ];
+}
+
+u64 CycleProfiler::GetCycles( word address ) const
+{
+    return locationCycles[ GetLocation( address ) ];
+}
+
+u64 CycleProfiler::GetLocationCycles( u32 location ) const
+{
+    return ( location < locationCycles.size() ) ? locationCycles[ location ] : 0;
+}
+
+u32 CycleProfiler::GetLocationCount() const
+{
+    return static_cast< u32 >( locationCycles.size() );
+}
+
+u64 CycleProfiler::GetTotalCycles() const
+{
+    return totalCycles;
+}
+
+u64 CycleProfiler::GetMaxCycles() const
+{
+    return *std::max_element( locationCycles.begin(), locationCycles.end() );
+}
+
+std::vector< CycleProfiler::Function > CycleProfiler::GetFunctions() const
+{
+    /* Only the outermost open frame of a function counts, the stack is walked from the bottom */
+    std::unordered_map< u32, u64 > openCycles;
+    for ( const Frame &frame : callStack )
+    {
+        openCycles.emplace( frame.function, totalCycles - frame.startCycle );
+    }
+
+    std::vector< Function > result;
+    result.reserve( functions.size() );
+    for ( const auto &[ location, stats ] : functions )
+    {
+        const bool isRoot = location == ROOT_FUNCTION;
+        const u64 inclusiveCycles = isRoot ? totalCycles : stats.inclusiveCycles + openCycles[ location ];
+        result.push_back( { location, stats.address, stats.calls, stats.selfCycles, inclusiveCycles } );
+    }
+
+    std::sort( result.begin(), result.end(), []( const Function &a, const Function &b ) { return a.inclusiveCycles > b.inclusiveCycles; } );
+    return result;
+}
+
+std::vector< CycleProfiler::CallEdge > CycleProfiler::GetCallEdges() const
+{
+    std::unordered_map< u64, u64 > openCycles;
+    for ( const Frame &frame : callStack )
+    {
+        openCycles.emplace( GetEdgeKey( frame.caller, frame.function ), totalCycles - frame.startCycle );
+    }
+
+    std::vector< CallEdge > result;
+    result.reserve( edges.size() );
+    for ( const auto &[ key, stats ] : edges )
+    {
+        result.push_back( { static_cast< u32 >( key >> 32 ), static_cast< u32 >( key ), stats.calls, stats.inclusiveCycles + openCycles[ key ] } );
+    }
+
+    std::sort( result.begin(), result.end(), []( const CallEdge &a, const CallEdge &b ) { return a.inclusiveCycles > b.inclusiveCycles; } );
+    return result;
+}
+
+bool CycleProfiler::WriteReport( const char *fileName, u32 maxRows ) const
+{
+    FILE *file = fopen( fileName, "w" );
+    if ( file == nullptr )
+    {
+        return false;
+    }
+
+    const r64 total = ( totalCycles > 0 ) ? static_cast< r64 >( totalCycles ) : 1.0;
+    const std::vector< Function > functionList = GetFunctions();
+    std::unordered_map< u32, word > addresses;
+    for ( const Function &function : functionList )
+    {
+        addresses[ function.location ] = function.address;
+    }
+
+    fprintf( file, "Total cycles: %llu\n\nTop functions by inclusive cycles\n", totalCycles );
+    fprintf( file, "%-10s %10s %14s %7s %14s %7s\n", "function", "calls", "self", "self%", "inclusive", "incl%" );
+    for ( size_t i = 0; i < functionList.size() && i < maxRows; ++i )
+    {
+        const Function &function = functionList[ i ];
+        char name[ 16 ] = "root";
+        if ( function.location != ROOT_FUNCTION )
+        {
+            snprintf( name, sizeof( name ), "$%04X", function.address );
+        }
+        fprintf( file, "%-10s %10llu %14llu %6.2f%% %14llu %6.2f%%\n", name, function.calls, function.selfCycles, function.selfCycles * 100.0 / total,
+            function.inclusiveCycles, function.inclusiveCycles * 100.0 / total );
+    }
+
+    fprintf( file, "\nTop calls by inclusive cycles\n" );
+    const std::vector< CallEdge > edgeList = GetCallEdges();
+    for ( size_t i = 0; i < edgeList.size() && i < maxRows; ++i )
+    {
+        const CallEdge &edge = edgeList[ i ];
+        char caller[ 16 ] = "root";
+        if ( edge.caller != ROOT_FUNCTION )
+        {
+            snprintf( caller, sizeof( caller ), "$%04X", addresses[ edge.caller ] );
+        }
+        fprintf( file, "%-8s -> $%04X %10llu calls %14llu cycles %6.2f%%\n", caller, addresses[ edge.callee ], edge.calls, edge.inclusiveCycles,
+            edge.inclusiveCycles * 100.0 / total );
+    }
+
+    /* Locations below 0x8000 are CPU addresses, the others PRG ROM offsets shown with their 8KB bank */
+    std::vector< u32 > hottest( locationCycles.size() );
+    for ( u32 i = 0; i < hottest.size(); ++i )
+    {
+        hottest[ i ] = i;
+    }
+    const size_t rows = std::min< size_t >( maxRows, hottest.size() );
+    std::partial_sort( hottest.begin(), hottest.begin() + rows, hottest.end(), [ & ]( u32 a, u32 b ) { return locationCycles[ a ] > locationCycles[ b ]; } );
+
+    fprintf( file, "\nTop instructions by cycles\n" );
+    for ( size_t i = 0; i < rows && locationCycles[ hottest[ i ] ] > 0; ++i )
+    {
+        const u32 location = hottest[ i ];
+        char name[ 24 ];
+        if ( location < 0x8000 )
+        {
+            snprintf( name, sizeof( name ), "RAM $%04X", location );
+        }
+        else
+        {
+            const u32 prgOffset = location - 0x8000;
+            snprintf( name, sizeof( name ), "bank %u +$%04X", prgOffset / Memory::PRG_BANK_SIZE, prgOffset % Memory::PRG_BANK_SIZE );
+        }
+        fprintf( file, "%-16s %14llu %6.2f%%\n", name, locationCycles[ location ], locationCycles[ location ] * 100.0 / total );
+    }
+
+    return fclose( file ) == 0;
+}
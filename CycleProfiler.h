@@ -0,0 +1,158 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "Types.h"
+#include "Cpu.h"
+#include "Memory.h"
+
+
+class Cartridge;
+
+/*
+    Cycle profiler. Every executed instruction adds its cycles to a flat array indexed by
+    location: the CPU address below 0x8000 ( code running from RAM ) and 0x8000 plus the PRG
+    ROM offset above, so every bank has its own counters whatever is mapped at the time.
+
+    The call graph is built from a shadow call stack. JSR and interrupts push a frame with the
+    stack pointer the call will return to, RTS and RTI pop every frame at or below the new
+    stack pointer, which keeps it in sync with games that jump through the stack or drop
+    return addresses. A function is identified by its entry location, its self cycles are the
+    ones spent with it on top of the stack and its inclusive cycles the ones spent between its
+    outermost call and its return, so recursive calls are only counted once. The cycles taken
+    to enter an interrupt belong to its handler.
+ */
+
+class CycleProfiler
+{
+public:
+
+    /* Instructions executed outside of any call, from the reset vector on */
+    static constexpr u32 ROOT_FUNCTION      = 0xFFFFFFFF;
+    static constexpr u32 MAX_CALL_DEPTH     = 256;
+
+    struct Function
+    {
+        u32     location;
+        word    address;
+        u64     calls;
+        u64     selfCycles;
+        u64     inclusiveCycles;
+    };
+
+    struct CallEdge
+    {
+        u32     caller;
+        u32     callee;
+        u64     calls;
+        u64     inclusiveCycles;
+    };
+
+    CycleProfiler( const Cartridge *cartridge, const Memory *memory );
+    CycleProfiler( CycleProfiler & ) = delete;
+
+    void Clear();
+
+    /* Called once the instruction and the interrupt it was followed by are done, interruptCycles is 0 without interrupt */
+    inline void LogInstruction( word address, byte opcode, u32 cycles, u32 interruptCycles, const Cpu &cpu );
+
+    u32 GetLocation( word address ) const;
+    u64 GetCycles( word address ) const;
+    u64 GetLocationCycles( u32 location ) const;
+    u32 GetLocationCount() const;
+    u64 GetTotalCycles() const;
+    u64 GetMaxCycles() const;
+
+    /* Sorted by inclusive cycles, the frames still open are counted up to now */
+    std::vector< Function > GetFunctions() const;
+    std::vector< CallEdge > GetCallEdges() const;
+
+    /* Text report of the top functions, their callers and the hottest instructions */
+    bool WriteReport( const char *fileName, u32 maxRows ) const;
+
+private:
+
+    /* Frames on the call stack, the inclusive cycles are only added when the outermost one returns */
+    struct FunctionStats
+    {
+        word    address;
+        u64     calls;
+        u64     selfCycles;
+        u64     inclusiveCycles;
+        u32     activeFrames;
+    };
+
+    struct EdgeStats
+    {
+        u64     calls;
+        u64     inclusiveCycles;
+        u32     activeFrames;
+    };
+
+    struct Frame
+    {
+        u32     function;
+        u32     caller;
+        u64     startCycle;
+        byte    stackPointer;
+    };
+
+    std::vector< u64 >                          locationCycles;
+    u64                                         totalCycles;
+    const Memory                                *memory;
+
+    std::unordered_map< u32, FunctionStats >    functions;
+    std::unordered_map< u64, EdgeStats >        edges;
+    std::vector< Frame >                        callStack;
+
+    /* Function on top of the call stack, references to unordered_map elements survive rehashing */
+    FunctionStats                               *currentFunction;
+
+    void PushFrame( word address, byte stackPointer );
+    void PopFrames( byte stackPointer );
+
+    static u64 GetEdgeKey( u32 caller, u32 callee );
+};
+
+
+inline u32 CycleProfiler::GetLocation( word address ) const
+{
+    return ( address < 0x8000 ) ? address : 0x8000 + memory->GetPrgRomOffset( address );
+}
+
+inline void CycleProfiler::LogInstruction( word address, byte opcode, u32 cycles, u32 interruptCycles, const Cpu &cpu )
+{
+    static constexpr byte JSR_OPCODE = 0x20;
+    static constexpr byte RTI_OPCODE = 0x40;
+    static constexpr byte RTS_OPCODE = 0x60;
+
+    locationCycles[ GetLocation( address ) ] += cycles;
+    currentFunction->selfCycles += cycles;
+    totalCycles += cycles;
+
+    /* The stack pointer is read after the instruction, JSR pushed 2 bytes and an interrupt 3 more */
+    const bool isInterruptServiced = interruptCycles != 0;
+    const byte interruptBytes = isInterruptServiced ? 3 : 0;
+    if ( opcode == JSR_OPCODE )
+    {
+        /* With an interrupt right after the JSR the PC is already in the handler, the JSR target is the address the interrupt pushed */
+        const byte stackPointer = cpu.GetStackPointer();
+        const word target = isInterruptServiced
+            ? memory->Peek( 0x0100 | static_cast< byte >( stackPointer + 2 ) ) | ( memory->Peek( 0x0100 | static_cast< byte >( stackPointer + 3 ) ) << 8 )
+            : cpu.GetPC().value;
+        PushFrame( target, static_cast< byte >( stackPointer + interruptBytes + 2 ) );
+    }
+    else if ( opcode == RTS_OPCODE || opcode == RTI_OPCODE )
+    {
+        PopFrames( static_cast< byte >( cpu.GetStackPointer() + interruptBytes ) );
+    }
+
+    if ( isInterruptServiced )
+    {
+        PushFrame( cpu.GetPC().value, static_cast< byte >( cpu.GetStackPointer() + interruptBytes ) );
+        locationCycles[ GetLocation( cpu.GetPC().value ) ] += interruptCycles;
+        currentFunction->selfCycles += interruptCycles;
+        totalCycles += interruptCycles;
+    }
+}
@@ -0,0 +1,395 @@
+#include "BreakpointCondition.h"
+
+#include <assert.h>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+
+#include "../Cpu.h"
+#include "../Memory.h"
+#include "../Video.h"
+
+
+/* Recursive descent over the text, the bytecode is emitted in postfix order */
+class BreakpointCondition::Compiler
+{
+public:
+
+    Compiler( const char *text, std::vector< Instruction > &bytecode, std::string &error )
+        : text( text )
+        , position( 0 )
+        , depth( 0 )
+        , nesting( 0 )
+        , bytecode( bytecode )
+        , error( error )
+    {
+    }
+
+    bool Compile()
+    {
+        SkipSpaces();
+        if ( text[ position ] == '\0' )
+        {
+            return true;
+        }
+
+        if ( !ParseExpression( 0 ) )
+        {
+            return false;
+        }
+
+        SkipSpaces();
+        if ( text[ position ] != '\0' )
+        {
+            return Fail( "unexpected character" );
+        }
+        return true;
+    }
+
+private:
+
+    struct BinaryOperator
+    {
+        const char  *token;
+        byte        precedence;
+        Opcode      opcode;
+    };
+
+    struct Operand
+    {
+        const char  *name;
+        Opcode      opcode;
+    };
+
+    /* The two character tokens come first so "<=" isn't read as "<" */
+    static constexpr BinaryOperator BINARY_OPERATORS[] =
+    {
+        { "||", 1, Opcode::LogicalOr },
+        { "&&", 2, Opcode::LogicalAnd },
+        { "==", 6, Opcode::Equal },
+        { "!=", 6, Opcode::NotEqual },
+        { "<=", 7, Opcode::LessEqual },
+        { ">=", 7, Opcode::GreaterEqual },
+        { "|",  3, Opcode::Or },
+        { "^",  4, Opcode::Xor },
+        { "&",  5, Opcode::And },
+        { "<",  7, Opcode::Less },
+        { ">",  7, Opcode::Greater },
+        { "+",  8, Opcode::Add },
+        { "-",  8, Opcode::Subtract },
+    };
+
+    static constexpr Operand OPERANDS[] =
+    {
+        { "a",          Opcode::PushA },
+        { "x",          Opcode::PushX },
+        { "y",          Opcode::PushY },
+        { "p",          Opcode::PushP },
+        { "sp",         Opcode::PushSP },
+        { "pc",         Opcode::PushPC },
+        { "scanline",   Opcode::PushScanline },
+        { "dot",        Opcode::PushDot },
+        { "cycles",     Opcode::PushCycles },
+    };
+
+    const char                  *text;
+    u32                         position;
+    i32                         depth;
+    u32                         nesting;
+    std::vector< Instruction >  &bytecode;
+    std::string                 &error;
+
+    bool Fail( const char *reason )
+    {
+        char message[ 96 ];
+        snprintf( message, sizeof( message ), "Column %u: %s", position + 1, reason );
+        error = message;
+        return false;
+    }
+
+    /* Pushes add a value to the stack, binary operators take two and leave one */
+    bool Emit( Opcode opcode, i32 operand, i32 stackChange )
+    {
+        depth += stackChange;
+        if ( depth > static_cast< i32 >( MAX_STACK_DEPTH ) )
+        {
+            return Fail( "expression too deep" );
+        }
+        bytecode.push_back( { opcode, operand } );
+        return true;
+    }
+
+    /* Parentheses, brackets and unary operators recurse, bounded so a long run of them can't overflow the stack */
+    bool Enter()
+    {
+        if ( ++nesting > MAX_NESTING_DEPTH )
+        {
+            return Fail( "expression nested too deeply" );
+        }
+        return true;
+    }
+
+    void SkipSpaces()
+    {
+        while ( isspace( static_cast< unsigned char >( text[ position ] ) ) )
+        {
+            ++position;
+        }
+    }
+
+    bool ParseExpression( byte minimumPrecedence )
+    {
+        if ( !ParseUnary() )
+        {
+            return false;
+        }
+
+        while ( true )
+        {
+            SkipSpaces();
+            const BinaryOperator *binaryOperator = nullptr;
+            for ( const BinaryOperator &candidate : BINARY_OPERATORS )
+            {
+                if ( strncmp( &text[ position ], candidate.token, strlen( candidate.token ) ) == 0 )
+                {
+                    binaryOperator = &candidate;
+                    break;
+                }
+            }
+
+            if ( binaryOperator == nullptr || binaryOperator->precedence < minimumPrecedence )
+            {
+                return true;
+            }
+
+            /* Left associative, the right side only takes the operators that bind tighter */
+            position += static_cast< u32 >( strlen( binaryOperator->token ) );
+            if ( !ParseExpression( binaryOperator->precedence + 1 ) || !Emit( binaryOperator->opcode, 0, -1 ) )
+            {
+                return false;
+            }
+        }
+    }
+
+    bool ParseUnary()
+    {
+        SkipSpaces();
+        const char character = text[ position ];
+        if ( character == '!' || character == '-' || character == '~' )
+        {
+            ++position;
+            const Opcode opcode = ( character == '!' ) ? Opcode::Not : ( character == '-' ) ? Opcode::Negate : Opcode::Complement;
+            if ( !Enter() || !ParseUnary() )
+            {
+                return false;
+            }
+            --nesting;
+            return Emit( opcode, 0, 0 );
+        }
+        return ParsePrimary();
+    }
+
+    bool ParsePrimary()
+    {
+        SkipSpaces();
+        const char character = text[ position ];
+        if ( character == '(' || character == '[' )
+        {
+            const char closing = ( character == '(' ) ? ')' : ']';
+            ++position;
+            if ( !Enter() || !ParseExpression( 0 ) )
+            {
+                return false;
+            }
+            --nesting;
+
+            SkipSpaces();
+            if ( text[ position ] != closing )
+            {
+                return Fail( ( closing == ')' ) ? "missing )" : "missing ]" );
+            }
+            ++position;
+            if ( closing == ']' )
+            {
+                return Emit( Opcode::Load, 0, 0 );
+            }
+            return true;
+        }
+
+        if ( character == '$' || character == '%' || isdigit( static_cast< unsigned char >( character ) ) )
+        {
+            return ParseNumber();
+        }
+
+        if ( isalpha( static_cast< unsigned char >( character ) ) )
+        {
+            const u32 start = position;
+            while ( isalnum( static_cast< unsigned char >( text[ position ] ) ) )
+            {
+                ++position;
+            }
+
+            for ( const Operand &operand : OPERANDS )
+            {
+                if ( strlen( operand.name ) == position - start && strncasecmp( &text[ start ], operand.name, position - start ) == 0 )
+                {
+                    return Emit( operand.opcode, 0, 1 );
+                }
+            }
+
+            position = start;
+            return Fail( "unknown name" );
+        }
+
+        return Fail( ( character == '\0' ) ? "missing operand" : "unexpected character" );
+    }
+
+    bool ParseNumber()
+    {
+        u32 base = 10;
+        if ( text[ position ] == '$' )
+        {
+            base = 16;
+            ++position;
+        }
+        else if ( text[ position ] == '%' )
+        {
+            base = 2;
+            ++position;
+        }
+        else if ( text[ position ] == '0' && ( text[ position + 1 ] == 'x' || text[ position + 1 ] == 'X' ) )
+        {
+            base = 16;
+            position += 2;
+        }
+
+        u64 value = 0;
+        u32 digits = 0;
+        while ( true )
+        {
+            const char character = static_cast< char >( tolower( static_cast< unsigned char >( text[ position ] ) ) );
+            const u32 digit = isdigit( static_cast< unsigned char >( character ) ) ? character - '0' : ( character >= 'a' && character <= 'f' ) ? character - 'a' + 10 : base;
+            if ( digit >= base )
+            {
+                break;
+            }
+
+            value = value * base + digit;
+            if ( value > 0x7FFFFFFF )
+            {
+                return Fail( "number too large" );
+            }
+            ++digits;
+            ++position;
+        }
+
+        if ( digits == 0 )
+        {
+            return Fail( "missing digits" );
+        }
+        return Emit( Opcode::PushConstant, static_cast< i32 >( value ), 1 );
+    }
+};
+
+
+namespace
+{
+    /* The arithmetic is done unsigned so an overflow wraps around instead of being undefined */
+    inline i32 Wrap( u32 value )
+    {
+        return static_cast< i32 >( value );
+    }
+}
+
+
+bool BreakpointCondition::TryCompile( const char *text )
+{
+    std::vector< Instruction > compiled;
+    std::string compileError;
+    Compiler compiler( text, compiled, compileError );
+    if ( !compiler.Compile() )
+    {
+        error = compileError;
+        return false;
+    }
+
+    bytecode = std::move( compiled );
+    expression = text;
+    error.clear();
+    return true;
+}
+
+bool BreakpointCondition::IsAlwaysTrue() const
+{
+    return bytecode.empty();
+}
+
+const std::string& BreakpointCondition::GetExpression() const
+{
+    return expression;
+}
+
+const std::string& BreakpointCondition::GetError() const
+{
+    return error;
+}
+
+bool BreakpointCondition::Evaluate( const Cpu &cpu, const Memory &memory, const Video &video ) const
+{
+    if ( bytecode.empty() )
+    {
+        return true;
+    }
+
+    /* The compiler made sure the stack never goes past MAX_STACK_DEPTH nor below 0 */
+    i32 stack[ MAX_STACK_DEPTH ];
+    u32 top = 0;
+    for ( const Instruction &instruction : bytecode )
+    {
+        switch ( instruction.opcode )
+        {
+            case Opcode::PushConstant:  stack[ top++ ] = instruction.operand; break;
+            case Opcode::PushA:         stack[ top++ ] = cpu.GetAccumulator(); break;
+            case Opcode::PushX:         stack[ top++ ] = cpu.GetRegisterX(); break;
+            case Opcode::PushY:         stack[ top++ ] = cpu.GetRegisterY(); break;
+            case Opcode::PushP:         stack[ top++ ] = cpu.GetStateRegister(); break;
+            case Opcode::PushSP:        stack[ top++ ] = cpu.GetStackPointer(); break;
+            case Opcode::PushPC:        stack[ top++ ] = cpu.GetPC().value; break;
+            case Opcode::PushScanline:  stack[ top++ ] = static_cast< i32 >( video.GetCurrentScanline() ); break;
+            case Opcode::PushDot:       stack[ top++ ] = static_cast< i32 >( video.GetCurrentDot() ); break;
+            case Opcode::PushCycles:    stack[ top++ ] = static_cast< i32 >( cpu.GetCycles() & 0x7FFFFFFF ); break;
+
+            case Opcode::Load:          stack[ top - 1 ] = memory.Peek( static_cast< word >( stack[ top - 1 ] ) ); break;
+
+            case Opcode::Negate:        stack[ top - 1 ] = Wrap( 0u - static_cast< u32 >( stack[ top - 1 ] ) ); break;
+            case Opcode::Not:           stack[ top - 1 ] = !stack[ top - 1 ]; break;
+            case Opcode::Complement:    stack[ top - 1 ] = ~stack[ top - 1 ]; break;
+
+            default:
+            {
+                const i32 right = stack[ --top ];
+                i32 &left = stack[ top - 1 ];
+                switch ( instruction.opcode )
+                {
+                    case Opcode::Add:           left = Wrap( static_cast< u32 >( left ) + static_cast< u32 >( right ) ); break;
+                    case Opcode::Subtract:      left = Wrap( static_cast< u32 >( left ) - static_cast< u32 >( right ) ); break;
+                    case Opcode::And:           left = left & right; break;
+                    case Opcode::Or:            left = left | right; break;
+                    case Opcode::Xor:           left = left ^ right; break;
+                    case Opcode::Equal:         left = left == right; break;
+                    case Opcode::NotEqual:      left = left != right; break;
+                    case Opcode::Less:          left = left < right; break;
+                    case Opcode::LessEqual:     left = left <= right; break;
+                    case Opcode::Greater:       left = left > right; break;
+                    case Opcode::GreaterEqual:  left = left >= right; break;
+                    case Opcode::LogicalAnd:    left = left && right; break;
+                    case Opcode::LogicalOr:     left = left || right; break;
+                    default:                    assert( false );
+                }
+            }
+        }
+    }
+
+    return stack[ 0 ] != 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../Types.h"
+
+class Cpu;
+class Memory;
+class Video;
+
+/*
+    Condition of a breakpoint, e.g. "A == $40 && [$0300] > 5 && scanline == 100". The text is
+    compiled once into a small stack bytecode. Evaluating it is a loop over a handful of
+    instructions without any allocation, and only happens on the addresses with a breakpoint.
+
+    Operands are numbers in decimal, $hex, 0xhex or %binary, the registers A X Y P SP PC, the
+    PPU position scanline and dot, the CPU cycles and [address] for the byte at an address,
+    read without side effects. The binary operators from the lowest precedence are || && | ^ &
+    == != < <= > >= + -, the unary ones ! - ~. Values are 32 bit signed and wrap around on
+    overflow, comparisons and logical operators give 0 or 1 and both sides of && and || are
+    always evaluated. Parentheses, brackets and unary operators nest at most 64 deep.
+ */
+
+class BreakpointCondition
+{
+public:
+
+    static constexpr u32 MAX_STACK_DEPTH    = 16;
+    static constexpr u32 MAX_NESTING_DEPTH  = 64;
+
+    BreakpointCondition() = default;
+
+    /* An empty expression is always true. On failure the previous condition is kept and GetError tells why */
+    bool TryCompile( const char *text );
+
+    bool IsAlwaysTrue() const;
+    const std::string& GetExpression() const;
+    const std::string& GetError() const;
+
+    bool Evaluate( const Cpu &cpu, const Memory &memory, const Video &video ) const;
+
+private:
+
+    class Compiler;
+
+    enum class Opcode : byte
+    {
+        PushConstant = 0,
+        PushA,
+        PushX,
+        PushY,
+        PushP,
+        PushSP,
+        PushPC,
+        PushScanline,
+        PushDot,
+        PushCycles,
+
+        /* Replaces the address on top of the stack by the byte it points to */
+        Load,
+
+        Negate,
+        Not,
+        Complement,
+
+        Add,
+        Subtract,
+        And,
+        Or,
+        Xor,
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        LogicalAnd,
+        LogicalOr
+    };
+
+    struct Instruction
+    {
+        Opcode  opcode;
+        i32     operand;
+    };
+
+    std::vector< Instruction >  bytecode;
+    std::string                 expression;
+    std::string                 error;
+};
@@ -3,13 +3,23 @@
 #include "Debugger.h"
 #include "../Cpu.h"
 #include "../Memory.h"
+#include "../Video.h"
 #include "../CpuTypes.h"
+#include "../CodeDataLogger.h"
+#include "../CycleProfiler.h"
 #include "Imgui/imgui.h"
 
+#include <cmath>
+
 CpuDebugger::CpuDebugger()
     : instructionJump( false )
+    , codeDataLogger( nullptr )
+    , cycleProfiler( nullptr )
+    , breakpointAddressInput()
+    , breakpointConditionInput()
+    , isTracepointInput( false )
 {
-    //breakpoints.insert( 0xF1CE );
+    //AddBreakpoint( 0xF1CE );
 }
 
 void CpuDebugger::GenerateDisassemblerInstructionMask( Memory &memory )
@@ -28,7 +38,7 @@ void CpuDebugger::GenerateDisassemblerInstructionMask( Memory &memory )
         }
         else
         {
-            const byte opcode = memory.Read( i );
+            const byte opcode = memory.Peek( i );
             std::unordered_map< byte, OpcodeInfo >::const_iterator it = NES_OPCODE_INFO.find( opcode );
             if ( it != NES_OPCODE_INFO.end() )
             {
@@ -44,9 +54,20 @@ void CpuDebugger::GenerateDisassemblerInstructionMask( Memory &memory )
 
 bool CpuDebugger::IsAddresAnInstruction( u32 address ) const
 {
+    const byte flags = ( codeDataLogger != nullptr && address <= 0xFFFF ) ? codeDataLogger->GetFlagsAt( static_cast< word >( address ) ) : 0x00;
+    if ( flags != 0x00 )
+    {
+        return ( flags & CodeDataLogger::OPCODE ) != 0;
+    }
     return disassemblerInstructionMask[ address ];
 }
 
+bool CpuDebugger::IsAddressLoggedAsOperandOrData( u32 address ) const
+{
+    const byte flags = ( codeDataLogger != nullptr && address <= 0xFFFF ) ? codeDataLogger->GetFlagsAt( static_cast< word >( address ) ) : 0x00;
+    return flags != 0x00 && ( flags & CodeDataLogger::OPCODE ) == 0;
+}
+
 void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMode& mode )
 {
     ImGui::SetNextWindowPos( ImVec2( 0, 100 ) );
@@ -95,6 +116,12 @@ void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMod
             char yRegister[ 32 ];
             sprintf( yRegister, "Y: 0x%02X", cpu.GetRegisterY() );
             ImGui::Text( yRegister );
+
+            if ( codeDataLogger != nullptr )
+            {
+                ImGui::Text( "CDL: %u code, %u data of %u PRG bytes", codeDataLogger->CountBytes( CodeDataLogger::CODE ),
+                    codeDataLogger->CountBytes( CodeDataLogger::DATA ), codeDataLogger->GetPrgRomSize() );
+            }
         }
         ImGui::NextColumn();
         ImGui::Columns(1);
@@ -164,9 +191,9 @@ void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMod
                 u32 realRows = 0;
                 while ( realRows !=  rows )
                 {
-                    const byte opcode = memory.Read( endAddress );
+                    const byte opcode = memory.Peek( endAddress );
                     std::unordered_map< byte, OpcodeInfo >::const_iterator it = NES_OPCODE_INFO.find( opcode );
-                    if ( it == NES_OPCODE_INFO.end() )
+                    if ( it == NES_OPCODE_INFO.end() || IsAddressLoggedAsOperandOrData( endAddress ) )
                     {
                         endAddress++;
                     }
@@ -201,16 +228,19 @@ void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMod
                 instructionJump = true;
             }
 
+            /* Log scale, a handful of hot loops would leave every other instruction black otherwise */
+            const r64 maxCyclesLog = ( cycleProfiler != nullptr ) ? std::log1p( static_cast< r64 >( cycleProfiler->GetMaxCycles() ) ) : 0.0;
+
             u32 opcodeLengthOffset = 1;
             for ( u32 i = startAddress; i <= endAddress; i += opcodeLengthOffset ) 
             {
                 char text[128];
 
-                const byte opcode = memory.Read( i );
+                const byte opcode = memory.Peek( i );
                 std::unordered_map< byte, OpcodeInfo >::const_iterator it = NES_OPCODE_INFO.find( opcode );
-                if ( it == NES_OPCODE_INFO.end() )
+                if ( it == NES_OPCODE_INFO.end() || IsAddressLoggedAsOperandOrData( i ) )
                 {
-                    /* Invalid opcode */
+                    /* Invalid opcode, or a byte the logger saw used as an operand or as data */
                     opcodeLengthOffset = 1;
                     continue;
                 }
@@ -230,14 +260,14 @@ void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMod
                     }
                     else if ( opcodeLength == 2 )
                     {
-                        const byte opcodeData = memory.Read( i + 1 );
+                        const byte opcodeData = memory.Peek( i + 1 );
                         sprintf( data, "0x%02X", opcodeData );
                     }
                     else if ( opcodeLength == 3 )
                     {
                         word wordData;
-                        wordData = memory.Read( i + 2 ) << 8;
-                        wordData |= memory.Read( i + 1 );
+                        wordData = memory.Peek( i + 2 ) << 8;
+                        wordData |= memory.Peek( i + 1 );
                         sprintf( data, "0x%04X", wordData );
                     }
                     
@@ -251,16 +281,21 @@ void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMod
                     ImGui::PushStyleColor( ImGuiCol_Text, ImVec4( 0, 1, 0, 1 ) );
                 }
 
+                if ( cycleProfiler != nullptr )
+                {
+                    ComposeHeatBar( i, maxCyclesLog, lineHeight );
+                }
+
                 bool alreadySelected = HasAddressABreakpoint( i );
                 if ( ImGui::Selectable( text, alreadySelected, ImGuiSelectableFlags_AllowDoubleClick ) )
                 {
                     if ( alreadySelected )
                     {
-                        breakpoints.erase(i);
+                        RemoveBreakpoint( i );
                     }
                     else 
                     {
-                        breakpoints.insert(i);
+                        AddBreakpoint( i );
                     }
                 }
 
@@ -276,25 +311,180 @@ void CpuDebugger::ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMod
         }
     }
     ImGui::End();
+
+    ComposeBreakpointsView();
 }
 
-bool CpuDebugger::HasAddressABreakpoint( word address ) const
+void CpuDebugger::ComposeBreakpointsView()
 {
-    if (breakpoints.empty())
+    ImGui::SetNextWindowSize( ImVec2( 700, 400 ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Breakpoints" );
+
+    ImGui::PushItemWidth( 70 );
+    ImGui::InputText( "Address", breakpointAddressInput, sizeof( breakpointAddressInput ), ImGuiInputTextFlags_CharsHexadecimal );
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::PushItemWidth( 300 );
+    ImGui::InputText( "Condition", breakpointConditionInput, sizeof( breakpointConditionInput ) );
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Checkbox( "Tracepoint", &isTracepointInput );
+    ImGui::SameLine();
+    if ( ImGui::Button( "Add" ) )
     {
-        return false;
+        u32 address;
+        if ( sscanf( breakpointAddressInput, "%X", &address ) != 1 )
+        {
+            breakpointError = "Invalid address";
+        }
+        else if ( TryAddBreakpoint( static_cast< word >( address ), breakpointConditionInput, isTracepointInput, breakpointError ) )
+        {
+            breakpointError.clear();
+        }
+    }
+
+    if ( !breakpointError.empty() )
+    {
+        ImGui::TextColored( ImVec4( 1.f, 0.3f, 0.3f, 1.f ), "%s", breakpointError.c_str() );
     }
 
-    for ( word breakpoint : breakpoints ) 
+    ImGui::Separator();
+    ImGui::Columns( 4, "breakpoints" );
+    for ( auto it = breakpoints.begin(); it != breakpoints.end(); )
     {
-        if ( breakpoint == address)
+        const auto &[ address, breakpoint ] = *it;
+        ImGui::Text( "%s 0x%04X", breakpoint.isTracepoint ? "Trace" : "Break", address );
+        ImGui::NextColumn();
+        ImGui::Text( "%s", breakpoint.condition.IsAlwaysTrue() ? "always" : breakpoint.condition.GetExpression().c_str() );
+        ImGui::NextColumn();
+        ImGui::Text( "%llu hits", breakpoint.hits );
+        ImGui::NextColumn();
+
+        ImGui::PushID( address );
+        const bool isRemoved = ImGui::Button( "Remove" );
+        ImGui::PopID();
+        ImGui::NextColumn();
+
+        if ( isRemoved )
         {
-            return true;
+            breakpointMask.reset( it->first );
+            it = breakpoints.erase( it );
         }
-        else if (breakpoint > address)
+        else
         {
-            return false;
+            ++it;
         }
     }
-    return false;
+    ImGui::Columns( 1 );
+    ImGui::Separator();
+
+    if ( ImGui::Button( "Clear trace" ) )
+    {
+        traceLines.clear();
+    }
+
+    ImGui::BeginChild( "##trace" );
+    for ( const std::string &line : traceLines )
+    {
+        ImGui::TextUnformatted( line.c_str() );
+    }
+    ImGui::EndChild();
+
+    ImGui::End();
+}
+
+void CpuDebugger::SetCodeDataLogger( const CodeDataLogger *logger )
+{
+    codeDataLogger = logger;
+}
+
+void CpuDebugger::ComposeHeatBar( u32 address, r64 maxCyclesLog, float lineHeight ) const
+{
+    static constexpr float HEAT_BAR_WIDTH = 16.f;
+
+    /* From yellow for the coldest instruction to red for the hottest one, nothing when it never ran */
+    const u64 cycles = cycleProfiler->GetCycles( static_cast< word >( address ) );
+    const float heat = ( cycles > 0 && maxCyclesLog > 0.0 ) ? static_cast< float >( std::log1p( static_cast< r64 >( cycles ) ) / maxCyclesLog ) : 0.f;
+    const ImVec2 position = ImGui::GetCursorScreenPos();
+    if ( cycles > 0 )
+    {
+        const ImU32 color = ImGui::ColorConvertFloat4ToU32( ImVec4( 1.f, 1.f - heat, 0.f, 1.f ) );
+        ImGui::GetWindowDrawList()->AddRectFilled( position, ImVec2( position.x + HEAT_BAR_WIDTH, position.y + lineHeight ), color );
+    }
+
+    ImGui::Dummy( ImVec2( HEAT_BAR_WIDTH, lineHeight ) );
+    ImGui::SameLine();
+}
+
+void CpuDebugger::SetCycleProfiler( const CycleProfiler *profiler )
+{
+    cycleProfiler = profiler;
+}
+
+void CpuDebugger::AddBreakpoint( word address )
+{
+    std::string error;
+    TryAddBreakpoint( address, "", false, error );
+}
+
+void CpuDebugger::RemoveBreakpoint( word address )
+{
+    breakpoints.erase( address );
+    breakpointMask.reset( address );
+}
+
+bool CpuDebugger::HasAddressABreakpoint( word address ) const
+{
+    return breakpointMask[ address ];
+}
+
+bool CpuDebugger::TryAddBreakpoint( word address, const char *condition, bool isTracepoint, std::string &error )
+{
+    Breakpoint breakpoint = { BreakpointCondition(), 0, isTracepoint };
+    if ( !breakpoint.condition.TryCompile( condition ) )
+    {
+        error = breakpoint.condition.GetError();
+        return false;
+    }
+
+    breakpoints[ address ] = std::move( breakpoint );
+    breakpointMask.set( address );
+    return true;
+}
+
+bool CpuDebugger::ShouldBreak( const Cpu &cpu, const Memory &memory, const Video &video )
+{
+    const word address = cpu.GetPC().value;
+    if ( !breakpointMask[ address ] )
+    {
+        return false;
+    }
+
+    Breakpoint &breakpoint = breakpoints.at( address );
+    if ( !breakpoint.condition.Evaluate( cpu, memory, video ) )
+    {
+        return false;
+    }
+
+    ++breakpoint.hits;
+    if ( breakpoint.isTracepoint )
+    {
+        LogTracepoint( breakpoint, cpu, video );
+        return false;
+    }
+    return true;
+}
+
+void CpuDebugger::LogTracepoint( const Breakpoint &breakpoint, const Cpu &cpu, const Video &video )
+{
+    char line[ 128 ];
+    snprintf( line, sizeof( line ), "0x%04X #%llu  A:%02X X:%02X Y:%02X P:%02X SP:%02X  scanline %u dot %u", cpu.GetPC().value, breakpoint.hits,
+        cpu.GetAccumulator(), cpu.GetRegisterX(), cpu.GetRegisterY(), cpu.GetStateRegister(), cpu.GetStackPointer(), video.GetCurrentScanline(),
+        video.GetCurrentDot() );
+
+    if ( traceLines.size() == MAX_TRACE_LINES )
+    {
+        traceLines.pop_front();
+    }
+    traceLines.push_back( line );
 }
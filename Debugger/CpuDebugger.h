@@ -1,13 +1,19 @@
 #pragma once
 
-#include <set>
+#include <map>
 #include <bitset>
+#include <deque>
+#include <string>
 
 #include "../Types.h"
+#include "BreakpointCondition.h"
 
 
 class Cpu;
 class Memory;
+class Video;
+class CodeDataLogger;
+class CycleProfiler;
 
 enum class DebuggerMode : byte;
 
@@ -20,12 +26,52 @@ public:
     void ComposeView( Cpu &cpu, Memory &memory, u32 cycles, DebuggerMode& mode );
 
     /* Breakpoint handling */
+    void AddBreakpoint( word address );
+    void RemoveBreakpoint( word address );
     bool HasAddressABreakpoint( word address ) const;
 
+    /* Replaces the breakpoint at the address, tracepoints only log a line when their condition is true */
+    bool TryAddBreakpoint( word address, const char *condition, bool isTracepoint, std::string &error );
+
+    /* Called before every instruction, counts the hits and logs the tracepoints of the PC address */
+    bool ShouldBreak( const Cpu &cpu, const Memory &memory, const Video &video );
+
+    /* The PRG bytes the logger saw executed or read replace the guesses of the linear sweep */
+    void SetCodeDataLogger( const CodeDataLogger *logger );
+
+    /* Shows the cycles spent at every instruction as a heat bar next to it */
+    void SetCycleProfiler( const CycleProfiler *profiler );
+
 private:
+    static constexpr u32 MAX_TRACE_LINES = 256;
+
+    struct Breakpoint
+    {
+        BreakpointCondition condition;
+        u64                 hits;
+        bool                isTracepoint;
+    };
+
     bool                    instructionJump;
     std::bitset< 0x10000 >  disassemblerInstructionMask;
-    std::set< word >        breakpoints;
+
+    /* The bitmap is all that is checked on addresses without a breakpoint */
+    std::bitset< 0x10000 >  breakpointMask;
+    std::map< word, Breakpoint > breakpoints;
+    std::deque< std::string > traceLines;
+
+    const CodeDataLogger    *codeDataLogger;
+    const CycleProfiler     *cycleProfiler;
+
+    /* Breakpoints window inputs */
+    char                    breakpointAddressInput[ 8 ];
+    char                    breakpointConditionInput[ 128 ];
+    bool                    isTracepointInput;
+    std::string             breakpointError;
 
     bool IsAddresAnInstruction( u32 address ) const;
+    bool IsAddressLoggedAsOperandOrData( u32 address ) const;
+    void ComposeHeatBar( u32 address, r64 maxCyclesLog, float lineHeight ) const;
+    void ComposeBreakpointsView();
+    void LogTracepoint( const Breakpoint &breakpoint, const Cpu &cpu, const Video &video );
 };
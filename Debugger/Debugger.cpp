@@ -22,6 +22,8 @@ Debugger::Debugger( Cpu *cpu, Memory *memory, Video *video )
     , window( nullptr )
     , mode( DebuggerMode::IDLE )
     , reset( false )
+    , cycleProfiler( nullptr )
+    , memoryHeatmap( nullptr )
 {
 }
 
@@ -58,6 +60,7 @@ void Debugger::StartDebugger()
     ImGuiIO& io = ImGui::GetIO();
     io.FontGlobalScale = 2.f;
     videoDebugger.CreateTextures( *video );
+    heatmapDebugger.CreateTextures();
     cpuDebugger.GenerateDisassemblerInstructionMask( *memory );
 
     Update(0.f,0);
@@ -75,11 +78,29 @@ void Debugger::CloseDebugger()
     glfwTerminate();
 }
 
+void Debugger::SetCodeDataLogger( const CodeDataLogger *logger )
+{
+    cpuDebugger.SetCodeDataLogger( logger );
+}
+
+void Debugger::SetCycleProfiler( CycleProfiler *profiler )
+{
+    cycleProfiler = profiler;
+    cpuDebugger.SetCycleProfiler( profiler );
+}
+
+void Debugger::SetMemoryHeatmap( const MemoryHeatmap *heatmap )
+{
+    memoryHeatmap = heatmap;
+}
+
 DebuggerUpdateResult Debugger::Update( float deltaMilliseconds, u32 cycles )
 {
     memoryDebugger.UpdateWatcher( memory, mode );
 
-    if ( mode == DebuggerMode::BREAKPOINT  || mode == DebuggerMode::IDLE || cpuDebugger.HasAddressABreakpoint( cpu->GetPC().value ) )
+    /* Evaluated even while stepping so the hit counts and the tracepoints don't miss anything */
+    const bool isBreakpointHit = cpuDebugger.ShouldBreak( *cpu, *memory, *video );
+    if ( mode == DebuggerMode::BREAKPOINT  || mode == DebuggerMode::IDLE || isBreakpointHit )
     {
         /* if the emulator has reached a breakpoint we render the debugger at 60fps */
 
@@ -145,8 +166,10 @@ void Debugger::ComposeView( u32 cycles )
 
     ComposeEmulatorControlView();
     cpuDebugger.ComposeView( *cpu, *memory, cycles, mode );
-    videoDebugger.ComposeView( cycles, *video, *memory );
+    videoDebugger.ComposeView( cycles, *video );
     memoryDebugger.ComposeView( memory, video, mode );
+    profilerDebugger.ComposeView( cycleProfiler );
+    heatmapDebugger.ComposeView( memoryHeatmap );
 }
 
 void Debugger::ComposeEmulatorControlView()
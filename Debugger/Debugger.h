@@ -5,6 +5,8 @@
 #include "CpuDebugger.h"
 #include "VideoDebugger.h"
 #include "MemoryDebugger.h"
+#include "HeatmapDebugger.h"
+#include "ProfilerDebugger.h"
 
 
 enum class DebuggerMode : byte 
@@ -37,6 +39,15 @@ public:
     DebuggerUpdateResult Update( float deltaMilliseconds, u32 cycles );
     void CloseDebugger();
 
+    /* Lets the disassembler use the code and data the logger has seen so far */
+    void SetCodeDataLogger( const CodeDataLogger *logger );
+
+    /* Adds the profiler panel and the heat bars of the disassembly */
+    void SetCycleProfiler( CycleProfiler *profiler );
+
+    /* Adds the memory access heatmap window */
+    void SetMemoryHeatmap( const MemoryHeatmap *heatmap );
+
 private:
     
     /* Systems */
@@ -48,6 +59,11 @@ private:
     CpuDebugger     cpuDebugger;
     VideoDebugger   videoDebugger;
     MemoryDebugger  memoryDebugger;
+    ProfilerDebugger profilerDebugger;
+    HeatmapDebugger heatmapDebugger;
+
+    CycleProfiler   *cycleProfiler;
+    const MemoryHeatmap *memoryHeatmap;
 
     GLFWwindow      *window;
     DebuggerMode    mode;
@@ -0,0 +1,82 @@
+#include "HeatmapDebugger.h"
+
+#include "Imgui/imgui.h"
+#include "ImguiWrapper/imgui_impl_glfw_gl3.h"
+
+
+HeatmapDebugger::HeatmapDebugger()
+    : cpuHeatmapTextureID( nullptr )
+    , cpuHeatmapBuffer( MemoryHeatmap::CPU_ADDRESS_SPACE_SIZE )
+    , ppuHeatmapTextureID( nullptr )
+    , ppuHeatmapBuffer( MemoryHeatmap::PPU_ADDRESS_SPACE_SIZE )
+{
+}
+
+void HeatmapDebugger::CreateTextures()
+{
+    const u32 width = MemoryHeatmap::RENDER_WIDTH;
+
+    ImGuiGLFW::Texture cpuHeatmapTexture = { 0, width, MemoryHeatmap::CPU_ADDRESS_SPACE_SIZE / width, cpuHeatmapBuffer.data() };
+    cpuHeatmapTextureID = ImGuiGLFW::CreateTexture( cpuHeatmapTexture );
+
+    ImGuiGLFW::Texture ppuHeatmapTexture = { 0, width, MemoryHeatmap::PPU_ADDRESS_SPACE_SIZE / width, ppuHeatmapBuffer.data() };
+    ppuHeatmapTextureID = ImGuiGLFW::CreateTexture( ppuHeatmapTexture );
+}
+
+void HeatmapDebugger::ComposeView( const MemoryHeatmap *heatmap )
+{
+    if ( heatmap == nullptr )
+    {
+        return;
+    }
+
+    ImGui::SetNextWindowSize( ImVec2( 560, 800 ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Memory Heatmap" );
+
+    ImGui::TextColored( ImVec4( 1.f, 0.3f, 0.3f, 1.f ), "Write" );
+    ImGui::SameLine();
+    ImGui::TextColored( ImVec4( 0.3f, 1.f, 0.3f, 1.f ), "Read" );
+    ImGui::SameLine();
+    ImGui::TextColored( ImVec4( 0.3f, 0.3f, 1.f, 1.f ), "Execute" );
+    ImGui::SameLine();
+    ImGui::Text( "Self-modifying code: %u bytes", heatmap->CountSelfModifyingCodeBytes() );
+
+    ImGui::Text( "CPU 0x0000 - 0xFFFF" );
+    ComposeHeatmapImage( *heatmap, MemoryHeatmap::AddressSpace::Cpu, cpuHeatmapTextureID, cpuHeatmapBuffer.data() );
+
+    ImGui::Text( "PPU 0x0000 - 0x3FFF" );
+    ComposeHeatmapImage( *heatmap, MemoryHeatmap::AddressSpace::Ppu, ppuHeatmapTextureID, ppuHeatmapBuffer.data() );
+
+    ImGui::End();
+}
+
+void HeatmapDebugger::ComposeHeatmapImage( const MemoryHeatmap &heatmap, MemoryHeatmap::AddressSpace space, ImTextureID textureID, RGB *buffer )
+{
+    const u32 width = MemoryHeatmap::RENDER_WIDTH;
+    const u32 height = MemoryHeatmap::GetAddressSpaceSize( space ) / width;
+
+    heatmap.Render( space, buffer );
+    ImGui::Image( textureID, ImVec2( width * HEATMAP_SCALE, height * HEATMAP_SCALE ) );
+
+    /* One pixel per byte, the hovered one is shown with its counters */
+    if ( ImGui::IsItemHovered() )
+    {
+        const ImVec2 imagePosition = ImGui::GetItemRectMin();
+        const ImVec2 mousePosition = ImGui::GetIO().MousePos;
+        const u32 x = static_cast< u32 >( ( mousePosition.x - imagePosition.x ) / HEATMAP_SCALE );
+        const u32 y = static_cast< u32 >( ( mousePosition.y - imagePosition.y ) / HEATMAP_SCALE );
+        if ( x < width && y < height )
+        {
+            const word address = static_cast< word >( y * width + x );
+            ImGui::BeginTooltip();
+            ImGui::Text( "0x%04X", address );
+            ImGui::Text( "Reads: %u", heatmap.GetCounter( space, MemoryHeatmap::Access::Read, address ) );
+            ImGui::Text( "Writes: %u", heatmap.GetCounter( space, MemoryHeatmap::Access::Write, address ) );
+            if ( space == MemoryHeatmap::AddressSpace::Cpu )
+            {
+                ImGui::Text( "Executions: %u", heatmap.GetCounter( space, MemoryHeatmap::Access::Execute, address ) );
+            }
+            ImGui::EndTooltip();
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "../Types.h"
+#include "../MemoryHeatmap.h"
+
+class HeatmapDebugger
+{
+public:
+    HeatmapDebugger();
+
+    void CreateTextures();
+    void ComposeView( const MemoryHeatmap *heatmap );
+
+private:
+    static constexpr float HEATMAP_SCALE = 2.f;
+
+    using ImTextureID = void *;
+
+    ImTextureID             cpuHeatmapTextureID;
+    std::vector< RGB >      cpuHeatmapBuffer;
+    ImTextureID             ppuHeatmapTextureID;
+    std::vector< RGB >      ppuHeatmapBuffer;
+
+    void ComposeHeatmapImage( const MemoryHeatmap &heatmap, MemoryHeatmap::AddressSpace space, ImTextureID textureID, RGB *buffer );
+};
@@ -12,6 +12,7 @@
 MemoryDebugger::MemoryDebugger()
     : watcherAsBreakpoint( false )
     , currentView( CurrentSelectedView::Memory )
+    , ppuMemory( MEMORY_VIEW_MEMORY_SIZE )
 {
 }
 
@@ -39,8 +40,9 @@ void MemoryDebugger::ComposeView( const Memory *memory, const Video *video, Debu
         if ( ImGui::BeginTabItem( "Video" ) )
         {
             currentView = CurrentSelectedView::Video;
-            ComposeMemoryHexContentView( video->GetPPUMemory(), mode );
-            ComposeMemoryWatcherView( video->GetPPUMemory(), mode );
+            UpdatePpuMemory( video );
+            ComposeMemoryHexContentView( ppuMemory.data(), mode );
+            ComposeMemoryWatcherView( ppuMemory.data(), mode );
             ImGui::EndTabItem();
         }
     }
@@ -50,6 +52,15 @@ void MemoryDebugger::ComposeView( const Memory *memory, const Video *video, Debu
     ImGui::End();
 }
 
+void MemoryDebugger::UpdatePpuMemory( const Video *video )
+{
+    /* The nametables aren't in the PPU memory map, Read applies the mirroring and the 0x3FFF address mask */
+    for ( u32 address = 0; address < MEMORY_VIEW_MEMORY_SIZE; ++address )
+    {
+        ppuMemory[ address ] = video->Read( static_cast< word >( MEMORY_VIEW_BASE_ADDRESS + address ) );
+    }
+}
+
 void MemoryDebugger::ComposeMemoryHexContentView( const byte *map, DebuggerMode& mode  )
 {
     assert( map != nullptr );
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "../Types.h"
 
@@ -31,8 +32,12 @@ private:
     bool                    watcherAsBreakpoint;
     CurrentSelectedView     currentView;
 
+    /* Copy of the PPU address space as the PPU sees it, refreshed while the view is shown */
+    std::vector< byte >     ppuMemory;
+
     void ComposeMemoryHexContentView( const byte *map, DebuggerMode& mode  );
     void ComposeMemoryWatcherView( const byte *map, DebuggerMode& mode  );
+    void UpdatePpuMemory( const Video *video );
     bool HasWatcherDataChanged( const byte * const memory ) const;
     void UpdateWatcherData( const byte * const memory );
 };
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "ProfilerDebugger.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "Imgui/imgui.h"
+
+#include "../CycleProfiler.h"
+
+
+ProfilerDebugger::ProfilerDebugger()
+    : sortBySelfCycles( false )
+{
+}
+
+void ProfilerDebugger::ComposeView( CycleProfiler *profiler )
+{
+    if ( profiler == nullptr )
+    {
+        return;
+    }
+
+    ImGui::SetNextWindowPos( ImVec2( 1300, 100 ), ImGuiCond_FirstUseEver );
+    ImGui::SetNextWindowSize( ImVec2( 900, 700 ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Profiler" );
+
+    const u64 totalCycles = profiler->GetTotalCycles();
+    const r64 total = ( totalCycles > 0 ) ? static_cast< r64 >( totalCycles ) : 1.0;
+    ImGui::Text( "Total cycles: %llu", totalCycles );
+    ImGui::SameLine();
+    if ( ImGui::Button( "Clear" ) )
+    {
+        profiler->Clear();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox( "Sort by self cycles", &sortBySelfCycles );
+
+    /* Cycles per 8KB PRG bank, the locations after 0x8000 are PRG ROM offsets */
+    {
+        u64 ramCycles = 0;
+        for ( u32 location = 0; location < 0x8000; ++location )
+        {
+            ramCycles += profiler->GetLocationCycles( location );
+        }
+        ImGui::Text( "RAM: %.2f%%", ramCycles * 100.0 / total );
+
+        for ( u32 bankStart = 0x8000; bankStart < profiler->GetLocationCount(); bankStart += Memory::PRG_BANK_SIZE )
+        {
+            u64 bankCycles = 0;
+            for ( u32 location = bankStart; location < bankStart + Memory::PRG_BANK_SIZE; ++location )
+            {
+                bankCycles += profiler->GetLocationCycles( location );
+            }
+            ImGui::SameLine();
+            ImGui::Text( " Bank %u: %.2f%%", ( bankStart - 0x8000 ) / Memory::PRG_BANK_SIZE, bankCycles * 100.0 / total );
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::Text( "Top functions by %s cycles", sortBySelfCycles ? "self" : "inclusive" );
+
+    std::vector< CycleProfiler::Function > functions = profiler->GetFunctions();
+    if ( sortBySelfCycles )
+    {
+        std::sort( functions.begin(), functions.end(), []( const CycleProfiler::Function &a, const CycleProfiler::Function &b ) { return a.selfCycles > b.selfCycles; } );
+    }
+
+    ImGui::Columns( 6, "##functions" );
+    ImGui::Text( "Function" );      ImGui::NextColumn();
+    ImGui::Text( "Calls" );         ImGui::NextColumn();
+    ImGui::Text( "Self" );          ImGui::NextColumn();
+    ImGui::Text( "Self %%" );       ImGui::NextColumn();
+    ImGui::Text( "Inclusive" );     ImGui::NextColumn();
+    ImGui::Text( "Inclusive %%" );  ImGui::NextColumn();
+    ImGui::Separator();
+
+    for ( size_t i = 0; i < functions.size() && i < MAX_FUNCTION_ROWS; ++i )
+    {
+        const CycleProfiler::Function &function = functions[ i ];
+        if ( function.location == CycleProfiler::ROOT_FUNCTION )
+        {
+            ImGui::Text( "root ( $%04X )", function.address );
+        }
+        else
+        {
+            ImGui::Text( "$%04X", function.address );
+        }
+        ImGui::NextColumn();
+        ImGui::Text( "%llu", function.calls );                                  ImGui::NextColumn();
+        ImGui::Text( "%llu", function.selfCycles );                             ImGui::NextColumn();
+        ImGui::Text( "%.2f", function.selfCycles * 100.0 / total );             ImGui::NextColumn();
+        ImGui::Text( "%llu", function.inclusiveCycles );                        ImGui::NextColumn();
+        ImGui::Text( "%.2f", function.inclusiveCycles * 100.0 / total );        ImGui::NextColumn();
+    }
+
+    ImGui::Columns( 1 );
+    ImGui::End();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../Types.h"
+
+class CycleProfiler;
+
+class ProfilerDebugger
+{
+public:
+    ProfilerDebugger();
+
+    void ComposeView( CycleProfiler *profiler );
+
+private:
+    static constexpr u32 MAX_FUNCTION_ROWS = 32;
+
+    bool    sortBySelfCycles;
+};
@@ -4,7 +4,6 @@
 
 #include "ImguiWrapper/imgui_impl_glfw_gl3.h"
 #include "../Video.h"
-#include "../Memory.h"
 #include "../PaletteColors.h"
 
 
@@ -62,8 +61,11 @@ void VideoDebugger::CreateTextures( const Video &video )
     nametableTextureID = ImGuiGLFW::CreateTexture( nametableTexture );
 }
 
-void VideoDebugger::ComposeView( u32 cycles, const Video &video, const Memory &memory )
+void VideoDebugger::ComposeView( u32 cycles, const Video &video )
 {
+    /* Converts the palette indices into the buffer the texture points to */
+    video.GetFrameBuffer();
+
     ImGui::SetNextWindowSize( ImVec2( 560, 510 ), ImGuiCond_FirstUseEver );
     ImGui::Begin( "FrameBuffer" );
     ImGui::Image( frameBufferTextureID, ImVec2( 512, 480 ) );
@@ -113,7 +115,7 @@ void VideoDebugger::ComposeView( u32 cycles, const Video &video, const Memory &m
         ImGui::End();
     }
 
-    UpdateNameTable( video, memory, 0x2000, nametableTextureBuffer );
+    UpdateNameTable( video, 0x2000, nametableTextureBuffer );
     ImGui::SetNextWindowSize( ImVec2( 560, 560 ), ImGuiCond_FirstUseEver );
     ImGui::Begin( "Nametable 0" );
     ImGui::Image( nametableTextureID, ImVec2( 512, 500 ) );
@@ -194,14 +196,10 @@ void VideoDebugger::UpdateTexturesOfCurrentPalettes( const Video &video, word ad
     }
 }
 
-void VideoDebugger::UpdateNameTable( const Video &video, const Memory &memory, word nametableAddress, RGB *buffer )
+void VideoDebugger::UpdateNameTable( const Video &video, word nametableAddress, RGB *buffer )
 {
-    /* We use the mal directly since reading some of the values in the map through memory.Read() has side effects */
-    const byte *const memoryMap = memory.GetMemoryMap();
-    assert( memoryMap != nullptr );
-
-    /* Check which pattern table is selected at the moment */
-    const byte ppuControl = memoryMap[ Video::PPUCTRL_REGISTER ];
+    /* Check which pattern table is selected at the moment, peeking since reading the registers has side effects */
+    const byte ppuControl = video.PeekRegister( Video::PPUCTRL_REGISTER );
     const u32 patternTableAddress = ( ppuControl & 0b0001'0000 ) ? 0x1000 : 0x0000;
 
     /* Traverse the nametable and construct the background */
@@ -3,7 +3,6 @@
 #include "../Types.h"
 
 class Video;
-class Memory;
 
 class VideoDebugger
 {
@@ -12,7 +11,7 @@ public:
     ~VideoDebugger();
 
     void CreateTextures( const Video &video );
-    void ComposeView( u32 cycles, const Video &video, const Memory &memory );
+    void ComposeView( u32 cycles, const Video &video );
 
 private:
     constexpr static byte palette[4] = { 0x0F, 0x2C, 0x38, 0x12 };
@@ -47,5 +46,5 @@ private:
     void GenerateNesPaletteTexture();
     void UpdateUniversalBackgroundColour( const Video &video );
     void UpdateTexturesOfCurrentPalettes( const Video &video, word address, RGB **buffer );
-    void UpdateNameTable( const Video &video, const Memory &memory, word nametableAddress, RGB *buffer );
+    void UpdateNameTable( const Video &video, word nametableAddress, RGB *buffer );
 };
\ No newline at end of file
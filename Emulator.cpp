@@ -0,0 +1,125 @@
+#include "Emulator.h"
+
+#include "CpuTypes.h"
+#include "MemoryHeatmap.h"
+
+
+Emulator::Emulator( const Cartridge *cartridge )
+    : video( cartridge )
+    , memory( cartridge, &video, &audio )
+    , cpu( &memory )
+    , tracer( nullptr )
+    , memoryHeatmap( nullptr )
+    , frameCycles( 0u )
+{
+    video.Init( &memory, &cpu );
+    audio.Init( &memory, &cpu );
+}
+
+void Emulator::Reset()
+{
+    memory.Reset();
+    video.Reset();
+    audio.Reset();
+    cpu.Reset();
+    frameCycles = 0u;
+}
+
+void Emulator::SoftReset()
+{
+    /* A DMA requested right before the reset never happens */
+    memory.AcknowledgeOamDma();
+    memory.AcknowledgeDmcDma();
+    video.SoftReset();
+    audio.Reset();
+    cpu.SoftReset();
+    frameCycles = 0u;
+}
+
+u32 Emulator::StepInstruction()
+{
+    if ( IsFrameCompleted() )
+    {
+        frameCycles = 0u;
+    }
+
+    const u32 instructionCycles = ( tracer != nullptr ) ? cpu.Update( *tracer ) : cpu.Update();
+    frameCycles += instructionCycles;
+    video.Update( instructionCycles );
+    audio.Update( instructionCycles );
+
+    if ( IsFrameCompleted() )
+    {
+        video.EndFrame();
+        audio.EndFrame();
+        if ( memoryHeatmap != nullptr )
+        {
+            memoryHeatmap->Decay();
+        }
+    }
+
+    return frameCycles;
+}
+
+void Emulator::SetTracer( InstructionTracer *instructionTracer )
+{
+    tracer = instructionTracer;
+}
+
+void Emulator::SetCodeDataLogger( CodeDataLogger *logger )
+{
+    cpu.SetCodeDataLogger( logger );
+    memory.SetCodeDataLogger( logger );
+}
+
+void Emulator::SetCycleProfiler( CycleProfiler *profiler )
+{
+    cpu.SetCycleProfiler( profiler );
+}
+
+void Emulator::SetMemoryHeatmap( MemoryHeatmap *heatmap )
+{
+    memoryHeatmap = heatmap;
+    cpu.SetMemoryHeatmap( heatmap );
+    memory.SetMemoryHeatmap( heatmap );
+    video.SetMemoryHeatmap( heatmap );
+}
+
+void Emulator::RunFrame()
+{
+    do
+    {
+        StepInstruction();
+    }
+    while ( !IsFrameCompleted() );
+}
+
+bool Emulator::IsFrameCompleted() const
+{
+    return frameCycles >= AVERAGE_CYCLES_PER_FRAME;
+}
+
+Cpu& Emulator::GetCpu()
+{
+    return cpu;
+}
+
+Memory& Emulator::GetMemory()
+{
+    return memory;
+}
+
+Video& Emulator::GetVideo()
+{
+    return video;
+}
+
+Audio& Emulator::GetAudio()
+{
+    return audio;
+}
+
+const byte* Emulator::GetRam() const
+{
+    return memory.GetMemoryMap();
+}
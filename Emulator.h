@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Types.h"
+#include "Video.h"
+#include "Audio.h"
+#include "Memory.h"
+#include "Cpu.h"
+
+
+class Cartridge;
+class InstructionTracer;
+class CodeDataLogger;
+class CycleProfiler;
+class MemoryHeatmap;
+
+/*
+    Owns the systems of one NES instance for a given cartridge. The cartridge is only read,
+    so the same Cartridge can be shared between several emulators.
+ */
+
+class Emulator
+{
+public:
+
+    static constexpr u32 RAM_SIZE = 2_KB;
+
+    Emulator( const Cartridge *cartridge );
+    Emulator( Emulator & ) = delete;
+
+    void Reset();
+
+    /* Reset button, the CPU, PPU and APU are reset but the RAM, PRG RAM and PPU memory keep their contents */
+    void SoftReset();
+
+    /* Executes one instruction and returns the cycles spent in the current frame */
+    u32 StepInstruction();
+
+    /* Records every executed instruction while a tracer is set, nullptr disables tracing */
+    void SetTracer( InstructionTracer *instructionTracer );
+
+    /* Logs which PRG bytes are code and which are data while a logger is set, nullptr disables logging */
+    void SetCodeDataLogger( CodeDataLogger *logger );
+
+    /* Counts the cycles spent at every instruction and in every subroutine while a profiler is set, nullptr disables profiling */
+    void SetCycleProfiler( CycleProfiler *profiler );
+
+    /* Counts the reads, writes and executions of every byte while a heatmap is set, decayed every frame, nullptr disables it */
+    void SetMemoryHeatmap( MemoryHeatmap *heatmap );
+
+    /* Runs until the end of the current frame */
+    void RunFrame();
+    bool IsFrameCompleted() const;
+
+    /* Systems */
+    Cpu&            GetCpu();
+    Memory&         GetMemory();
+    Video&          GetVideo();
+    Audio&          GetAudio();
+    const byte*     GetRam() const;
+
+private:
+    Video       video;
+    Audio       audio;
+    Memory      memory;
+    Cpu         cpu;
+
+    InstructionTracer   *tracer;
+    MemoryHeatmap       *memoryHeatmap;
+    u32                 frameCycles;
+};
@@ -0,0 +1,204 @@
+#include "EnvironmentPool.h"
+
+#include <assert.h>
+#include <cstring>
+#include <system_error>
+
+#include "Emulator.h"
+
+
+EnvironmentPool::EnvironmentPool( const Cartridge *cartridge, u32 environmentCount, u32 threadCount, u32 downsampleFactor )
+    : downsampleFactor( downsampleFactor )
+    , request( { nullptr, nullptr, nullptr } )
+    , stepGeneration( 0u )
+    , pendingWorkers( 0u )
+    , quit( false )
+{
+    assert( cartridge != nullptr );
+    assert( environmentCount > 0 );
+    assert( downsampleFactor > 0 && Video::NES_VIDEO_WIDTH % downsampleFactor == 0 && Video::NES_VIDEO_HEIGHT % downsampleFactor == 0 );
+
+    environments.reserve( environmentCount );
+    for ( u32 i = 0; i < environmentCount; ++i )
+    {
+        environments.emplace_back( std::make_unique< Emulator >( cartridge ) );
+    }
+
+    /* There is no point in having threads without environments to step */
+    threadCount = ( threadCount == 0 ) ? 1 : threadCount;
+    threadCount = ( threadCount > environmentCount ) ? environmentCount : threadCount;
+
+    /* The threads already started must be joined before the exception leaves, a joinable std::thread terminates the process */
+    workers.reserve( threadCount - 1 );
+    try
+    {
+        for ( u32 threadIndex = 1; threadIndex < threadCount; ++threadIndex )
+        {
+            workers.emplace_back( &EnvironmentPool::WorkerLoop, this, threadIndex );
+        }
+    }
+    catch ( const std::system_error & )
+    {
+        StopWorkers();
+        throw;
+    }
+}
+
+EnvironmentPool::~EnvironmentPool()
+{
+    StopWorkers();
+}
+
+void EnvironmentPool::StopWorkers()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        quit = true;
+    }
+    stepStarted.notify_all();
+
+    for ( std::thread &worker : workers )
+    {
+        worker.join();
+    }
+}
+
+void EnvironmentPool::Reset()
+{
+    for ( std::unique_ptr< Emulator > &environment : environments )
+    {
+        environment->Reset();
+    }
+}
+
+void EnvironmentPool::ResetEnvironment( u32 environment )
+{
+    assert( environment < environments.size() );
+    environments[ environment ]->Reset();
+}
+
+void EnvironmentPool::Step( const byte *inputs, byte *observations, byte *ramSnapshots )
+{
+    assert( inputs != nullptr );
+
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        request = { inputs, observations, ramSnapshots };
+        pendingWorkers = static_cast< u32 >( workers.size() );
+        ++stepGeneration;
+    }
+    stepStarted.notify_all();
+
+    StepBatch( 0 );
+
+    std::unique_lock< std::mutex > lock( mutex );
+    stepFinished.wait( lock, [ this ]() { return pendingWorkers == 0; } );
+}
+
+void EnvironmentPool::WorkerLoop( u32 threadIndex )
+{
+    u64 lastGeneration = 0u;
+    while ( true )
+    {
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            stepStarted.wait( lock, [ this, lastGeneration ]() { return quit || stepGeneration != lastGeneration; } );
+            if ( quit )
+            {
+                return;
+            }
+            lastGeneration = stepGeneration;
+        }
+
+        StepBatch( threadIndex );
+
+        bool lastWorker = false;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            lastWorker = ( --pendingWorkers == 0 );
+        }
+
+        if ( lastWorker )
+        {
+            stepFinished.notify_one();
+        }
+    }
+}
+
+void EnvironmentPool::StepBatch( u32 threadIndex )
+{
+    /* Each thread owns a contiguous range of environments so the output buffers are never shared */
+    const u32 environmentCount = GetEnvironmentCount();
+    const u32 threadCount = GetThreadCount();
+    const u32 first = ( environmentCount * threadIndex ) / threadCount;
+    const u32 last = ( environmentCount * ( threadIndex + 1 ) ) / threadCount;
+    const u32 observationSize = GetObservationSize();
+
+    for ( u32 i = first; i < last; ++i )
+    {
+        Emulator &emulator = *environments[ i ];
+        emulator.GetMemory().GetController( 0 ).SetButtons( request.inputs[ i ] );
+        emulator.RunFrame();
+
+        if ( request.observations != nullptr )
+        {
+            WriteObservation( emulator.GetVideo().GetFrameBuffer(), &request.observations[ i * observationSize ] );
+        }
+
+        if ( request.ramSnapshots != nullptr )
+        {
+            memcpy( &request.ramSnapshots[ i * Emulator::RAM_SIZE ], emulator.GetRam(), Emulator::RAM_SIZE );
+        }
+    }
+}
+
+void EnvironmentPool::WriteObservation( const RGB *frameBuffer, byte *observation ) const
+{
+    /* Box filter of downsampleFactor x downsampleFactor pixels over the BT.601 luma in 8.8 fixed point */
+    const u32 width = GetObservationWidth();
+    const u32 height = GetObservationHeight();
+    const u32 samples = downsampleFactor * downsampleFactor;
+
+    for ( u32 y = 0; y < height; ++y )
+    {
+        for ( u32 x = 0; x < width; ++x )
+        {
+            u32 luma = 0;
+            for ( u32 sampleY = 0; sampleY < downsampleFactor; ++sampleY )
+            {
+                const RGB *row = &frameBuffer[ ( y * downsampleFactor + sampleY ) * Video::NES_VIDEO_WIDTH + x * downsampleFactor ];
+                for ( u32 sampleX = 0; sampleX < downsampleFactor; ++sampleX )
+                {
+                    luma += 77 * row[ sampleX ].red + 150 * row[ sampleX ].green + 29 * row[ sampleX ].blue;
+                }
+            }
+
+            observation[ y * width + x ] = static_cast< byte >( ( luma / samples ) >> 8 );
+        }
+    }
+}
+
+u32 EnvironmentPool::GetEnvironmentCount() const
+{
+    return static_cast< u32 >( environments.size() );
+}
+
+u32 EnvironmentPool::GetObservationWidth() const
+{
+    return Video::NES_VIDEO_WIDTH / downsampleFactor;
+}
+
+u32 EnvironmentPool::GetObservationHeight() const
+{
+    return Video::NES_VIDEO_HEIGHT / downsampleFactor;
+}
+
+u32 EnvironmentPool::GetObservationSize() const
+{
+    return GetObservationWidth() * GetObservationHeight();
+}
+
+u32 EnvironmentPool::GetThreadCount() const
+{
+    return static_cast< u32 >( workers.size() ) + 1;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Types.h"
+
+
+class Cartridge;
+class Emulator;
+
+/*
+    Steps N emulators that share the same cartridge one frame at a time. The environments are
+    split into one contiguous batch per thread and the calling thread works on the first batch,
+    so a step only has to wake the workers and wait for them. Nothing is allocated after
+    construction: inputs, observations and RAM snapshots live in caller provided buffers.
+ */
+
+class EnvironmentPool
+{
+public:
+
+    /* Throws std::system_error when a worker thread can't be created, the threads already started are joined first */
+    EnvironmentPool( const Cartridge *cartridge, u32 environmentCount, u32 threadCount, u32 downsampleFactor );
+    EnvironmentPool( EnvironmentPool & ) = delete;
+    ~EnvironmentPool();
+
+    void Reset();
+    void ResetEnvironment( u32 environment );
+
+    /*
+        inputs:         environmentCount bytes, one Controller::Button mask for player 1 per environment
+        observations:   environmentCount * GetObservationSize() bytes of grayscale pixels, can be null
+        ramSnapshots:   environmentCount * Emulator::RAM_SIZE bytes, can be null
+     */
+    void Step( const byte *inputs, byte *observations, byte *ramSnapshots );
+
+    u32 GetEnvironmentCount() const;
+    u32 GetObservationWidth() const;
+    u32 GetObservationHeight() const;
+    u32 GetObservationSize() const;
+
+private:
+
+    struct StepRequest
+    {
+        const byte  *inputs;
+        byte        *observations;
+        byte        *ramSnapshots;
+    };
+
+    std::vector< std::unique_ptr< Emulator > >  environments;
+    u32                                         downsampleFactor;
+
+    /* Thread pool, thread 0 is the caller */
+    std::vector< std::thread >                  workers;
+    std::mutex                                  mutex;
+    std::condition_variable                     stepStarted;
+    std::condition_variable                     stepFinished;
+    StepRequest                                 request;
+    u64                                         stepGeneration;
+    u32                                         pendingWorkers;
+    bool                                        quit;
+
+    void WorkerLoop( u32 threadIndex );
+    void StopWorkers();
+    void StepBatch( u32 threadIndex );
+    void WriteObservation( const RGB *frameBuffer, byte *observation ) const;
+    u32 GetThreadCount() const;
+};
@@ -0,0 +1,96 @@
+#include "EnvironmentPoolApi.h"
+
+#include <new>
+#include <system_error>
+
+#include "Cartridge.h"
+#include "Emulator.h"
+#include "EnvironmentPool.h"
+
+
+static_assert( PATNES_RAM_SIZE == Emulator::RAM_SIZE, "The C API RAM size is out of sync with the emulator" );
+
+struct patnes_pool
+{
+    /* The cartridge must outlive the environments that point to it */
+    Cartridge           cartridge;
+    EnvironmentPool     pool;
+
+    patnes_pool( const char *romPath, u32 environmentCount, u32 threadCount, u32 downsampleFactor )
+        : cartridge( romPath )
+        , pool( &cartridge, environmentCount, threadCount, downsampleFactor )
+    {
+    }
+};
+
+patnes_pool* patnes_pool_create( const char *rom_path, uint32_t environment_count, uint32_t thread_count, uint32_t downsample_factor )
+{
+    if ( rom_path == nullptr || environment_count == 0 || downsample_factor == 0 )
+    {
+        return nullptr;
+    }
+
+    if ( Video::NES_VIDEO_WIDTH % downsample_factor != 0 || Video::NES_VIDEO_HEIGHT % downsample_factor != 0 )
+    {
+        return nullptr;
+    }
+
+    /* Check the ROM before building the environments, Memory asserts on unsupported mappers and maps the whole image */
+    {
+        Cartridge cartridge( rom_path );
+        if ( !cartridge.IsLoaded() || !Memory::IsCartridgeSupported( cartridge ) )
+        {
+            return nullptr;
+        }
+    }
+
+    /* nothrow only covers the allocation, creating the worker threads can still fail */
+    try
+    {
+        return new ( std::nothrow ) patnes_pool( rom_path, environment_count, thread_count, downsample_factor );
+    }
+    catch ( const std::system_error & )
+    {
+        return nullptr;
+    }
+}
+
+void patnes_pool_destroy( patnes_pool *pool )
+{
+    delete pool;
+}
+
+void patnes_pool_reset( patnes_pool *pool )
+{
+    pool->pool.Reset();
+}
+
+void patnes_pool_reset_environment( patnes_pool *pool, uint32_t environment )
+{
+    pool->pool.ResetEnvironment( environment );
+}
+
+void patnes_pool_step( patnes_pool *pool, const uint8_t *inputs, uint8_t *observations, uint8_t *ram )
+{
+    pool->pool.Step( inputs, observations, ram );
+}
+
+uint32_t patnes_pool_environment_count( const patnes_pool *pool )
+{
+    return pool->pool.GetEnvironmentCount();
+}
+
+uint32_t patnes_pool_observation_width( const patnes_pool *pool )
+{
+    return pool->pool.GetObservationWidth();
+}
+
+uint32_t patnes_pool_observation_height( const patnes_pool *pool )
+{
+    return pool->pool.GetObservationHeight();
+}
+
+uint32_t patnes_pool_observation_size( const patnes_pool *pool )
+{
+    return pool->pool.GetObservationSize();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+    C interface of EnvironmentPool for training code that drives many emulators at once.
+
+    All the environments of a pool share a single read only mapping of the ROM. The buffers
+    passed to patnes_pool_step are owned by the caller and must be contiguous:
+
+        inputs          patnes_pool_environment_count() bytes, player 1 buttons per environment
+                        ( bit 0 A, 1 B, 2 Select, 3 Start, 4 Up, 5 Down, 6 Left, 7 Right )
+        observations    environment_count * patnes_pool_observation_size() grayscale bytes or NULL
+        ram             environment_count * PATNES_RAM_SIZE bytes or NULL
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PATNES_RAM_SIZE 2048
+
+typedef struct patnes_pool patnes_pool;
+
+/* Returns NULL if the ROM couldn't be loaded. downsample_factor must divide both 256 and 240 */
+patnes_pool*    patnes_pool_create( const char *rom_path, uint32_t environment_count, uint32_t thread_count, uint32_t downsample_factor );
+void            patnes_pool_destroy( patnes_pool *pool );
+
+void            patnes_pool_reset( patnes_pool *pool );
+void            patnes_pool_reset_environment( patnes_pool *pool, uint32_t environment );
+void            patnes_pool_step( patnes_pool *pool, const uint8_t *inputs, uint8_t *observations, uint8_t *ram );
+
+uint32_t        patnes_pool_environment_count( const patnes_pool *pool );
+uint32_t        patnes_pool_observation_width( const patnes_pool *pool );
+uint32_t        patnes_pool_observation_height( const patnes_pool *pool );
+uint32_t        patnes_pool_observation_size( const patnes_pool *pool );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,443 @@
+#include "FrameRecorder.h"
+
+#include <assert.h>
+#include <cstring>
+
+#include "Audio.h"
+#include "CpuTypes.h"
+
+
+namespace
+{
+    constexpr u32 MAGIC                     = 0x50415443; /* 'PATC' */
+    constexpr u32 VERSION                   = 1;
+    constexpr byte KEYFRAME_CHUNK           = 'K';
+    constexpr byte DELTA_CHUNK              = 'D';
+    constexpr byte AUDIO_CHUNK              = 'A';
+    constexpr u32 CHUNK_HEADER_SIZE         = 5;
+
+    /* Bounds on what a capture file claims, so a damaged one can't make the conversion allocate gigabytes */
+    constexpr u32 MAX_FRAME_DIMENSION       = 1024;
+    constexpr u32 MAX_VARINT_SIZE           = 5;
+
+    /* The emulator completes a frame every AVERAGE_CYCLES_PER_FRAME CPU cycles */
+    constexpr u32 FRAME_RATE_NUMERATOR      = Audio::CPU_CLOCK_RATE;
+    constexpr u32 FRAME_RATE_DENOMINATOR    = AVERAGE_CYCLES_PER_FRAME;
+
+    struct CaptureHeader
+    {
+        u32     magic;
+        u32     version;
+        u32     width;
+        u32     height;
+        u32     frameRateNumerator;
+        u32     frameRateDenominator;
+        u32     sampleRate;
+    };
+
+    bool WriteY4mHeader( FILE *file, u32 width, u32 height )
+    {
+        return fprintf( file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C444\n", width, height, FRAME_RATE_NUMERATOR, FRAME_RATE_DENOMINATOR ) > 0;
+    }
+
+    /* Y, Cb and Cr planes one after the other, BT.601 limited range like ffmpeg expects by default */
+    void ConvertToYuv444( const RGB *frame, u32 pixelCount, byte *planes )
+    {
+        byte *luma = planes;
+        byte *blueChroma = &planes[ pixelCount ];
+        byte *redChroma = &planes[ pixelCount * 2 ];
+        for ( u32 i = 0; i < pixelCount; ++i )
+        {
+            const i32 red = frame[ i ].red;
+            const i32 green = frame[ i ].green;
+            const i32 blue = frame[ i ].blue;
+            luma[ i ] = static_cast< byte >( ( ( 66 * red + 129 * green + 25 * blue + 128 ) >> 8 ) + 16 );
+            blueChroma[ i ] = static_cast< byte >( ( ( -38 * red - 74 * green + 112 * blue + 128 ) >> 8 ) + 128 );
+            redChroma[ i ] = static_cast< byte >( ( ( 112 * red - 94 * green - 18 * blue + 128 ) >> 8 ) + 128 );
+        }
+    }
+
+    bool WriteYuvFrame( FILE *file, const RGB *frame, u32 pixelCount, std::vector< byte > &planes )
+    {
+        planes.resize( pixelCount * 3 );
+        ConvertToYuv444( frame, pixelCount, planes.data() );
+        return fwrite( "FRAME\n", 6, 1, file ) == 1 && fwrite( planes.data(), planes.size(), 1, file ) == 1;
+    }
+
+    void PutVarint( std::vector< byte > &buffer, u32 value )
+    {
+        while ( value >= 0x80 )
+        {
+            buffer.push_back( static_cast< byte >( value | 0x80 ) );
+            value >>= 7;
+        }
+        buffer.push_back( static_cast< byte >( value ) );
+    }
+
+    bool GetVarint( const byte *&data, const byte *end, u32 &value )
+    {
+        value = 0;
+        for ( u32 shift = 0; shift < 32; shift += 7 )
+        {
+            if ( data == end )
+            {
+                return false;
+            }
+
+            const byte current = *data++;
+            value |= static_cast< u32 >( current & 0x7F ) << shift;
+            if ( !( current & 0x80 ) )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Applies a video chunk on top of the previous frame */
+    bool DecodeDeltaFrame( const byte *data, u32 size, RGB *frame, u32 pixelCount )
+    {
+        const byte *end = data + size;
+        u32 x = 0;
+        while ( data != end )
+        {
+            u32 unchanged = 0;
+            u32 changed = 0;
+            if ( !GetVarint( data, end, unchanged ) || !GetVarint( data, end, changed ) )
+            {
+                return false;
+            }
+
+            if ( unchanged > pixelCount - x || changed > pixelCount - x - unchanged || static_cast< size_t >( end - data ) < changed * sizeof( RGB ) )
+            {
+                return false;
+            }
+
+            x += unchanged;
+            memcpy( &frame[ x ], data, changed * sizeof( RGB ) );
+            data += changed * sizeof( RGB );
+            x += changed;
+        }
+        return true;
+    }
+}
+
+
+FrameRecorder::FrameRecorder( u32 width, u32 height )
+    : width( width )
+    , height( height )
+    , format( Format::Delta )
+    , videoFile( nullptr )
+    , hasFailed( false )
+    , pushedFrames( 0u )
+    , writtenFrames( 0u )
+    , stalledFrames( 0u )
+    , closing( false )
+{
+    static_assert( sizeof( RGB ) == 3, "The captures store packed RGB pixels" );
+
+    queue.resize( QUEUE_SLOTS );
+    for ( QueuedFrame &slot : queue )
+    {
+        slot.pixels.resize( width * height );
+        slot.sampleCount = 0;
+    }
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    Close();
+}
+
+bool FrameRecorder::TryOpen( Format format, const char *videoFileName, const char *audioFileName )
+{
+    assert( videoFile == nullptr );
+
+    videoFile = fopen( videoFileName, "wb" );
+    if ( videoFile == nullptr )
+    {
+        return false;
+    }
+
+    bool isHeaderWritten = false;
+    if ( format == Format::Y4m )
+    {
+        isHeaderWritten = WriteY4mHeader( videoFile, width, height );
+        if ( audioFileName != nullptr && !wavWriter.TryOpen( audioFileName, Audio::SAMPLE_RATE, 1 ) )
+        {
+            isHeaderWritten = false;
+        }
+    }
+    else
+    {
+        const CaptureHeader header = { MAGIC, VERSION, width, height, FRAME_RATE_NUMERATOR, FRAME_RATE_DENOMINATOR, Audio::SAMPLE_RATE };
+        isHeaderWritten = fwrite( &header, sizeof( header ), 1, videoFile ) == 1;
+    }
+
+    if ( !isHeaderWritten )
+    {
+        fclose( videoFile );
+        videoFile = nullptr;
+        wavWriter.Close();
+        return false;
+    }
+
+    this->format = format;
+    hasFailed = false;
+    pushedFrames = 0u;
+    writtenFrames = 0u;
+    stalledFrames = 0u;
+    closing = false;
+    previousFrame.assign( width * height, color::BLACK );
+    writer = std::thread( &FrameRecorder::WriterLoop, this );
+    return true;
+}
+
+bool FrameRecorder::IsOpen() const
+{
+    return videoFile != nullptr;
+}
+
+void FrameRecorder::Push( const RGB *frame, const i16 *samples, u32 sampleCount )
+{
+    assert( videoFile != nullptr );
+    assert( sampleCount <= MAX_FRAME_SAMPLES );
+
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        if ( pushedFrames - writtenFrames == QUEUE_SLOTS )
+        {
+            ++stalledFrames;
+            frameWritten.wait( lock, [ this ]() { return pushedFrames - writtenFrames < QUEUE_SLOTS; } );
+        }
+    }
+
+    QueuedFrame &slot = queue[ pushedFrames % QUEUE_SLOTS ];
+    memcpy( slot.pixels.data(), frame, slot.pixels.size() * sizeof( RGB ) );
+    memcpy( slot.samples, samples, sampleCount * sizeof( i16 ) );
+    slot.sampleCount = sampleCount;
+
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        ++pushedFrames;
+    }
+    framePushed.notify_one();
+}
+
+bool FrameRecorder::Close()
+{
+    if ( videoFile == nullptr )
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        closing = true;
+    }
+    framePushed.notify_one();
+    writer.join();
+
+    if ( fclose( videoFile ) != 0 )
+    {
+        hasFailed = true;
+    }
+    videoFile = nullptr;
+    wavWriter.Close();
+
+    return !hasFailed;
+}
+
+u64 FrameRecorder::GetRecordedFrames() const
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    return writtenFrames;
+}
+
+u64 FrameRecorder::GetStalledFrames() const
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    return stalledFrames;
+}
+
+void FrameRecorder::WriterLoop()
+{
+    while ( true )
+    {
+        {
+            /* Once closing the queue is drained before leaving */
+            std::unique_lock< std::mutex > lock( mutex );
+            framePushed.wait( lock, [ this ]() { return closing || writtenFrames != pushedFrames; } );
+            if ( writtenFrames == pushedFrames )
+            {
+                return;
+            }
+        }
+
+        const QueuedFrame &slot = queue[ writtenFrames % QUEUE_SLOTS ];
+        bool isWritten = false;
+        if ( format == Format::Y4m )
+        {
+            isWritten = WriteY4mFrame( slot.pixels.data() );
+            if ( wavWriter.IsOpen() )
+            {
+                isWritten = wavWriter.Write( slot.samples, slot.sampleCount ) && isWritten;
+            }
+        }
+        else
+        {
+            isWritten = WriteDeltaFrame( slot.pixels.data(), writtenFrames % KEYFRAME_INTERVAL == 0 );
+            if ( slot.sampleCount > 0 )
+            {
+                isWritten = WriteChunk( AUDIO_CHUNK, reinterpret_cast< const byte * >( slot.samples ), slot.sampleCount * sizeof( i16 ) ) && isWritten;
+            }
+        }
+
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            hasFailed = hasFailed || !isWritten;
+            ++writtenFrames;
+        }
+        frameWritten.notify_one();
+    }
+}
+
+bool FrameRecorder::WriteY4mFrame( const RGB *frame )
+{
+    return WriteYuvFrame( videoFile, frame, width * height, encoded );
+}
+
+bool FrameRecorder::WriteDeltaFrame( const RGB *frame, bool isKeyframe )
+{
+    /* A keyframe is a delta from a black frame, so a decoder can start from it */
+    if ( isKeyframe )
+    {
+        previousFrame.assign( width * height, color::BLACK );
+    }
+
+    encoded.clear();
+    const u32 pixelCount = width * height;
+    u32 x = 0;
+    while ( x < pixelCount )
+    {
+        const u32 unchangedStart = x;
+        while ( x < pixelCount && frame[ x ].isEqual( previousFrame[ x ] ) )
+        {
+            ++x;
+        }
+
+        const u32 changedStart = x;
+        while ( x < pixelCount && !frame[ x ].isEqual( previousFrame[ x ] ) )
+        {
+            ++x;
+        }
+
+        PutVarint( encoded, changedStart - unchangedStart );
+        PutVarint( encoded, x - changedStart );
+        const byte *changedPixels = reinterpret_cast< const byte * >( &frame[ changedStart ] );
+        encoded.insert( encoded.end(), changedPixels, changedPixels + ( x - changedStart ) * sizeof( RGB ) );
+    }
+
+    memcpy( previousFrame.data(), frame, pixelCount * sizeof( RGB ) );
+    return WriteChunk( isKeyframe ? KEYFRAME_CHUNK : DELTA_CHUNK, encoded.data(), static_cast< u32 >( encoded.size() ) );
+}
+
+bool FrameRecorder::WriteChunk( byte type, const byte *payload, u32 size )
+{
+    byte header[ CHUNK_HEADER_SIZE ] = { type };
+    memcpy( &header[ 1 ], &size, sizeof( size ) );
+    return fwrite( header, sizeof( header ), 1, videoFile ) == 1 && ( size == 0 || fwrite( payload, size, 1, videoFile ) == 1 );
+}
+
+bool FrameRecorder::ConvertToY4m( const char *captureFileName, const char *y4mFileName, const char *wavFileName )
+{
+    FILE *captureFile = fopen( captureFileName, "rb" );
+    if ( captureFile == nullptr )
+    {
+        return false;
+    }
+
+    CaptureHeader header;
+    if ( fread( &header, sizeof( header ), 1, captureFile ) != 1 || header.magic != MAGIC || header.version != VERSION
+        || header.width > MAX_FRAME_DIMENSION || header.height > MAX_FRAME_DIMENSION )
+    {
+        fclose( captureFile );
+        return false;
+    }
+
+    FILE *y4mFile = fopen( y4mFileName, "wb" );
+    if ( y4mFile == nullptr )
+    {
+        fclose( captureFile );
+        return false;
+    }
+
+    WavWriter wavWriter;
+    bool isConverted = WriteY4mHeader( y4mFile, header.width, header.height );
+    if ( wavFileName != nullptr )
+    {
+        isConverted = wavWriter.TryOpen( wavFileName, header.sampleRate, 1 ) && isConverted;
+    }
+
+    const u32 pixelCount = header.width * header.height;
+
+    /* Every run of a delta frame covers at least one pixel and takes two varints */
+    const u32 maxFrameChunkSize = pixelCount * ( sizeof( RGB ) + 2 * MAX_VARINT_SIZE );
+    const u32 maxAudioChunkSize = MAX_FRAME_SAMPLES * sizeof( i16 );
+
+    std::vector< RGB > frame( pixelCount, color::BLACK );
+    std::vector< byte > payload;
+    std::vector< byte > planes;
+
+    byte chunkHeader[ CHUNK_HEADER_SIZE ];
+    while ( isConverted && fread( chunkHeader, sizeof( chunkHeader ), 1, captureFile ) == 1 )
+    {
+        u32 size = 0;
+        memcpy( &size, &chunkHeader[ 1 ], sizeof( size ) );
+        if ( size > ( ( chunkHeader[ 0 ] == AUDIO_CHUNK ) ? maxAudioChunkSize : maxFrameChunkSize ) )
+        {
+            isConverted = false;
+            break;
+        }
+
+        payload.resize( size );
+        if ( size > 0 && fread( payload.data(), size, 1, captureFile ) != 1 )
+        {
+            isConverted = false;
+            break;
+        }
+
+        switch ( chunkHeader[ 0 ] )
+        {
+            case KEYFRAME_CHUNK:
+            case DELTA_CHUNK:
+            {
+                if ( chunkHeader[ 0 ] == KEYFRAME_CHUNK )
+                {
+                    frame.assign( pixelCount, color::BLACK );
+                }
+                isConverted = DecodeDeltaFrame( payload.data(), size, frame.data(), pixelCount ) && WriteYuvFrame( y4mFile, frame.data(), pixelCount, planes );
+                break;
+            }
+
+            case AUDIO_CHUNK:
+            {
+                if ( wavWriter.IsOpen() )
+                {
+                    isConverted = wavWriter.Write( reinterpret_cast< const i16 * >( payload.data() ), size / sizeof( i16 ) );
+                }
+                break;
+            }
+
+            default:
+            {
+                isConverted = false;
+                break;
+            }
+        }
+    }
+
+    fclose( captureFile );
+    isConverted = ( fclose( y4mFile ) == 0 ) && isConverted;
+    return isConverted;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Types.h"
+#include "WavWriter.h"
+
+
+/*
+    Records every completed frame and the audio produced during it. The emulation thread only
+    copies the frame into a queue of preallocated slots, a background thread encodes it and
+    writes it, so the capture doesn't slow the emulation down as long as the disk keeps up on
+    average. When the queue is full the emulation thread waits and the stall is counted, no
+    frame is ever dropped.
+
+    Y4m writes a YUV4MPEG2 stream ( 4:4:4 ) plus a WAV file next to it, both can be piped into
+    ffmpeg. Delta writes a single lossless capture holding the pixels that changed since the
+    previous frame, with a keyframe every KEYFRAME_INTERVAL frames, and the audio samples.
+
+    Delta capture:
+    +--------+-------+-------+-----+
+    | Header | Chunk | Chunk | ... |
+    +--------+-------+-------+-----+
+
+    Every chunk is a type byte, a u32 payload size and the payload. Video chunks are a list of
+    ( unchanged pixels, changed pixels ) varint pairs, each followed by the RGB of the changed
+    pixels. Audio chunks are 16 bit mono samples.
+ */
+
+class FrameRecorder
+{
+public:
+
+    enum class Format : byte
+    {
+        Y4m = 0,
+        Delta,
+        Count
+    };
+
+    static constexpr const char* FormatString [ static_cast< size_t >( Format::Count ) ] =
+    {
+        "y4m",
+        "delta",
+    };
+
+    static constexpr u32 MAX_FRAME_SAMPLES = 2048;
+
+    FrameRecorder( u32 width, u32 height );
+    FrameRecorder( FrameRecorder & ) = delete;
+    ~FrameRecorder();
+
+    /* The audio file is only used by Y4m, the delta captures hold the samples themselves */
+    bool TryOpen( Format format, const char *videoFileName, const char *audioFileName );
+    bool IsOpen() const;
+
+    /* Emulation thread, queues a copy of the frame and its samples */
+    void Push( const RGB *frame, const i16 *samples, u32 sampleCount );
+
+    /* Writes the queued frames and closes the files, false if any write failed */
+    bool Close();
+
+    u64 GetRecordedFrames() const;
+    u64 GetStalledFrames() const;
+
+    /* Decodes a delta capture back into a Y4m stream and a WAV file, the WAV file is optional */
+    static bool ConvertToY4m( const char *captureFileName, const char *y4mFileName, const char *wavFileName );
+
+private:
+
+    /* About a second of frames */
+    static constexpr u32 QUEUE_SLOTS        = 64;
+    static constexpr u32 KEYFRAME_INTERVAL  = 600;
+
+    struct QueuedFrame
+    {
+        std::vector< RGB >  pixels;
+        i16                 samples[ MAX_FRAME_SAMPLES ];
+        u32                 sampleCount;
+    };
+
+    u32                         width;
+    u32                         height;
+    Format                      format;
+    FILE                        *videoFile;
+    WavWriter                   wavWriter;
+    bool                        hasFailed;
+
+    /* Frame queue, a slot belongs to the emulation thread until it is pushed and to the writer until it is written */
+    std::vector< QueuedFrame >  queue;
+    u64                         pushedFrames;
+    u64                         writtenFrames;
+    u64                         stalledFrames;
+    bool                        closing;
+    std::thread                 writer;
+    mutable std::mutex          mutex;
+    std::condition_variable     framePushed;
+    std::condition_variable     frameWritten;
+
+    /* Writer thread only */
+    std::vector< RGB >          previousFrame;
+    std::vector< byte >         encoded;
+
+    void WriterLoop();
+    bool WriteY4mFrame( const RGB *frame );
+    bool WriteDeltaFrame( const RGB *frame, bool isKeyframe );
+    bool WriteChunk( byte type, const byte *payload, u32 size );
+};
@@ -0,0 +1,166 @@
+#include "Hash.h"
+
+#include <cstring>
+
+
+namespace
+{
+    constexpr u64 PRIME_1 = 0x9E3779B185EBCA87ull;
+    constexpr u64 PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr u64 PRIME_3 = 0x165667B19E3779F9ull;
+    constexpr u64 PRIME_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr u64 PRIME_5 = 0x27D4EB2F165667C5ull;
+
+    inline u64 RotateLeft( u64 value, u32 bits )
+    {
+        return ( value << bits ) | ( value >> ( 64 - bits ) );
+    }
+
+    inline u64 Read64( const byte *data )
+    {
+        u64 value;
+        memcpy( &value, data, sizeof( value ) );
+        return value;
+    }
+
+    inline u32 Read32( const byte *data )
+    {
+        u32 value;
+        memcpy( &value, data, sizeof( value ) );
+        return value;
+    }
+
+    inline u64 Round( u64 accumulator, u64 input )
+    {
+        accumulator += input * PRIME_2;
+        accumulator = RotateLeft( accumulator, 31 );
+        return accumulator * PRIME_1;
+    }
+
+    inline u64 MergeRound( u64 accumulator, u64 value )
+    {
+        accumulator ^= Round( 0, value );
+        return accumulator * PRIME_1 + PRIME_4;
+    }
+
+    /* Slicing by 8: table N holds the CRC of a byte followed by N zero bytes */
+    constexpr u32 CRC32_POLYNOMIAL = 0xEDB88320;
+    constexpr u32 CRC32_SLICES = 8;
+
+    struct Crc32Tables
+    {
+        u32 values[ CRC32_SLICES ][ 256 ];
+    };
+
+    constexpr Crc32Tables BuildCrc32Tables()
+    {
+        Crc32Tables tables = {};
+        for ( u32 i = 0; i < 256; ++i )
+        {
+            u32 crc = i;
+            for ( u32 bit = 0; bit < 8; ++bit )
+            {
+                crc = ( crc & 1 ) ? ( crc >> 1 ) ^ CRC32_POLYNOMIAL : crc >> 1;
+            }
+            tables.values[ 0 ][ i ] = crc;
+        }
+
+        for ( u32 slice = 1; slice < CRC32_SLICES; ++slice )
+        {
+            for ( u32 i = 0; i < 256; ++i )
+            {
+                const u32 previous = tables.values[ slice - 1 ][ i ];
+                tables.values[ slice ][ i ] = ( previous >> 8 ) ^ tables.values[ 0 ][ previous & 0xFF ];
+            }
+        }
+        return tables;
+    }
+
+    constexpr Crc32Tables CRC32_TABLES = BuildCrc32Tables();
+}
+
+
+u64 Hash64( const void *data, size_t size, u64 seed )
+{
+    const byte *input = static_cast< const byte * >( data );
+    const byte *end = input + size;
+
+    u64 hash = 0;
+    if ( size >= 32 )
+    {
+        /* Four independent lanes so the multiplications overlap */
+        u64 lanes[ 4 ] = { seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1 };
+        const byte *lastStripe = end - 32;
+        do
+        {
+            lanes[ 0 ] = Round( lanes[ 0 ], Read64( input ) );
+            lanes[ 1 ] = Round( lanes[ 1 ], Read64( input + 8 ) );
+            lanes[ 2 ] = Round( lanes[ 2 ], Read64( input + 16 ) );
+            lanes[ 3 ] = Round( lanes[ 3 ], Read64( input + 24 ) );
+            input += 32;
+        }
+        while ( input <= lastStripe );
+
+        hash = RotateLeft( lanes[ 0 ], 1 ) + RotateLeft( lanes[ 1 ], 7 ) + RotateLeft( lanes[ 2 ], 12 ) + RotateLeft( lanes[ 3 ], 18 );
+        for ( u64 lane : lanes )
+        {
+            hash = MergeRound( hash, lane );
+        }
+    }
+    else
+    {
+        hash = seed + PRIME_5;
+    }
+
+    hash += static_cast< u64 >( size );
+
+    for ( ; input + 8 <= end; input += 8 )
+    {
+        hash ^= Round( 0, Read64( input ) );
+        hash = RotateLeft( hash, 27 ) * PRIME_1 + PRIME_4;
+    }
+
+    if ( input + 4 <= end )
+    {
+        hash ^= static_cast< u64 >( Read32( input ) ) * PRIME_1;
+        hash = RotateLeft( hash, 23 ) * PRIME_2 + PRIME_3;
+        input += 4;
+    }
+
+    for ( ; input < end; ++input )
+    {
+        hash ^= static_cast< u64 >( *input ) * PRIME_5;
+        hash = RotateLeft( hash, 11 ) * PRIME_1;
+    }
+
+    /* Avalanche */
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+u32 Crc32( const void *data, size_t size, u32 crc )
+{
+    const byte *input = static_cast< const byte * >( data );
+    const byte *end = input + size;
+    const auto &tables = CRC32_TABLES.values;
+
+    crc = ~crc;
+    for ( ; input + 8 <= end; input += 8 )
+    {
+        /* The CRC is little endian, like the hosts this runs on */
+        const u32 low = Read32( input ) ^ crc;
+        const u32 high = Read32( input + 4 );
+        crc = tables[ 7 ][ low & 0xFF ] ^ tables[ 6 ][ ( low >> 8 ) & 0xFF ] ^ tables[ 5 ][ ( low >> 16 ) & 0xFF ] ^ tables[ 4 ][ low >> 24 ]
+            ^ tables[ 3 ][ high & 0xFF ] ^ tables[ 2 ][ ( high >> 8 ) & 0xFF ] ^ tables[ 1 ][ ( high >> 16 ) & 0xFF ] ^ tables[ 0 ][ high >> 24 ];
+    }
+
+    for ( ; input < end; ++input )
+    {
+        crc = ( crc >> 8 ) ^ tables[ 0 ][ ( crc ^ *input ) & 0xFF ];
+    }
+    return ~crc;
+}
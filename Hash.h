@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Types.h"
+
+
+/*
+    Non cryptographic hashing. Hash64 is XXH64, it reads 32 bytes per iteration and is only
+    bounded by the memory bandwidth, its values match the reference implementation so hashes
+    stored by regression tests can be produced by other tools.
+
+    Crc32 is the IEEE CRC-32 of zlib and of the ROM databases, computed 8 bytes at a time from
+    tables built at compile time. The SSE4.2 crc32 instruction computes CRC-32C instead, which
+    doesn't match the checksums the databases publish.
+ */
+
+u64 Hash64( const void *data, size_t size, u64 seed );
+
+/* Pass the result of a previous call as crc to continue a checksum, 0 starts a new one */
+u32 Crc32( const void *data, size_t size, u32 crc );
@@ -0,0 +1,164 @@
+#include "InstructionTracer.h"
+
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+
+#include "CpuTypes.h"
+
+
+InstructionTracer::InstructionTracer( u32 capacity, const Video *video )
+    : writeIndex( 0u )
+    , video( video )
+{
+    assert( video != nullptr );
+
+    u64 powerOfTwoCapacity = 1;
+    while ( powerOfTwoCapacity < capacity )
+    {
+        powerOfTwoCapacity <<= 1;
+    }
+
+    entries.resize( powerOfTwoCapacity );
+    mask = powerOfTwoCapacity - 1;
+}
+
+void InstructionTracer::Clear()
+{
+    writeIndex.store( 0u, std::memory_order_release );
+}
+
+u64 InstructionTracer::GetEntryCount() const
+{
+    const u64 written = writeIndex.load( std::memory_order_acquire );
+    return ( written < entries.size() ) ? written : entries.size();
+}
+
+const TraceEntry& InstructionTracer::GetEntry( u64 index ) const
+{
+    assert( index < GetEntryCount() );
+
+    const u64 written = writeIndex.load( std::memory_order_acquire );
+    const u64 oldest = written - GetEntryCount();
+    return entries[ ( oldest + index ) & mask ];
+}
+
+bool InstructionTracer::Dump( const char *fileName ) const
+{
+    FILE *file = fopen( fileName, "wb" );
+    if ( file == nullptr )
+    {
+        return false;
+    }
+
+    const u64 entryCount = GetEntryCount();
+    const FileHeader header = { FILE_MAGIC, FILE_VERSION, entryCount };
+    bool success = fwrite( &header, sizeof( FileHeader ), 1, file ) == 1;
+
+    /* The ring may have wrapped, write the oldest part first */
+    const u64 oldest = ( writeIndex.load( std::memory_order_acquire ) - entryCount ) & mask;
+    const u64 firstChunk = ( oldest + entryCount > entries.size() ) ? entries.size() - oldest : entryCount;
+    success = success && fwrite( &entries[ oldest ], sizeof( TraceEntry ), firstChunk, file ) == firstChunk;
+    success = success && fwrite( &entries[ 0 ], sizeof( TraceEntry ), entryCount - firstChunk, file ) == entryCount - firstChunk;
+
+    fclose( file );
+    return success;
+}
+
+bool InstructionTracer::ConvertToNestestLog( const char *traceFileName, const char *logFileName )
+{
+    FILE *traceFile = fopen( traceFileName, "rb" );
+    if ( traceFile == nullptr )
+    {
+        return false;
+    }
+
+    FileHeader header;
+    if ( fread( &header, sizeof( FileHeader ), 1, traceFile ) != 1 || header.magic != FILE_MAGIC || header.version != FILE_VERSION )
+    {
+        fclose( traceFile );
+        return false;
+    }
+
+    FILE *logFile = fopen( logFileName, "w" );
+    if ( logFile == nullptr )
+    {
+        fclose( traceFile );
+        return false;
+    }
+
+    bool success = true;
+    TraceEntry entry;
+    char line[ 128 ];
+    for ( u64 i = 0; i < header.entryCount && success; ++i )
+    {
+        success = fread( &entry, sizeof( TraceEntry ), 1, traceFile ) == 1;
+        if ( success )
+        {
+            FormatNestestLine( entry, line, sizeof( line ) );
+            fprintf( logFile, "%s\n", line );
+        }
+    }
+
+    fclose( traceFile );
+    fclose( logFile );
+    return success;
+}
+
+void InstructionTracer::FormatNestestLine( const TraceEntry &entry, char *line, u32 lineSize )
+{
+    /*
+        C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+
+        The effective address and value annotations nestest.log appends to memory operands
+        ( "STX $00 = 00" ) depend on memory contents at that point and are not recorded.
+     */
+    const char *mnemonic = "???";
+    CpuAddressMode addressMode = CpuAddressMode::Implicit;
+
+    std::unordered_map< byte, OpcodeInfo >::const_iterator it = NES_OPCODE_INFO.find( entry.opcode );
+    if ( it != NES_OPCODE_INFO.end() )
+    {
+        mnemonic = it->second.mnemonic;
+        addressMode = it->second.addressMode;
+    }
+
+    const byte length = ADDRESS_MODE_OPCODE_LENGTH[ static_cast< byte >( addressMode ) ];
+    const byte low = entry.operands[ 0 ];
+    const byte high = entry.operands[ 1 ];
+    const word absolute = static_cast< word >( ( high << 8 ) | low );
+
+    char bytes[ 16 ];
+    switch ( length )
+    {
+        case 1:     { snprintf( bytes, sizeof( bytes ), "%02X", entry.opcode ); break; }
+        case 2:     { snprintf( bytes, sizeof( bytes ), "%02X %02X", entry.opcode, low ); break; }
+        default:    { snprintf( bytes, sizeof( bytes ), "%02X %02X %02X", entry.opcode, low, high ); break; }
+    }
+
+    char operand[ 16 ];
+    switch ( addressMode )
+    {
+        case CpuAddressMode::Accumulator:   { snprintf( operand, sizeof( operand ), "A" ); break; }
+        case CpuAddressMode::Immediate:     { snprintf( operand, sizeof( operand ), "#$%02X", low ); break; }
+        case CpuAddressMode::ZeroPage:      { snprintf( operand, sizeof( operand ), "$%02X", low ); break; }
+        case CpuAddressMode::ZeroPageX:     { snprintf( operand, sizeof( operand ), "$%02X,X", low ); break; }
+        case CpuAddressMode::ZeroPageY:     { snprintf( operand, sizeof( operand ), "$%02X,Y", low ); break; }
+        case CpuAddressMode::Relative:      { snprintf( operand, sizeof( operand ), "$%04X", static_cast< word >( entry.pc + 2 + static_cast< char >( low ) ) ); break; }
+        case CpuAddressMode::Absolute:      { snprintf( operand, sizeof( operand ), "$%04X", absolute ); break; }
+        case CpuAddressMode::AbsoluteX:     { snprintf( operand, sizeof( operand ), "$%04X,X", absolute ); break; }
+        case CpuAddressMode::AbsoluteY:     { snprintf( operand, sizeof( operand ), "$%04X,Y", absolute ); break; }
+        case CpuAddressMode::Indirect:      { snprintf( operand, sizeof( operand ), "($%04X)", absolute ); break; }
+        case CpuAddressMode::IndexedX:      { snprintf( operand, sizeof( operand ), "($%02X,X)", low ); break; }
+        case CpuAddressMode::IndexedY:      { snprintf( operand, sizeof( operand ), "($%02X),Y", low ); break; }
+        default:                            { operand[ 0 ] = '\0'; break; }
+    }
+
+    char disassembly[ 48 ];
+    snprintf( disassembly, sizeof( disassembly ), "%s %s", mnemonic, operand );
+
+    snprintf( line, lineSize, "%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3u,%3u CYC:%llu",
+        entry.pc, bytes, disassembly,
+        entry.accumulator, entry.xRegister, entry.yRegister, entry.pRegister, entry.stackPointer,
+        entry.scanline, entry.dot, entry.cycle );
+}
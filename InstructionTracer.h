@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "Types.h"
+#include "Cpu.h"
+#include "Memory.h"
+#include "Video.h"
+
+
+/*
+    Records the CPU state before every instruction into an in memory ring of fixed size entries.
+    The hot path only copies registers, formatting happens offline when the binary dump is
+    converted to the nestest.log text format.
+
+    Tracing is enabled by calling Cpu::Update( tracer ), the regular Cpu::Update() is a separate
+    template instantiation that contains no tracing code.
+ */
+
+struct TraceEntry
+{
+    u64     cycle;
+    word    pc;
+    byte    opcode;
+    byte    operands[ 2 ];
+    byte    accumulator;
+    byte    xRegister;
+    byte    yRegister;
+    byte    pRegister;
+    byte    stackPointer;
+    u16     scanline;
+    u16     dot;
+    u16     reserved;
+};
+
+static_assert( sizeof( TraceEntry ) == 24, "Trace entries are written as is in the binary dump" );
+
+
+class InstructionTracer
+{
+public:
+
+    /* Binary dump layout: FileHeader followed by entryCount TraceEntry from oldest to newest */
+    struct FileHeader
+    {
+        u32     magic;
+        u32     version;
+        u64     entryCount;
+    };
+
+    static constexpr u32 FILE_MAGIC     = 0x52544E50; /* 'PNTR' */
+    static constexpr u32 FILE_VERSION   = 1;
+
+    /* The capacity is rounded up to a power of two */
+    InstructionTracer( u32 capacity, const Video *video );
+    InstructionTracer( InstructionTracer & ) = delete;
+
+    void Clear();
+    inline void Record( const Cpu &cpu, const Memory &memory );
+
+    /* Entries currently held by the ring, oldest first */
+    u64 GetEntryCount() const;
+    const TraceEntry& GetEntry( u64 index ) const;
+
+    bool Dump( const char *fileName ) const;
+
+    /* Offline conversion of a binary dump to the nestest.log format */
+    static bool ConvertToNestestLog( const char *traceFileName, const char *logFileName );
+    static void FormatNestestLine( const TraceEntry &entry, char *line, u32 lineSize );
+
+private:
+    std::vector< TraceEntry >   entries;
+    u64                         mask;
+    std::atomic< u64 >          writeIndex;
+    const Video                 *video;
+};
+
+
+inline void InstructionTracer::Record( const Cpu &cpu, const Memory &memory )
+{
+    /* Single producer: only the emulation thread writes, readers use the published writeIndex */
+    const u64 index = writeIndex.load( std::memory_order_relaxed );
+    TraceEntry &entry = entries[ index & mask ];
+
+    const word pc = cpu.GetPC().value;
+    entry.cycle = cpu.GetCycles();
+    entry.pc = pc;
+    entry.opcode = memory.Peek( pc );
+    entry.operands[ 0 ] = memory.Peek( pc + 1 );
+    entry.operands[ 1 ] = memory.Peek( pc + 2 );
+    entry.accumulator = cpu.GetAccumulator();
+    entry.xRegister = cpu.GetRegisterX();
+    entry.yRegister = cpu.GetRegisterY();
+    entry.pRegister = cpu.GetStateRegister();
+    entry.stackPointer = cpu.GetStackPointer();
+    entry.scanline = static_cast< u16 >( video->GetCurrentScanline() );
+    entry.dot = static_cast< u16 >( video->GetCurrentDot() );
+
+    writeIndex.store( index + 1, std::memory_order_release );
+}
@@ -3,114 +3,228 @@
 #include <assert.h>
 #include "Cartridge.h"
 #include "Video.h"
+#include "Audio.h"
+#include "CodeDataLogger.h"
+#include "MemoryHeatmap.h"
 #include <cstring>
 
-Memory::Memory( const Cartridge *cartridge, Video *video )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Memory::Memory( const Cartridge *cartridge, Video *video, Audio *audio )
     : cartridge( cartridge )
     , video ( video )
+    , audio( audio )
+    , isMapMapped( false )
+    , hasSaveFile( false )
+    , prgBankOffsets{ 0, 0, 0, 0 }
+    , codeDataLogger( nullptr )
+    , memoryHeatmap( nullptr )
 {
-    map = new byte[ 64_KB ];
+    void *mapping = mmap( nullptr, 64_KB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    isMapMapped = ( mapping != MAP_FAILED );
+    map = isMapMapped ? static_cast< byte * >( mapping ) : new byte[ 64_KB ];
     Reset();
 }
 
 Memory::~Memory()
 {
-    delete[] map;
+    /* The only time the save file is flushed explicitly, the kernel writes the dirty pages back on its own before that */
+    if ( hasSaveFile )
+    {
+        msync( &map[ PRG_RAM_ADDRESS ], PRG_RAM_SIZE, MS_SYNC );
+    }
+
+    if ( isMapMapped )
+    {
+        munmap( map, 64_KB );
+    }
+    else
+    {
+        delete[] map;
+    }
+}
+
+bool Memory::TryAttachSaveFile( const char *fileName )
+{
+    assert( !hasSaveFile );
+
+    if ( !isMapMapped )
+    {
+        return false;
+    }
+
+    /* The PRG RAM has to cover whole pages of the map */
+    const long pageSize = sysconf( _SC_PAGESIZE );
+    if ( pageSize <= 0 || PRG_RAM_ADDRESS % pageSize != 0 || PRG_RAM_SIZE % pageSize != 0 )
+    {
+        return false;
+    }
+
+    const i32 fileDescriptor = open( fileName, O_RDWR | O_CREAT, 0644 );
+    if ( fileDescriptor < 0 )
+    {
+        return false;
+    }
+
+    /* A new save file starts zeroed, a shorter one is extended so every mapped page is backed by the file */
+    struct stat fileStatus;
+    bool isMapped = false;
+    if ( fstat( fileDescriptor, &fileStatus ) == 0 && ( fileStatus.st_size >= PRG_RAM_SIZE || ftruncate( fileDescriptor, PRG_RAM_SIZE ) == 0 ) )
+    {
+        /* Mapped wherever the kernel likes first, then moved over the anonymous pages in one step, so a failure leaves them in place */
+        void *mapping = mmap( nullptr, PRG_RAM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0 );
+        if ( mapping != MAP_FAILED )
+        {
+            isMapped = ( mremap( mapping, PRG_RAM_SIZE, PRG_RAM_SIZE, MREMAP_MAYMOVE | MREMAP_FIXED, &map[ PRG_RAM_ADDRESS ] ) != MAP_FAILED );
+            if ( !isMapped )
+            {
+                munmap( mapping, PRG_RAM_SIZE );
+            }
+        }
+    }
+    close( fileDescriptor );
+
+    hasSaveFile = isMapped;
+    return isMapped;
+}
+
+bool Memory::HasSaveFile() const
+{
+    return hasSaveFile;
 }
 
 void Memory::Reset()
 {
-    memset( map, 0x00, 64_KB );
+    if ( hasSaveFile )
+    {
+        memset( map, 0x00, PRG_RAM_ADDRESS );
+        memset( &map[ PRG_RAM_ADDRESS + PRG_RAM_SIZE ], 0x00, 64_KB - PRG_RAM_ADDRESS - PRG_RAM_SIZE );
+    }
+    else
+    {
+        memset( map, 0x00, 64_KB );
+    }
 
     MapCartridge();
 
-    map[ Video::PPUCTRL_REGISTER ] = 0x00;
-    map[ Video::PPUMASK_REGISTER ] = 0x00;
-    map[ Video::PPUSTATUS_REGISTER ] = 0b1010'0000;
-    map[ Video::OAMA_REGISTER ] = 0x00;
-    map[ Video::OAMADATA_REGISTER ] = 0x00;
-    map[ Video::PPUSCROLL_REGISTER ] = 0x00;
-    map[ Video::PPUDATA_ADDRESS ] = 0x00;
+    for ( Controller &controller : controllers )
+    {
+        controller.Reset();
+    }
+
+    isOamDmaPending = false;
+    pendingDmcDmaCycles = 0u;
 }
 
-void Memory::MapCartridge()
+bool Memory::IsCartridgeSupported( const Cartridge &cartridge )
 {
-    assert( cartridge != nullptr );
+    /* For now only support NROM with PRG ROM of 16KB or 32KB and at most one 8KB CHR ROM bank, the PRG RAM is plain memory at 0x6000 */
+    const Cartridge::Header &header = cartridge.GetHeader();
+    const bool isMapperSupported = header.mapper == 0x00 && ( header.prgRomSizeKB == 16 || header.prgRomSizeKB == 32 ) && header.chrRomSizeKB <= 8;
 
-    /* For now only support NROM with PRG ROM of 16KB and no ram */
-    Cartridge::Header header = cartridge->GetHeader();
-    assert( header.mapper == 0x00 && header.prgRomSizeKB == 16  && !header.hasPRGRam);
+    /* MapCartridge copies the whole PRG and CHR ROM, a truncated image would be read past its end */
+    return isMapperSupported && cartridge.IsImageComplete();
+}
+
+void Memory::MapCartridge()
+{
+    assert( cartridge != nullptr && IsCartridgeSupported( *cartridge ) );
+    const Cartridge::Header &header = cartridge->GetHeader();
 
     const byte * const rom = cartridge->GetRom();
 
     /* Map the PRG ROM to 0x8000 */
     memcpy(&map[0x8000], &rom[0x0010], 16_KB );
 
-    /* Mirror the PRG ROM in 0xC000 */
-    memcpy(&map[0xC000], &rom[0x0010], 16_KB );
+    /* Mirror the PRG ROM in 0xC000 for NROM-128, NROM-256 maps its second bank there */
+    const u32 upperBankOffset = ( header.prgRomSizeKB == 32 ) ? 16_KB : 0;
+    memcpy(&map[0xC000], &rom[0x0010 + upperBankOffset], 16_KB );
+
+    prgBankOffsets[ 0 ] = 0;
+    prgBankOffsets[ 1 ] = PRG_BANK_SIZE;
+    prgBankOffsets[ 2 ] = upperBankOffset;
+    prgBankOffsets[ 3 ] = upperBankOffset + PRG_BANK_SIZE;
 }
 
 byte Memory::Read( word address )
 {
+    if ( memoryHeatmap != nullptr )
+    {
+        memoryHeatmap->LogCpuRead( address );
+    }
+
     if ( address >= 0x2000 && address <= 0x3FFF )
     {
         const word ppuRegister = ( address % 8 ) + 0x2000;
 
-        if ( ppuRegister == Video::PPUSTATUS_REGISTER )
-        {
-            ResetAddressLatch();
-            const byte ppuStatus = map[ Video::PPUSTATUS_REGISTER ];
-            byte newPpuStatus = ppuStatus ^ 0b1000'0000;
-            Write( Video::PPUSTATUS_REGISTER, newPpuStatus );
-        }
-        return map[ ppuRegister ];
+        /* The PPU is rendered lazily, bring it up to date before the CPU looks at it */
+        video->CatchUp();
+        return video->ReadRegister( ppuRegister );
+    }
+    else if ( address == CONTROLLER_1_REGISTER || address == CONTROLLER_2_REGISTER )
+    {
+        return controllers[ address - CONTROLLER_1_REGISTER ].Read();
+    }
+    else if ( address == Audio::STATUS_REGISTER )
+    {
+        return audio->ReadStatus();
     }
     else
     {
+        if ( codeDataLogger != nullptr && address >= 0x8000 )
+        {
+            codeDataLogger->LogRead( address );
+        }
         return map[ address ];
     }
 }
 
 void Memory::Write( word address, byte data )
 {
+    if ( memoryHeatmap != nullptr )
+    {
+        memoryHeatmap->LogCpuWrite( address );
+    }
+
     if ( address >= 0x2000 && address <= 0x3FFF )
     {
         const word ppuRegister = ( address % 8 ) + 0x2000;
-        if ( ppuRegister == Video::PPUADDR_REGISTER )
-        {
-            if ( IsAddressLatchClear )
-            {
-                IsAddressLatchClear = false;
-                currentVRamAddress = ( data | currentVRamAddress ) << 8;
-            }
-            else
-            {
-                IsAddressLatchClear = true;
-                currentVRamAddress = data | currentVRamAddress;
-            }
-            map[ Video::PPUADDR_REGISTER ] = data;
 
-        }
-        else if ( ppuRegister == Video::PPUDATA_ADDRESS )
+        video->CatchUp();
+        video->WriteRegister( ppuRegister, data );
+    }
+    else if ( address == OAM_DMA_REGISTER )
+    {
+        /* One bulk copy instead of 256 reads and writes, the source page is RAM or ROM in practice */
+        video->CatchUp();
+        video->WriteOAMDMA( &map[ data << 8 ] );
+        isOamDmaPending = true;
+        if ( memoryHeatmap != nullptr )
         {
-            const word address = currentVRamAddress;
-            video->Write( address, data );
-
-            const byte ppuControlRegister = map[ Video::PPUCTRL_REGISTER ];
-            const byte incrementType = ( ppuControlRegister & 0b0000'0100 ) >> 2;
-            if ( incrementType == 0 )
+            for ( u32 i = 0; i < 0x100; ++i )
             {
-                currentVRamAddress++;
-            }
-            else
-            {
-                currentVRamAddress += 32;
+                memoryHeatmap->LogCpuRead( static_cast< word >( ( data << 8 ) | i ) );
             }
         }
-        else
+        map[ address ] = data;
+    }
+    else if ( address == CONTROLLER_1_REGISTER )
+    {
+        /* The strobe line is shared by both ports */
+        for ( Controller &controller : controllers )
         {
-            map[ ppuRegister ] = data;
+            controller.Write( data );
         }
+        map[ address ] = data;
+    }
+    else if ( address >= Audio::PULSE_1_CONTROL_REGISTER && address <= Audio::FRAME_COUNTER_REGISTER )
+    {
+        /* Everything but the OAM DMA and the controller strobe up to 0x4017 belongs to the APU */
+        audio->WriteRegister( address, data );
+        map[ address ] = data;
     }
     else
     {
@@ -118,13 +232,49 @@ void Memory::Write( word address, byte data )
     }
 }
 
+byte Memory::Peek( word address ) const
+{
+    if ( address >= 0x2000 && address <= 0x3FFF )
+    {
+        return video->PeekRegister( ( address % 8 ) + 0x2000 );
+    }
+    return map[ address ];
+}
+
 const byte *const Memory::GetMemoryMap() const
 {
     return map;
 }
 
-void Memory::ResetAddressLatch()
+byte Memory::ReadDmcSample( word address )
+{
+    assert( address >= 0x8000 );
+    if ( codeDataLogger != nullptr )
+    {
+        codeDataLogger->LogDmcRead( address );
+    }
+
+    if ( memoryHeatmap != nullptr )
+    {
+        memoryHeatmap->LogCpuRead( address );
+    }
+
+    pendingDmcDmaCycles += DMC_DMA_CYCLES;
+    return map[ address ];
+}
+
+void Memory::SetCodeDataLogger( CodeDataLogger *logger )
+{
+    codeDataLogger = logger;
+}
+
+void Memory::SetMemoryHeatmap( MemoryHeatmap *heatmap )
+{
+    memoryHeatmap = heatmap;
+}
+
+Controller& Memory::GetController( byte port )
 {
-    IsAddressLatchClear = true;
-    currentVRamAddress = 0x00;
+    assert( port < CONTROLLER_PORTS );
+    return controllers[ port ];
 }
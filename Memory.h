@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Types.h"
+#include "Controller.h"
 
 
 /*
@@ -19,7 +20,7 @@
     |                     |                                                         |
     |   0x1800 - 0x1FFF   |  ( Mirrors of RAM )                                     |
     |                     |                                                         |
-    |   0x2000 - 0x2007   |  ( NES PPU registers )                                  |
+    |   0x2000 - 0x2007   |  ( NES PPU registers, forwarded to Video )              |
     |                     |                                                         |
     |   0x2008 - 0x3FFF   |  ( Mirrors of PPU registers, repeat every 8 bytes )     |
     |                     |                                                         |
@@ -27,7 +28,11 @@
     |                     |                                                         |
     |   0x4018 - 0x401F   |  ( APU and UI Functionality that is usually disabled )  |
     |                     |                                                         |
-    |   0x4020 - 0xFFFF   |  ( Cartridge and mapper registers )                     |
+    |   0x4020 - 0x5FFF   |  ( Cartridge and mapper registers )                     |
+    |                     |                                                         |
+    |   0x6000 - 0x7FFF   |  ( PRG RAM, mapped from the save file with a battery )  |
+    |                     |                                                         |
+    |   0x8000 - 0xFFFF   |  ( PRG ROM )                                            |
     |                     |                                                         |
     +---------------------+---------------------------------------------------------+
 
@@ -36,12 +41,15 @@
 
 class Cartridge;
 class Video;
+class Audio;
+class CodeDataLogger;
+class MemoryHeatmap;
 
 class Memory
 {
 public:
 
-    Memory( const Cartridge *cartridge, Video *video );
+    Memory( const Cartridge *cartridge, Video *video, Audio *audio );
     ~Memory();
 
     void Reset();
@@ -50,20 +58,107 @@ public:
     byte Read( word address );
     void Write( word address, byte data );
 
+    /* Reads without the side effects of the PPU or IO registers, for debugging tools */
+    byte Peek( word address ) const;
+
     const byte *const GetMemoryMap() const;
 
+    /* The DMC fetches its samples from 0x8000 - 0xFFFF, the logger tells them apart from CPU reads. Every fetch stalls the CPU */
+    byte ReadDmcSample( word address );
+
+    /* Offset in the PRG ROM of the byte mapped at 0x8000 - 0xFFFF, the banks are mapped in 8KB slots */
+    static constexpr u32 PRG_BANK_SIZE          = 8_KB;
+    static constexpr byte PRG_BANK_SLOTS        = 4;
+
+    u32 GetPrgRomOffset( word address ) const;
+
+    /* Marks the PRG ROM read by the CPU and the DMC while a logger is set, nullptr disables it */
+    void SetCodeDataLogger( CodeDataLogger *logger );
+
+    /* Counts the reads and writes of every address while a heatmap is set, nullptr disables it */
+    void SetMemoryHeatmap( MemoryHeatmap *heatmap );
+
+    /* Writing the source page to 0x4014 copies it to the PPU OAM and stalls the CPU */
+    static constexpr word OAM_DMA_REGISTER      = 0x4014;
+    static constexpr u32 OAM_DMA_CYCLES         = 513;
+
+    bool IsOamDmaPending() const;
+    void AcknowledgeOamDma();
+
+    /* The real stall is 1 to 4 cycles depending on the cycle the fetch lands on, the longest one is always taken */
+    static constexpr u32 DMC_DMA_CYCLES         = 4;
+
+    u32 GetPendingDmcDmaCycles() const;
+    void AcknowledgeDmcDma();
+
+    /* Input */
+    static constexpr word CONTROLLER_1_REGISTER = 0x4016;
+    static constexpr word CONTROLLER_2_REGISTER = 0x4017;
+    static constexpr byte CONTROLLER_PORTS      = 2;
+
+    Controller& GetController( byte port );
+
+    /* Whether MapCartridge knows the mapper and the ROM layout of the cartridge, and the image holds all of its ROM */
+    static bool IsCartridgeSupported( const Cartridge &cartridge );
+
+    /*
+        Battery backed PRG RAM. The save file is mapped over 0x6000 - 0x7FFF and shared with the
+        file, so the CPU writes reach it without any I/O and it is synced when Memory is destroyed.
+        The PRG RAM then survives resets, like on the console.
+     */
+    static constexpr word PRG_RAM_ADDRESS       = 0x6000;
+    static constexpr u32 PRG_RAM_SIZE           = 8_KB;
+
+    bool TryAttachSaveFile( const char *fileName );
+    bool HasSaveFile() const;
+
 private:
 
     /* Associated NES systems */
     const Cartridge     *cartridge;
     Video               *video;
+    Audio               *audio;
 
-    /* NES memory map */
+    /* NES memory map, page aligned so the save file can be mapped inside it. On the heap when it couldn't be mapped, without a save file then */
     byte                *map;
+    bool                isMapMapped;
+    bool                hasSaveFile;
+    u32                 prgBankOffsets[ PRG_BANK_SLOTS ];
+
+    CodeDataLogger      *codeDataLogger;
+    MemoryHeatmap       *memoryHeatmap;
+
+    /* Input devices plugged into 0x4016 and 0x4017 */
+    Controller          controllers[ CONTROLLER_PORTS ];
 
-    bool                IsAddressLatchClear;
-    word                currentVRamAddress;
+    bool                isOamDmaPending;
+    u32                 pendingDmcDmaCycles;
 
     void MapCartridge();
-    void ResetAddressLatch();
-};
\ No newline at end of file
+};
+
+
+inline u32 Memory::GetPrgRomOffset( word address ) const
+{
+    return prgBankOffsets[ ( address - 0x8000 ) / PRG_BANK_SIZE ] + ( address % PRG_BANK_SIZE );
+}
+
+inline bool Memory::IsOamDmaPending() const
+{
+    return isOamDmaPending;
+}
+
+inline void Memory::AcknowledgeOamDma()
+{
+    isOamDmaPending = false;
+}
+
+inline u32 Memory::GetPendingDmcDmaCycles() const
+{
+    return pendingDmcDmaCycles;
+}
+
+inline void Memory::AcknowledgeDmcDma()
+{
+    pendingDmcDmaCycles = 0u;
+}
\ No newline at end of file
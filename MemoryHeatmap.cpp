@@ -0,0 +1,113 @@
+#include "MemoryHeatmap.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "CpuTypes.h"
+
+
+MemoryHeatmap::MemoryHeatmap()
+{
+    GetCounters( AddressSpace::Cpu, Access::Read ).resize( CPU_ADDRESS_SPACE_SIZE, 0 );
+    GetCounters( AddressSpace::Cpu, Access::Write ).resize( CPU_ADDRESS_SPACE_SIZE, 0 );
+    GetCounters( AddressSpace::Cpu, Access::Execute ).resize( CPU_ADDRESS_SPACE_SIZE, 0 );
+
+    /* Nothing is executed from the PPU memory, its execute counters stay empty */
+    GetCounters( AddressSpace::Ppu, Access::Read ).resize( PPU_ADDRESS_SPACE_SIZE, 0 );
+    GetCounters( AddressSpace::Ppu, Access::Write ).resize( PPU_ADDRESS_SPACE_SIZE, 0 );
+
+    /* Unknown opcodes are logged as single byte instructions */
+    memset( instructionLengths, 1, sizeof( instructionLengths ) );
+    for ( const auto &[ opcode, info ] : NES_OPCODE_INFO )
+    {
+        instructionLengths[ opcode ] = ADDRESS_MODE_OPCODE_LENGTH[ static_cast< byte >( info.addressMode ) ];
+    }
+}
+
+void MemoryHeatmap::Clear()
+{
+    for ( auto &spaceCounters : counters )
+    {
+        for ( Counters &accessCounters : spaceCounters )
+        {
+            std::fill( accessCounters.begin(), accessCounters.end(), 0 );
+        }
+    }
+}
+
+void MemoryHeatmap::Decay()
+{
+    /* A quarter less every frame, the last fraction is dropped so idle bytes fade out */
+    for ( auto &spaceCounters : counters )
+    {
+        for ( Counters &accessCounters : spaceCounters )
+        {
+            for ( u16 &counter : accessCounters )
+            {
+                counter = static_cast< u16 >( ( counter * 3u ) >> 2 );
+            }
+        }
+    }
+}
+
+u32 MemoryHeatmap::GetAddressSpaceSize( AddressSpace space )
+{
+    return ( space == AddressSpace::Cpu ) ? CPU_ADDRESS_SPACE_SIZE : PPU_ADDRESS_SPACE_SIZE;
+}
+
+u16 MemoryHeatmap::GetCounter( AddressSpace space, Access access, word address ) const
+{
+    const Counters &accessCounters = GetCounters( space, access );
+    return ( address < accessCounters.size() ) ? ( accessCounters[ address ] + ACCESS_WEIGHT - 1 ) / ACCESS_WEIGHT : 0;
+}
+
+bool MemoryHeatmap::IsSelfModifyingCode( word address ) const
+{
+    return GetCounter( AddressSpace::Cpu, Access::Write, address ) != 0 && GetCounter( AddressSpace::Cpu, Access::Execute, address ) != 0;
+}
+
+u32 MemoryHeatmap::CountSelfModifyingCodeBytes() const
+{
+    u32 count = 0;
+    for ( u32 address = 0; address < CPU_ADDRESS_SPACE_SIZE; ++address )
+    {
+        count += IsSelfModifyingCode( static_cast< word >( address ) ) ? 1 : 0;
+    }
+    return count;
+}
+
+byte MemoryHeatmap::GetIntensity( u16 counter )
+{
+    /* 16 steps of one bit each, any fraction of an access is visible and the hottest bytes don't wash out the rest */
+    if ( counter == 0 )
+    {
+        return 0;
+    }
+
+    byte bits = 0;
+    for ( ; counter != 0; counter >>= 1 )
+    {
+        ++bits;
+    }
+    return static_cast< byte >( 0x40 + ( bits - 1 ) * 0x0C );
+}
+
+void MemoryHeatmap::Render( AddressSpace space, RGB *pixels ) const
+{
+    const Counters &reads = GetCounters( space, Access::Read );
+    const Counters &writes = GetCounters( space, Access::Write );
+    const Counters &executions = GetCounters( space, Access::Execute );
+    const bool hasExecutions = !executions.empty();
+
+    const u32 size = GetAddressSpaceSize( space );
+    for ( u32 address = 0; address < size; ++address )
+    {
+        const u16 executionCount = hasExecutions ? executions[ address ] : 0;
+        if ( executionCount != 0 && writes[ address ] != 0 )
+        {
+            pixels[ address ] = { 0xFF, 0xFF, 0xFF };
+            continue;
+        }
+        pixels[ address ] = { GetIntensity( writes[ address ] ), GetIntensity( reads[ address ] ), GetIntensity( executionCount ) };
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Memory access heatmap. Keeps a saturating 16 bit counter with 2 fractional bits of reads,
+    writes and executions per byte of the CPU address space, and of reads and writes per byte
+    of the PPU address space. Memory counts the CPU bus accesses, the CPU the bytes of every
+    executed instruction and Video the PPUDATA accesses, and only while a heatmap is set on
+    the Emulator.
+
+    The counters lose a quarter of their value every frame, so the heatmap shows what the game
+    is doing now rather than since power up and a single access fades out in 4 frames. Bytes
+    written and executed within a few frames of each other are self-modifying code.
+ */
+
+class MemoryHeatmap
+{
+public:
+
+    enum class AddressSpace : byte
+    {
+        Cpu = 0,
+        Ppu,
+        Count
+    };
+
+    enum class Access : byte
+    {
+        Read = 0,
+        Write,
+        Execute,
+        Count
+    };
+
+    static constexpr u32 CPU_ADDRESS_SPACE_SIZE = 0x10000;
+    static constexpr u32 PPU_ADDRESS_SPACE_SIZE = 0x4000;
+
+    /* Rendered one pixel per byte and 256 bytes per row, 256x256 for the CPU and 256x64 for the PPU */
+    static constexpr u32 RENDER_WIDTH           = 256;
+
+    MemoryHeatmap();
+    MemoryHeatmap( MemoryHeatmap & ) = delete;
+
+    void Clear();
+
+    /* Called once per frame */
+    void Decay();
+
+    inline void LogCpuRead( word address );
+    inline void LogCpuWrite( word address );
+    inline void LogExecute( word address, byte opcode );
+    inline void LogPpuRead( word address );
+    inline void LogPpuWrite( word address );
+
+    static u32 GetAddressSpaceSize( AddressSpace space );
+
+    /* Decayed number of accesses, rounded up */
+    u16 GetCounter( AddressSpace space, Access access, word address ) const;
+
+    /* Executed bytes that were also written recently */
+    bool IsSelfModifyingCode( word address ) const;
+    u32 CountSelfModifyingCodeBytes() const;
+
+    /* Red for writes, green for reads and blue for executions on a log scale, self-modifying code in white */
+    void Render( AddressSpace space, RGB *pixels ) const;
+
+private:
+
+    static constexpr u16 ACCESS_WEIGHT          = 4;
+
+    using Counters = std::vector< u16 >;
+
+    Counters    counters[ static_cast< byte >( AddressSpace::Count ) ][ static_cast< byte >( Access::Count ) ];
+
+    /* Per opcode, filled from NES_OPCODE_INFO */
+    byte        instructionLengths[ 256 ];
+
+    Counters& GetCounters( AddressSpace space, Access access );
+    const Counters& GetCounters( AddressSpace space, Access access ) const;
+
+    static inline void Increment( u16 &counter );
+    static byte GetIntensity( u16 counter );
+};
+
+
+inline MemoryHeatmap::Counters& MemoryHeatmap::GetCounters( AddressSpace space, Access access )
+{
+    return counters[ static_cast< byte >( space ) ][ static_cast< byte >( access ) ];
+}
+
+inline const MemoryHeatmap::Counters& MemoryHeatmap::GetCounters( AddressSpace space, Access access ) const
+{
+    return counters[ static_cast< byte >( space ) ][ static_cast< byte >( access ) ];
+}
+
+inline void MemoryHeatmap::Increment( u16 &counter )
+{
+    counter = ( counter <= 0xFFFF - ACCESS_WEIGHT ) ? counter + ACCESS_WEIGHT : 0xFFFF;
+}
+
+inline void MemoryHeatmap::LogCpuRead( word address )
+{
+    Increment( GetCounters( AddressSpace::Cpu, Access::Read )[ address ] );
+}
+
+inline void MemoryHeatmap::LogCpuWrite( word address )
+{
+    Increment( GetCounters( AddressSpace::Cpu, Access::Write )[ address ] );
+}
+
+inline void MemoryHeatmap::LogExecute( word address, byte opcode )
+{
+    /* The operands too, self-modifying code usually patches them rather than the opcode */
+    Counters &executions = GetCounters( AddressSpace::Cpu, Access::Execute );
+    for ( byte i = 0; i < instructionLengths[ opcode ]; ++i )
+    {
+        Increment( executions[ static_cast< word >( address + i ) ] );
+    }
+}
+
+inline void MemoryHeatmap::LogPpuRead( word address )
+{
+    Increment( GetCounters( AddressSpace::Ppu, Access::Read )[ address % PPU_ADDRESS_SPACE_SIZE ] );
+}
+
+inline void MemoryHeatmap::LogPpuWrite( word address )
+{
+    Increment( GetCounters( AddressSpace::Ppu, Access::Write )[ address % PPU_ADDRESS_SPACE_SIZE ] );
+}
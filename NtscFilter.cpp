@@ -0,0 +1,179 @@
+#include "NtscFilter.h"
+
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+
+#include "Video.h"
+
+
+namespace
+{
+    /* Voltages of the PPU output, the emphasis bits attenuate the signal while they are in phase */
+    constexpr r64 LOW_LEVELS[ 4 ]       = { 0.350, 0.518, 0.962, 1.550 };
+    constexpr r64 HIGH_LEVELS[ 4 ]      = { 1.094, 1.506, 1.962, 1.962 };
+    constexpr r64 BLACK_LEVEL           = 0.518;
+    constexpr r64 WHITE_LEVEL           = 1.962;
+    constexpr r64 EMPHASIS_ATTENUATION  = 0.746;
+
+    constexpr u32 SAMPLES_PER_PIXEL     = 8;
+    constexpr u32 SAMPLES_PER_CYCLE     = 12;
+    constexpr u32 PHASE_STEP            = 4;
+
+    /* Half of the decoding window, one color cycle around the center of the output pixel */
+    constexpr r64 HALF_WINDOW           = 6.0;
+
+    /* Lines the hues up with the usual palettes, in samples */
+    constexpr r64 HUE_OFFSET            = 4.0;
+    constexpr r64 GAMMA                 = 2.2 / 1.8;
+    constexpr r64 PI                    = 3.14159265358979323846;
+
+    bool InColorPhase( u32 color, u32 phase )
+    {
+        return ( color + phase ) % SAMPLES_PER_CYCLE < 6;
+    }
+
+    /* Normalized signal of one sample, 0 is black and 1 is white */
+    r64 GetSignal( u32 color, u32 phase )
+    {
+        const u32 hue = color & 0x0F;
+        const u32 level = ( hue > 13 ) ? 1 : ( ( color >> 4 ) & 0x03 );
+        const u32 emphasis = color >> 6;
+
+        const r64 high = HIGH_LEVELS[ level ];
+        const r64 low = ( hue == 0 ) ? high : LOW_LEVELS[ level ];
+        r64 signal = ( hue > 12 ) ? low : ( InColorPhase( hue, phase ) ? high : low );
+
+        if ( ( ( emphasis & 0x01 ) && InColorPhase( 0, phase ) )
+          || ( ( emphasis & 0x02 ) && InColorPhase( 4, phase ) )
+          || ( ( emphasis & 0x04 ) && InColorPhase( 8, phase ) ) )
+        {
+            signal *= EMPHASIS_ATTENUATION;
+        }
+
+        return ( signal - BLACK_LEVEL ) / ( WHITE_LEVEL - BLACK_LEVEL );
+    }
+
+    /* Part of the sample starting at 'sample' covered by the window of an output pixel */
+    r64 GetWindowWeight( r64 sample, r64 center )
+    {
+        const r64 begin = std::max( sample, center - HALF_WINDOW );
+        const r64 end = std::min( sample + 1.0, center + HALF_WINDOW );
+        return ( end > begin ) ? end - begin : 0.0;
+    }
+}
+
+
+NtscFilter::NtscFilter()
+    : framePhase( 0u )
+{
+    frameBuffer.assign( OUTPUT_WIDTH * Video::NES_VIDEO_HEIGHT, color::PINK );
+
+    for ( u32 level = 0; level < LINEAR_LEVELS; ++level )
+    {
+        const r64 value = std::pow( static_cast< r64 >( level ) / ( LINEAR_LEVELS - 1 ), GAMMA );
+        gammaTable[ level ] = static_cast< byte >( std::lround( value * 255.0 ) );
+    }
+
+    BuildKernels();
+}
+
+void NtscFilter::BuildKernels()
+{
+    kernels.resize( PHASES * PIXELS_PER_GROUP * COLORS * KERNEL_SIZE );
+
+    const r64 outputSpacing = static_cast< r64 >( PIXELS_PER_GROUP * SAMPLES_PER_PIXEL ) / OUTPUTS_PER_GROUP;
+    for ( u32 phaseIndex = 0; phaseIndex < PHASES; ++phaseIndex )
+    {
+        const u32 linePhase = phaseIndex * PHASE_STEP;
+        for ( u32 alignment = 0; alignment < PIXELS_PER_GROUP; ++alignment )
+        {
+            for ( u32 color = 0; color < COLORS; ++color )
+            {
+                r64 red[ KERNEL_SIZE ] = {};
+                r64 green[ KERNEL_SIZE ] = {};
+                r64 blue[ KERNEL_SIZE ] = {};
+
+                for ( u32 sampleIndex = 0; sampleIndex < SAMPLES_PER_PIXEL; ++sampleIndex )
+                {
+                    /* Samples are counted from the start of the group of pixels, which is always in phase */
+                    const u32 sample = alignment * SAMPLES_PER_PIXEL + sampleIndex;
+                    const u32 phase = linePhase + sample;
+                    const r64 level = GetSignal( color, phase ) / SAMPLES_PER_CYCLE;
+                    const r64 angle = PI * ( phase + HUE_OFFSET ) / 6.0;
+                    const r64 y = level;
+                    const r64 i = level * std::cos( angle );
+                    const r64 q = level * std::sin( angle );
+
+                    for ( u32 tap = 0; tap < KERNEL_SIZE; ++tap )
+                    {
+                        const r64 center = ( static_cast< r64 >( tap ) - KERNEL_OFFSET + 0.5 ) * outputSpacing;
+                        const r64 weight = GetWindowWeight( sample, center );
+                        red[ tap ] += weight * ( y + 0.946882 * i + 0.623557 * q );
+                        green[ tap ] += weight * ( y - 0.274788 * i - 0.635691 * q );
+                        blue[ tap ] += weight * ( y - 1.108545 * i + 1.709007 * q );
+                    }
+                }
+
+                KernelTap *taps = &kernels[ ( ( phaseIndex * PIXELS_PER_GROUP + alignment ) * COLORS + color ) * KERNEL_SIZE ];
+                for ( u32 tap = 0; tap < KERNEL_SIZE; ++tap )
+                {
+                    taps[ tap ].red = static_cast< i32 >( std::lround( red[ tap ] * LINEAR_LEVELS ) );
+                    taps[ tap ].green = static_cast< i32 >( std::lround( green[ tap ] * LINEAR_LEVELS ) );
+                    taps[ tap ].blue = static_cast< i32 >( std::lround( blue[ tap ] * LINEAR_LEVELS ) );
+                }
+            }
+        }
+    }
+}
+
+void NtscFilter::FilterScanline( u32 scanline, const byte *paletteIndices, byte emphasis )
+{
+    assert( scanline < Video::NES_VIDEO_HEIGHT );
+
+    /* A frame is 262 * 341 * 8 samples, 4 more than a whole number of color cycles, which is the dot crawl */
+    if ( scanline == 0 )
+    {
+        framePhase = ( framePhase + PHASE_STEP ) % SAMPLES_PER_CYCLE;
+    }
+
+    const u32 phaseIndex = ( ( framePhase + scanline * PHASE_STEP ) % SAMPLES_PER_CYCLE ) / PHASE_STEP;
+    const KernelTap *phaseKernels = &kernels[ phaseIndex * PIXELS_PER_GROUP * COLORS * KERNEL_SIZE ];
+    const u32 colorBits = static_cast< u32 >( emphasis & 0x07 ) << 6;
+
+    KernelTap accumulator[ OUTPUT_WIDTH + KERNEL_SIZE ];
+    memset( accumulator, 0x00, sizeof( accumulator ) );
+
+    for ( u32 x = 0; x < Video::NES_VIDEO_WIDTH; ++x )
+    {
+        const u32 group = x / PIXELS_PER_GROUP;
+        const u32 alignment = x % PIXELS_PER_GROUP;
+        const u32 color = colorBits | ( paletteIndices[ x ] & 0x3F );
+        const KernelTap *taps = &phaseKernels[ ( alignment * COLORS + color ) * KERNEL_SIZE ];
+
+        KernelTap *output = &accumulator[ group * OUTPUTS_PER_GROUP ];
+        for ( u32 tap = 0; tap < KERNEL_SIZE; ++tap )
+        {
+            output[ tap ].red += taps[ tap ].red;
+            output[ tap ].green += taps[ tap ].green;
+            output[ tap ].blue += taps[ tap ].blue;
+        }
+    }
+
+    auto toLevel = []( i32 value )
+    {
+        return static_cast< u32 >( ( value < 0 ) ? 0 : ( ( value >= static_cast< i32 >( LINEAR_LEVELS ) ) ? LINEAR_LEVELS - 1 : value ) );
+    };
+
+    RGB *line = &frameBuffer[ scanline * OUTPUT_WIDTH ];
+    for ( u32 x = 0; x < OUTPUT_WIDTH; ++x )
+    {
+        const KernelTap &sum = accumulator[ x + KERNEL_OFFSET ];
+        line[ x ] = { gammaTable[ toLevel( sum.red ) ], gammaTable[ toLevel( sum.green ) ], gammaTable[ toLevel( sum.blue ) ] };
+    }
+}
+
+const RGB* NtscFilter::GetFrameBuffer() const
+{
+    return frameBuffer.data();
+}
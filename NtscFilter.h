@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Composite video filter. The PPU does not output RGB: every pixel is 8 samples of a square wave
+    whose phase against the 12 samples long color subcarrier is the hue of the palette entry, and
+    whose levels are its brightness. The emphasis bits attenuate parts of the wave. A TV decodes
+    the brightness and the color from overlapping windows of that signal, so neighbouring pixels
+    bleed into each other and the pattern crawls from one frame to the next.
+
+    Each palette index always produces the same signal for a given phase, and the decoding is
+    linear, so what every index adds to the output pixels around it is computed once. A scanline
+    is then only a sum of those kernels, 3 NES pixels for every 7 output pixels.
+ */
+
+class NtscFilter
+{
+public:
+
+    static constexpr u32 OUTPUT_WIDTH = 602;
+
+    NtscFilter();
+    NtscFilter( NtscFilter & ) = delete;
+
+    /* 256 palette indices of 6 bits, the emphasis bits are the 3 upper bits of PPUMASK */
+    void FilterScanline( u32 scanline, const byte *paletteIndices, byte emphasis );
+
+    /* OUTPUT_WIDTH x 240 pixels */
+    const RGB* GetFrameBuffer() const;
+
+private:
+
+    static constexpr u32 PHASES             = 3;
+    static constexpr u32 PIXELS_PER_GROUP   = 3;
+    static constexpr u32 OUTPUTS_PER_GROUP  = 7;
+    static constexpr u32 COLORS             = 512;
+    static constexpr u32 KERNEL_SIZE        = 16;
+    static constexpr u32 KERNEL_OFFSET      = 4;
+    static constexpr u32 LINEAR_LEVELS      = 4096;
+
+    /* What one pixel adds to an output pixel, LINEAR_LEVELS is white */
+    struct KernelTap
+    {
+        i32     red;
+        i32     green;
+        i32     blue;
+    };
+
+    /* [ scanline phase ][ pixel in the group ][ emphasis and palette index ][ tap ] */
+    std::vector< KernelTap >    kernels;
+    std::vector< RGB >          frameBuffer;
+    byte                        gammaTable[ LINEAR_LEVELS ];
+
+    /* Subcarrier phase of the first pixel of the frame, in samples */
+    u32                         framePhase;
+
+    void BuildKernels();
+};
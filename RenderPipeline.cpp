@@ -0,0 +1,301 @@
+#include "RenderPipeline.h"
+
+#include <assert.h>
+#include <cstring>
+
+
+namespace
+{
+    /* Slot the next version of a memory goes to, the caller checked there is one left */
+    byte *TakeVersion( byte *versions, u32 size, u32 maxVersions, byte &versionCount )
+    {
+        assert( versionCount < maxVersions );
+        ++versionCount;
+        return &versions[ ( versionCount - 1 ) * size ];
+    }
+}
+
+
+RenderPipeline::RenderPipeline( u32 threadCount, Upscaler::Filter filter, u32 scale, PostProcess postProcess )
+    : scale( scale )
+    , postProcess( postProcess )
+    , recordingSnapshot( 0u )
+    , renderingSnapshot( 1u )
+    , completedFrame( 1u )
+    , completedFrames( 0u )
+    , isFrameInFlight( false )
+    , frameGeneration( 0u )
+    , pendingWorkers( 0u )
+    , quit( false )
+{
+    assert( Upscaler::IsScaleSupported( filter, scale ) );
+
+    memset( snapshots, 0x00, sizeof( snapshots ) );
+    for ( std::vector< RGB > &frame : frames )
+    {
+        frame.assign( GetFrameWidth() * GetFrameHeight(), color::PINK );
+    }
+
+    /* More threads than scanlines would have nothing to do */
+    threadCount = ( threadCount == 0 ) ? 1 : threadCount;
+    threadCount = ( threadCount > Video::NES_VIDEO_HEIGHT ) ? Video::NES_VIDEO_HEIGHT : threadCount;
+
+    workerStates.resize( threadCount );
+    for ( WorkerState &state : workerStates )
+    {
+        state.frame.resize( Video::NES_VIDEO_RESOLUTION );
+        state.upscaler = std::make_unique< Upscaler >( filter, scale, Video::NES_VIDEO_WIDTH, Video::NES_VIDEO_HEIGHT );
+    }
+
+    workers.reserve( threadCount );
+    for ( u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+    {
+        workers.emplace_back( &RenderPipeline::WorkerLoop, this, threadIndex );
+    }
+}
+
+RenderPipeline::~RenderPipeline()
+{
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        WaitForFrame( lock );
+        quit = true;
+    }
+    frameSubmitted.notify_all();
+
+    for ( std::thread &worker : workers )
+    {
+        worker.join();
+    }
+}
+
+void RenderPipeline::RecordScanline( u32 scanline, const Video::ScanlineState &state, const Video::MemoryView &view, byte dirtyMemory )
+{
+    assert( scanline < Video::NES_VIDEO_HEIGHT );
+
+    FrameSnapshot &snapshot = snapshots[ recordingSnapshot ];
+
+    /* The memory of the previous frame belongs to the other snapshot, every frame starts with a full copy */
+    if ( scanline == 0 )
+    {
+        snapshot.patternTableVersions = 0;
+        snapshot.nametableVersions = 0;
+        snapshot.paletteVersions = 0;
+        snapshot.oamVersions = 0;
+        snapshot.isRenderedDirectly = false;
+        dirtyMemory = Video::ALL_MEMORY_DIRTY;
+    }
+
+    /* Once a memory ran out of versions the rest of the frame is drawn here, the recorded versions are never touched again */
+    snapshot.isRenderedDirectly = snapshot.isRenderedDirectly || !TryRecordMemory( snapshot, view, dirtyMemory );
+
+    RecordedScanline &recorded = snapshot.scanlines[ scanline ];
+    recorded.state = state;
+    recorded.isRendered = snapshot.isRenderedDirectly;
+    recorded.patternTableVersion = snapshot.patternTableVersions - 1;
+    recorded.nametableVersion = snapshot.nametableVersions - 1;
+    recorded.paletteVersion = snapshot.paletteVersions - 1;
+    recorded.oamVersion = snapshot.oamVersions - 1;
+
+    if ( recorded.isRendered )
+    {
+        Video::RenderScanline( scanline, state, view, snapshot.paletteIndices[ scanline ] );
+    }
+}
+
+bool RenderPipeline::TryRecordMemory( FrameSnapshot &snapshot, const Video::MemoryView &view, byte dirtyMemory )
+{
+    /* All or nothing, a scanline must not mix the versions of this scanline with older ones */
+    if ( ( ( dirtyMemory & Video::PATTERN_TABLES_DIRTY ) && snapshot.patternTableVersions == MAX_PATTERN_TABLE_VERSIONS ) ||
+         ( ( dirtyMemory & Video::NAMETABLES_DIRTY ) && snapshot.nametableVersions == MAX_NAMETABLE_VERSIONS ) ||
+         ( ( dirtyMemory & Video::PALETTES_DIRTY ) && snapshot.paletteVersions == MAX_PALETTE_VERSIONS ) ||
+         ( ( dirtyMemory & Video::OAM_DIRTY ) && snapshot.oamVersions == MAX_OAM_VERSIONS ) )
+    {
+        return false;
+    }
+
+    if ( dirtyMemory & Video::PATTERN_TABLES_DIRTY )
+    {
+        memcpy( TakeVersion( &snapshot.patternTables[ 0 ][ 0 ], 8_KB, MAX_PATTERN_TABLE_VERSIONS, snapshot.patternTableVersions ), view.patternTables, 8_KB );
+    }
+
+    if ( dirtyMemory & Video::NAMETABLES_DIRTY )
+    {
+        /* The mirroring is resolved here, the workers see four distinct nametables */
+        byte *nametables = TakeVersion( &snapshot.nametables[ 0 ][ 0 ], 4_KB, MAX_NAMETABLE_VERSIONS, snapshot.nametableVersions );
+        for ( u32 nametable = 0; nametable < 4; ++nametable )
+        {
+            memcpy( &nametables[ nametable * 1_KB ], view.nametables[ nametable ], 1_KB );
+        }
+    }
+
+    if ( dirtyMemory & Video::PALETTES_DIRTY )
+    {
+        memcpy( TakeVersion( &snapshot.palettes[ 0 ][ 0 ], PALETTE_SIZE, MAX_PALETTE_VERSIONS, snapshot.paletteVersions ), view.palettes, PALETTE_SIZE );
+    }
+
+    if ( dirtyMemory & Video::OAM_DIRTY )
+    {
+        memcpy( TakeVersion( &snapshot.oam[ 0 ][ 0 ], Video::OAM_SIZE, MAX_OAM_VERSIONS, snapshot.oamVersions ), view.oam, Video::OAM_SIZE );
+    }
+    return true;
+}
+
+void RenderPipeline::SubmitFrame()
+{
+    {
+        /* The previous frame had a whole emulated frame to complete, this rarely waits */
+        std::unique_lock< std::mutex > lock( mutex );
+        WaitForFrame( lock );
+
+        renderingSnapshot = recordingSnapshot;
+        pendingWorkers = static_cast< u32 >( workers.size() );
+        isFrameInFlight = true;
+        ++frameGeneration;
+    }
+    frameSubmitted.notify_all();
+
+    recordingSnapshot ^= 1;
+}
+
+void RenderPipeline::Flush()
+{
+    std::unique_lock< std::mutex > lock( mutex );
+    WaitForFrame( lock );
+}
+
+void RenderPipeline::WaitForFrame( std::unique_lock< std::mutex > &lock )
+{
+    frameFinished.wait( lock, [ this ]() { return pendingWorkers == 0; } );
+
+    if ( isFrameInFlight )
+    {
+        completedFrame = renderingSnapshot;
+        ++completedFrames;
+        isFrameInFlight = false;
+    }
+}
+
+const RGB* RenderPipeline::GetFrame() const
+{
+    return frames[ completedFrame ].data();
+}
+
+const byte* RenderPipeline::GetIndexedFrame() const
+{
+    return &snapshots[ completedFrame ].paletteIndices[ 0 ][ 0 ];
+}
+
+byte RenderPipeline::GetScanlineEmphasis( u32 scanline ) const
+{
+    assert( scanline < Video::NES_VIDEO_HEIGHT );
+    return snapshots[ completedFrame ].scanlines[ scanline ].state.mask >> Video::EMPHASIS_SHIFT;
+}
+
+u32 RenderPipeline::GetFrameWidth() const
+{
+    return Video::NES_VIDEO_WIDTH * scale;
+}
+
+u32 RenderPipeline::GetFrameHeight() const
+{
+    return Video::NES_VIDEO_HEIGHT * scale;
+}
+
+u64 RenderPipeline::GetCompletedFrames() const
+{
+    return completedFrames;
+}
+
+void RenderPipeline::WorkerLoop( u32 threadIndex )
+{
+    u64 lastGeneration = 0u;
+    while ( true )
+    {
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            frameSubmitted.wait( lock, [ this, lastGeneration ]() { return quit || frameGeneration != lastGeneration; } );
+            if ( quit )
+            {
+                return;
+            }
+            lastGeneration = frameGeneration;
+        }
+
+        RenderBand( threadIndex );
+
+        bool lastWorker = false;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            lastWorker = ( --pendingWorkers == 0 );
+        }
+
+        if ( lastWorker )
+        {
+            frameFinished.notify_one();
+        }
+    }
+}
+
+void RenderPipeline::RenderBand( u32 threadIndex )
+{
+    /* Each thread owns a contiguous band of scanlines, the output rows are never shared */
+    const u32 threadCount = static_cast< u32 >( workers.size() );
+    const u32 first = ( Video::NES_VIDEO_HEIGHT * threadIndex ) / threadCount;
+    const u32 last = ( Video::NES_VIDEO_HEIGHT * ( threadIndex + 1 ) ) / threadCount;
+
+    /* The scanlines around the band are rendered again rather than waiting for the neighbouring bands */
+    WorkerState &workerState = workerStates[ threadIndex ];
+    const u32 haloRows = workerState.upscaler->GetHaloRows();
+    const u32 firstRendered = ( first > haloRows ) ? first - haloRows : 0;
+    const u32 lastRendered = ( last + haloRows < Video::NES_VIDEO_HEIGHT ) ? last + haloRows : Video::NES_VIDEO_HEIGHT;
+
+    /* The palette indices of the band are kept for Video, the ones of the halo belong to the neighbouring workers */
+    FrameSnapshot &snapshot = snapshots[ renderingSnapshot ];
+    for ( u32 scanline = firstRendered; scanline < lastRendered; ++scanline )
+    {
+        const RecordedScanline &recorded = snapshot.scanlines[ scanline ];
+        if ( recorded.isRendered )
+        {
+            Video::ConvertToRGB( snapshot.paletteIndices[ scanline ], recorded.state.mask >> Video::EMPHASIS_SHIFT, &workerState.frame[ scanline * Video::NES_VIDEO_WIDTH ] );
+            continue;
+        }
+
+        const byte *nametables = snapshot.nametables[ recorded.nametableVersion ];
+        const Video::MemoryView view =
+        {
+            snapshot.patternTables[ recorded.patternTableVersion ],
+            { &nametables[ 0 ], &nametables[ 1_KB ], &nametables[ 2_KB ], &nametables[ 3_KB ] },
+            snapshot.palettes[ recorded.paletteVersion ],
+            snapshot.oam[ recorded.oamVersion ],
+        };
+
+        /* The sprite flags were already raised by the emulation thread */
+        byte haloIndices[ Video::NES_VIDEO_WIDTH ];
+        byte *paletteIndices = ( scanline >= first && scanline < last ) ? snapshot.paletteIndices[ scanline ] : haloIndices;
+        Video::RenderScanline( scanline, recorded.state, view, paletteIndices );
+        Video::ConvertToRGB( paletteIndices, recorded.state.mask >> Video::EMPHASIS_SHIFT, &workerState.frame[ scanline * Video::NES_VIDEO_WIDTH ] );
+    }
+
+    RGB *frame = frames[ renderingSnapshot ].data();
+    workerState.upscaler->Upscale( workerState.frame.data(), first, last, frame );
+    PostProcessRows( &frame[ first * scale * GetFrameWidth() ], last - first );
+}
+
+void RenderPipeline::PostProcessRows( RGB *rows, u32 scanlineCount ) const
+{
+    if ( postProcess != PostProcess::Scanlines || scale == 1 )
+    {
+        return;
+    }
+
+    const u32 frameWidth = GetFrameWidth();
+    for ( u32 scanline = 0; scanline < scanlineCount; ++scanline )
+    {
+        RGB *lastRow = &rows[ ( scanline * scale + scale - 1 ) * frameWidth ];
+        for ( u32 x = 0; x < frameWidth; ++x )
+        {
+            lastRow[ x ] = { static_cast< byte >( lastRow[ x ].red >> 1 ), static_cast< byte >( lastRow[ x ].green >> 1 ), static_cast< byte >( lastRow[ x ].blue >> 1 ) };
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Types.h"
+#include "Video.h"
+#include "Upscaler.h"
+
+
+/*
+    Draws the frames away from the emulation thread. While a frame is emulated Video records the
+    registers of every visible scanline into a snapshot, and the PPU memory only when it changed
+    since the previous scanline. Once the frame is submitted the workers render one band of
+    scanlines each, upscale it and post-process it, while the emulation thread records the next
+    frame into the other snapshot. Snapshots and output frames are double buffered and nothing
+    is allocated after construction.
+ */
+
+class RenderPipeline
+{
+public:
+
+    enum class PostProcess : byte
+    {
+        None,
+        Scanlines,      /* Darkens the last row of every scaled scanline */
+    };
+
+    RenderPipeline( u32 threadCount, Upscaler::Filter filter, u32 scale, PostProcess postProcess );
+    RenderPipeline( RenderPipeline & ) = delete;
+    ~RenderPipeline();
+
+    /* Emulation thread, called by Video */
+    void RecordScanline( u32 scanline, const Video::ScanlineState &state, const Video::MemoryView &view, byte dirtyMemory );
+    void SubmitFrame();
+
+    /* Waits for the submitted frame to be completed, GetFrame returns it afterwards */
+    void Flush();
+
+    /* Last completed frame, valid until the next SubmitFrame, a submitted frame completes during the following one */
+    const RGB* GetFrame() const;
+
+    /* Palette indices and PPUMASK emphasis of the same frame, before upscaling */
+    const byte* GetIndexedFrame() const;
+    byte GetScanlineEmphasis( u32 scanline ) const;
+
+    u32 GetFrameWidth() const;
+    u32 GetFrameHeight() const;
+    u64 GetCompletedFrames() const;
+
+private:
+
+    /* A new version is only taken when the memory changes in the middle of a frame, once they run out the emulation thread renders the rest of the frame */
+    static constexpr u32 MAX_PATTERN_TABLE_VERSIONS     = 2;
+    static constexpr u32 MAX_NAMETABLE_VERSIONS         = 4;
+    static constexpr u32 MAX_PALETTE_VERSIONS           = 16;
+    static constexpr u32 MAX_OAM_VERSIONS               = 4;
+    static constexpr u32 PALETTE_SIZE                   = 32;
+
+    struct RecordedScanline
+    {
+        Video::ScanlineState    state;
+        bool                    isRendered;             /* Already drawn into the palette indices of the snapshot */
+        byte                    patternTableVersion;
+        byte                    nametableVersion;
+        byte                    paletteVersion;
+        byte                    oamVersion;
+    };
+
+    struct FrameSnapshot
+    {
+        RecordedScanline    scanlines[ Video::NES_VIDEO_HEIGHT ];
+        byte                patternTables[ MAX_PATTERN_TABLE_VERSIONS ][ 8_KB ];
+        byte                nametables[ MAX_NAMETABLE_VERSIONS ][ 4_KB ];
+        byte                palettes[ MAX_PALETTE_VERSIONS ][ PALETTE_SIZE ];
+        byte                oam[ MAX_OAM_VERSIONS ][ Video::OAM_SIZE ];
+        byte                paletteIndices[ Video::NES_VIDEO_HEIGHT ][ Video::NES_VIDEO_WIDTH ];
+        byte                patternTableVersions;
+        byte                nametableVersions;
+        byte                paletteVersions;
+        byte                oamVersions;
+        bool                isRenderedDirectly;
+    };
+
+    /* Each worker renders its band, and the rows the filter reads around it, into its own frame */
+    struct WorkerState
+    {
+        std::vector< RGB >          frame;
+        std::unique_ptr< Upscaler > upscaler;
+    };
+
+    u32                         scale;
+    PostProcess                 postProcess;
+
+    FrameSnapshot               snapshots[ 2 ];
+    std::vector< RGB >          frames[ 2 ];
+    u32                         recordingSnapshot;
+    u32                         renderingSnapshot;
+    u32                         completedFrame;
+    u64                         completedFrames;
+    bool                        isFrameInFlight;
+
+    /* Thread pool, the emulation thread only renders the scanlines a snapshot has no memory version left for */
+    std::vector< std::thread >  workers;
+    std::vector< WorkerState >  workerStates;
+    std::mutex                  mutex;
+    std::condition_variable     frameSubmitted;
+    std::condition_variable     frameFinished;
+    u64                         frameGeneration;
+    u32                         pendingWorkers;
+    bool                        quit;
+
+    /* Copies the dirty memory into new versions, false without touching the snapshot when one of them has no version left */
+    bool TryRecordMemory( FrameSnapshot &snapshot, const Video::MemoryView &view, byte dirtyMemory );
+
+    void WorkerLoop( u32 threadIndex );
+    void RenderBand( u32 threadIndex );
+    void PostProcessRows( RGB *rows, u32 scanlineCount ) const;
+    void WaitForFrame( std::unique_lock< std::mutex > &lock );
+};
@@ -0,0 +1,379 @@
+#include <cstring>
+#include <cctype>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "RomArchive.h"
+#include "Hash.h"
+
+
+namespace
+{
+    constexpr u32 ZIP_LOCAL_HEADER_SIGNATURE        = 0x04034B50;
+    constexpr u32 ZIP_CENTRAL_HEADER_SIGNATURE      = 0x02014B50;
+    constexpr u32 ZIP_END_OF_DIRECTORY_SIGNATURE    = 0x06054B50;
+    constexpr u32 ZIP_LOCAL_HEADER_SIZE             = 30;
+    constexpr u32 ZIP_CENTRAL_HEADER_SIZE           = 46;
+    constexpr u32 ZIP_END_OF_DIRECTORY_SIZE         = 22;
+    constexpr u32 ZIP_MAX_COMMENT_SIZE              = 0xFFFF;
+    constexpr u32 ZIP64_SIZE                        = 0xFFFFFFFF;
+
+    constexpr u16 ZIP_METHOD_STORED                 = 0;
+    constexpr u16 ZIP_METHOD_DEFLATED               = 8;
+
+    constexpr u32 GZIP_HEADER_SIZE                  = 10;
+    constexpr u32 GZIP_TRAILER_SIZE                 = 8;
+    constexpr byte GZIP_METHOD_DEFLATED             = 8;
+    constexpr byte GZIP_FLAG_HEADER_CRC             = 0b0000'0010;
+    constexpr byte GZIP_FLAG_EXTRA                  = 0b0000'0100;
+    constexpr byte GZIP_FLAG_NAME                   = 0b0000'1000;
+    constexpr byte GZIP_FLAG_COMMENT                = 0b0001'0000;
+
+    u16 Read16( const byte *data )
+    {
+        return static_cast< u16 >( data[ 0 ] | ( data[ 1 ] << 8 ) );
+    }
+
+    u32 Read32( const byte *data )
+    {
+        return static_cast< u32 >( data[ 0 ] ) | ( static_cast< u32 >( data[ 1 ] ) << 8 )
+            | ( static_cast< u32 >( data[ 2 ] ) << 16 ) | ( static_cast< u32 >( data[ 3 ] ) << 24 );
+    }
+
+    bool HasNesExtension( const std::string &name )
+    {
+        if ( name.size() < 4 )
+        {
+            return false;
+        }
+
+        const char *extension = &name[ name.size() - 4 ];
+        return extension[ 0 ] == '.' && tolower( extension[ 1 ] ) == 'n' && tolower( extension[ 2 ] ) == 'e' && tolower( extension[ 3 ] ) == 's';
+    }
+
+    /* Skips a zero terminated string of the gzip header, false when it runs past the data */
+    bool SkipString( const byte *data, u64 size, u64 &offset )
+    {
+        while ( offset < size && data[ offset ] != 0 )
+        {
+            ++offset;
+        }
+        ++offset;
+        return offset <= size;
+    }
+}
+
+
+RomArchive::RomArchive( const char *fileName )
+    : data( nullptr )
+    , size( 0 )
+    , isMapped( false )
+    , format( Format::None )
+{
+    Open( fileName );
+}
+
+RomArchive::RomArchive( const byte *data, u64 size )
+    : data( data )
+    , size( size )
+    , isMapped( false )
+    , format( Format::None )
+{
+    ReadEntries( nullptr );
+}
+
+RomArchive::~RomArchive()
+{
+    if ( isMapped )
+    {
+        munmap( const_cast< byte * >( data ), size );
+    }
+}
+
+void RomArchive::Open( const char *fileName )
+{
+    if ( fileName == nullptr )
+    {
+        return;
+    }
+
+    /* Mapped like the ROMs, listing a zip only faults in the pages of its central directory */
+    const i32 fileDescriptor = open( fileName, O_RDONLY );
+    if ( fileDescriptor < 0 )
+    {
+        return;
+    }
+
+    struct stat fileStatus;
+    if ( fstat( fileDescriptor, &fileStatus ) == 0 && fileStatus.st_size > 0 )
+    {
+        void *mapping = mmap( nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0 );
+        if ( mapping != MAP_FAILED )
+        {
+            data = static_cast< const byte * >( mapping );
+            size = static_cast< u64 >( fileStatus.st_size );
+            isMapped = true;
+        }
+    }
+    close( fileDescriptor );
+
+    ReadEntries( fileName );
+}
+
+void RomArchive::ReadEntries( const char *fileName )
+{
+    if ( !IsArchive( data, size ) )
+    {
+        return;
+    }
+
+    const bool isZip = Read32( data ) == ZIP_LOCAL_HEADER_SIGNATURE;
+    if ( isZip ? TryReadZipDirectory() : TryReadGzipHeader( fileName ) )
+    {
+        format = isZip ? Format::Zip : Format::Gzip;
+    }
+}
+
+bool RomArchive::IsArchive( const byte *data, u64 size )
+{
+    if ( data == nullptr || size < 4 )
+    {
+        return false;
+    }
+
+    return Read32( data ) == ZIP_LOCAL_HEADER_SIGNATURE || ( data[ 0 ] == 0x1F && data[ 1 ] == 0x8B );
+}
+
+bool RomArchive::TryReadZipDirectory()
+{
+    if ( size < ZIP_END_OF_DIRECTORY_SIZE )
+    {
+        return false;
+    }
+
+    /* The end of central directory record is at the end of the archive, followed by an optional comment */
+    const u64 searchEnd = ( size > ZIP_END_OF_DIRECTORY_SIZE + ZIP_MAX_COMMENT_SIZE ) ? size - ZIP_END_OF_DIRECTORY_SIZE - ZIP_MAX_COMMENT_SIZE : 0;
+    u64 endOfDirectory = size - ZIP_END_OF_DIRECTORY_SIZE;
+    while ( Read32( &data[ endOfDirectory ] ) != ZIP_END_OF_DIRECTORY_SIGNATURE )
+    {
+        if ( endOfDirectory == searchEnd )
+        {
+            return false;
+        }
+        --endOfDirectory;
+    }
+
+    const u16 entryCount = Read16( &data[ endOfDirectory + 10 ] );
+    const u32 directoryOffset = Read32( &data[ endOfDirectory + 16 ] );
+    if ( directoryOffset == ZIP64_SIZE )
+    {
+        return false;
+    }
+
+    entries.reserve( entryCount );
+    u64 offset = directoryOffset;
+    for ( u16 i = 0; i < entryCount; ++i )
+    {
+        if ( offset + ZIP_CENTRAL_HEADER_SIZE > endOfDirectory || Read32( &data[ offset ] ) != ZIP_CENTRAL_HEADER_SIGNATURE )
+        {
+            return false;
+        }
+
+        const byte *header = &data[ offset ];
+        const u16 method = Read16( &header[ 10 ] );
+        const u16 nameSize = Read16( &header[ 28 ] );
+        const u16 extraSize = Read16( &header[ 30 ] );
+        const u16 commentSize = Read16( &header[ 32 ] );
+        if ( offset + ZIP_CENTRAL_HEADER_SIZE + nameSize > endOfDirectory )
+        {
+            return false;
+        }
+
+        Entry entry;
+        entry.name.assign( reinterpret_cast< const char * >( &header[ ZIP_CENTRAL_HEADER_SIZE ] ), nameSize );
+        entry.crc32 = Read32( &header[ 16 ] );
+        entry.compressedSize = Read32( &header[ 20 ] );
+        entry.size = Read32( &header[ 24 ] );
+        entry.headerOffset = Read32( &header[ 42 ] );
+        entry.isDeflated = method == ZIP_METHOD_DEFLATED;
+
+        /* Directories, zip64 entries, oversized entries and other compression methods are listed by the archive but can't be extracted */
+        const bool isDirectory = nameSize > 0 && entry.name.back() == '/';
+        const bool isSupported = method == ZIP_METHOD_STORED || method == ZIP_METHOD_DEFLATED;
+        if ( !isDirectory && isSupported && entry.size <= MAX_ENTRY_SIZE && entry.compressedSize != ZIP64_SIZE )
+        {
+            entries.push_back( std::move( entry ) );
+        }
+
+        offset += ZIP_CENTRAL_HEADER_SIZE + nameSize + extraSize + commentSize;
+    }
+
+    return true;
+}
+
+bool RomArchive::TryReadGzipHeader( const char *fileName )
+{
+    if ( size < GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE || data[ 2 ] != GZIP_METHOD_DEFLATED )
+    {
+        return false;
+    }
+
+    const byte flags = data[ 3 ];
+    u64 offset = GZIP_HEADER_SIZE;
+    Entry entry;
+
+    if ( flags & GZIP_FLAG_EXTRA )
+    {
+        offset += 2 + Read16( &data[ offset ] );
+    }
+    if ( flags & GZIP_FLAG_NAME )
+    {
+        const u64 nameOffset = offset;
+        if ( !SkipString( data, size, offset ) )
+        {
+            return false;
+        }
+        entry.name.assign( reinterpret_cast< const char * >( &data[ nameOffset ] ), offset - nameOffset - 1 );
+    }
+    if ( flags & GZIP_FLAG_COMMENT && !SkipString( data, size, offset ) )
+    {
+        return false;
+    }
+    if ( flags & GZIP_FLAG_HEADER_CRC )
+    {
+        offset += 2;
+    }
+    if ( offset + GZIP_TRAILER_SIZE > size )
+    {
+        return false;
+    }
+
+    /* Without a stored name the entry is named after the archive, minus its .gz extension */
+    if ( entry.name.empty() && fileName != nullptr )
+    {
+        const char *baseName = strrchr( fileName, '/' );
+        entry.name = ( baseName != nullptr ) ? baseName + 1 : fileName;
+        if ( entry.name.size() > 3 && entry.name.compare( entry.name.size() - 3, 3, ".gz" ) == 0 )
+        {
+            entry.name.resize( entry.name.size() - 3 );
+        }
+    }
+
+    /* The trailer keeps the CRC-32 and the size modulo 4GB, more than enough for a ROM */
+    entry.crc32 = Read32( &data[ size - GZIP_TRAILER_SIZE ] );
+    entry.size = Read32( &data[ size - 4 ] );
+    if ( entry.size > MAX_ENTRY_SIZE )
+    {
+        return false;
+    }
+    entry.compressedSize = static_cast< u32 >( size - GZIP_TRAILER_SIZE - offset );
+    entry.headerOffset = offset;
+    entry.isDeflated = true;
+    entries.push_back( std::move( entry ) );
+    return true;
+}
+
+bool RomArchive::IsOpen() const
+{
+    return format != Format::None;
+}
+
+RomArchive::Format RomArchive::GetFormat() const
+{
+    return format;
+}
+
+const std::vector< RomArchive::Entry >& RomArchive::GetEntries() const
+{
+    return entries;
+}
+
+bool RomArchive::IsRomEntry( u32 entryIndex ) const
+{
+    return entryIndex < entries.size() && ( entries.size() == 1 || HasNesExtension( entries[ entryIndex ].name ) );
+}
+
+i32 RomArchive::FindRomEntry() const
+{
+    for ( u32 i = 0; i < entries.size(); ++i )
+    {
+        if ( IsRomEntry( i ) )
+        {
+            return static_cast< i32 >( i );
+        }
+    }
+
+    return -1;
+}
+
+bool RomArchive::TryGetDataOffset( const Entry &entry, u64 &dataOffset ) const
+{
+    if ( format == Format::Gzip )
+    {
+        dataOffset = entry.headerOffset;
+        return true;
+    }
+
+    /* The local header repeats the name but its extra field can differ from the central directory one */
+    if ( entry.headerOffset + ZIP_LOCAL_HEADER_SIZE > size || Read32( &data[ entry.headerOffset ] ) != ZIP_LOCAL_HEADER_SIGNATURE )
+    {
+        return false;
+    }
+
+    const byte *header = &data[ entry.headerOffset ];
+    dataOffset = entry.headerOffset + ZIP_LOCAL_HEADER_SIZE + Read16( &header[ 26 ] ) + Read16( &header[ 28 ] );
+    return dataOffset + entry.compressedSize <= size;
+}
+
+bool RomArchive::TryExtract( u32 entryIndex, byte *destination ) const
+{
+    if ( entryIndex >= entries.size() || destination == nullptr )
+    {
+        return false;
+    }
+
+    const Entry &entry = entries[ entryIndex ];
+    u64 dataOffset = 0;
+    if ( entry.size > MAX_ENTRY_SIZE || !TryGetDataOffset( entry, dataOffset ) )
+    {
+        return false;
+    }
+
+    if ( !entry.isDeflated )
+    {
+        if ( entry.compressedSize != entry.size )
+        {
+            return false;
+        }
+        memcpy( destination, &data[ dataOffset ], entry.size );
+    }
+    else
+    {
+        /* Raw deflate, the whole input and output are available so a single call inflates the entry, never more than the capped size */
+        z_stream stream;
+        memset( &stream, 0, sizeof( stream ) );
+        if ( inflateInit2( &stream, -MAX_WBITS ) != Z_OK )
+        {
+            return false;
+        }
+
+        stream.next_in = const_cast< byte * >( &data[ dataOffset ] );
+        stream.avail_in = entry.compressedSize;
+        stream.next_out = destination;
+        stream.avail_out = entry.size;
+        const i32 result = inflate( &stream, Z_FINISH );
+        const bool isComplete = result == Z_STREAM_END && stream.total_out == entry.size;
+        inflateEnd( &stream );
+
+        if ( !isComplete )
+        {
+            return false;
+        }
+    }
+
+    return Crc32( destination, entry.size, 0 ) == entry.crc32;
+}
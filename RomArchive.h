@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Read only access to ROMs stored in .zip and .gz archives. The archive is mapped, listing the
+    entries only touches the zip central directory ( or the gzip header and trailer ) so a
+    library of thousands of archives can be indexed without reading the compressed data.
+
+    An entry is inflated straight from the mapping into a buffer the caller allocates from the
+    uncompressed size the archive records, there is no temporary copy of the archive or of the
+    entry. Only stored and deflated entries are supported, zip64 archives are rejected. The
+    recorded size can't be trusted, entries claiming more than MAX_ENTRY_SIZE are rejected too.
+ */
+
+class RomArchive
+{
+public:
+
+    enum class Format : byte
+    {
+        None = 0,
+        Zip,
+        Gzip,
+
+        Count
+    };
+
+    /* Far above the largest NES ROMs, a few MB */
+    static constexpr u32 MAX_ENTRY_SIZE = 16 * 1024 * 1024;
+
+    static constexpr const char* FormatString [ static_cast< size_t >( Format::Count ) ] =
+    {
+        "None",
+        "Zip",
+        "Gzip"
+    };
+
+    struct Entry
+    {
+        std::string     name;
+        u32             size;
+        u32             compressedSize;
+        u32             crc32;
+
+        /* Zip entries point to their local header, the data offset is only known once it is read */
+        u64             headerOffset;
+        bool            isDeflated;
+    };
+
+
+    RomArchive( const char *fileName );
+    /* Reads an archive that is already in memory, the data must outlive the archive */
+    RomArchive( const byte *data, u64 size );
+    ~RomArchive();
+
+    RomArchive( const RomArchive & ) = delete;
+    RomArchive& operator=( const RomArchive & ) = delete;
+
+    static bool IsArchive( const byte *data, u64 size );
+
+    bool IsOpen() const;
+    Format GetFormat() const;
+    const std::vector< Entry >& GetEntries() const;
+
+    /* Entries with a .nes extension, or the only entry of the archive */
+    bool IsRomEntry( u32 entryIndex ) const;
+
+    /* First ROM entry, -1 when there is none */
+    i32 FindRomEntry() const;
+
+    /* destination must hold GetEntries()[ entryIndex ].size bytes, at most MAX_ENTRY_SIZE, the CRC-32 of the result is checked */
+    bool TryExtract( u32 entryIndex, byte *destination ) const;
+
+private:
+
+    const byte*             data;
+    u64                     size;
+    bool                    isMapped;
+    Format                  format;
+    std::vector< Entry >    entries;
+
+    void Open( const char *fileName );
+    void ReadEntries( const char *fileName );
+    bool TryReadZipDirectory();
+    bool TryReadGzipHeader( const char *fileName );
+    bool TryGetDataOffset( const Entry &entry, u64 &dataOffset ) const;
+};
@@ -0,0 +1,39 @@
+#include "RomDatabase.h"
+
+#include <algorithm>
+
+#include "RomDatabaseEntries.h"
+
+
+namespace
+{
+    constexpr bool IsSortedByCrc()
+    {
+        for ( size_t i = 1; i < romdatabase::ENTRIES.size(); ++i )
+        {
+            if ( romdatabase::ENTRIES[ i - 1 ].crc32 >= romdatabase::ENTRIES[ i ].crc32 )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert( IsSortedByCrc(), "The ROM database must be sorted by CRC without duplicates, regenerate it" );
+}
+
+
+namespace romdatabase
+{
+    const Entry* Find( u32 crc32 )
+    {
+        const Entry *end = ENTRIES.data() + ENTRIES.size();
+        const Entry *entry = std::lower_bound( ENTRIES.data(), end, crc32, []( const Entry &current, u32 value ) { return current.crc32 < value; } );
+        return ( entry != end && entry->crc32 == crc32 ) ? entry : nullptr;
+    }
+
+    u32 GetEntryCount()
+    {
+        return static_cast< u32 >( ENTRIES.size() );
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Types.h"
+#include "Cartridge.h"
+
+
+/*
+    Cartridges whose iNES headers are known to be wrong, keyed by the CRC-32 of the PRG and CHR
+    ROM that follow the header ( and the trainer ). The entries live in RomDatabaseEntries.h,
+    generated by Tools/GenerateRomDatabase.py from an NES 2.0 XML database and sorted by CRC so
+    a lookup is a binary search over a constexpr array, nothing is built at startup.
+ */
+
+namespace romdatabase
+{
+    struct Entry
+    {
+        u32                         crc32;
+        u16                         mapper;
+        byte                        submapper;
+        Cartridge::MirroringType    mirroringType;
+        bool                        hasPersistentMemory;
+        Cartridge::TimingRegion     timingRegion;
+
+        /* In bytes */
+        u32                         prgRamSize;
+        u32                         prgNvramSize;
+        u32                         chrRamSize;
+        u32                         chrNvramSize;
+    };
+
+    /* nullptr when the ROM is not in the database */
+    const Entry* Find( u32 crc32 );
+
+    u32 GetEntryCount();
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/*
+    Generated by Tools/GenerateRomDatabase.py, do not edit.
+    Source: none, run the script on an NES 2.0 XML database ( nes20db.xml ) to fill it.
+ */
+
+#include <array>
+
+#include "RomDatabase.h"
+
+
+namespace romdatabase
+{
+    constexpr std::array< Entry, 0 > ENTRIES = {};
+}
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RomIndex.h"
+
+
+namespace
+{
+    i32 ComparePaths( const char *path, const char *entryName, const char *otherPath, const char *otherEntryName )
+    {
+        const i32 comparison = strcmp( path, otherPath );
+        return ( comparison != 0 ) ? comparison : strcmp( entryName, otherEntryName );
+    }
+}
+
+
+RomIndex::RomIndex( const char *fileName )
+    : data( nullptr )
+    , size( 0 )
+    , header( nullptr )
+    , entries( nullptr )
+    , crcOrder( nullptr )
+    , strings( nullptr )
+{
+    const i32 fileDescriptor = ( fileName != nullptr ) ? open( fileName, O_RDONLY ) : -1;
+    if ( fileDescriptor < 0 )
+    {
+        return;
+    }
+
+    struct stat fileStatus;
+    if ( fstat( fileDescriptor, &fileStatus ) == 0 && static_cast< u64 >( fileStatus.st_size ) >= sizeof( romindex::FileHeader ) )
+    {
+        void *mapping = mmap( nullptr, fileStatus.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0 );
+        if ( mapping != MAP_FAILED )
+        {
+            data = static_cast< const byte * >( mapping );
+            size = static_cast< u64 >( fileStatus.st_size );
+        }
+    }
+    close( fileDescriptor );
+
+    if ( data == nullptr )
+    {
+        return;
+    }
+
+    /* The index is only used when its sections add up to the file size */
+    const romindex::FileHeader *fileHeader = reinterpret_cast< const romindex::FileHeader * >( data );
+    const u64 expectedSize = sizeof( romindex::FileHeader ) + static_cast< u64 >( fileHeader->entryCount ) * ( sizeof( romindex::Entry ) + sizeof( u32 ) ) + fileHeader->stringTableSize;
+    if ( fileHeader->magic != romindex::MAGIC || fileHeader->version != romindex::VERSION || expectedSize != size
+        || fileHeader->stringTableSize == 0 || data[ size - 1 ] != 0 )
+    {
+        return;
+    }
+
+    /* FindByCrc32 indexes the entries with the CRC order as is */
+    const romindex::Entry *fileEntries = reinterpret_cast< const romindex::Entry * >( fileHeader + 1 );
+    const u32 *fileCrcOrder = reinterpret_cast< const u32 * >( fileEntries + fileHeader->entryCount );
+    const u32 entryCount = fileHeader->entryCount;
+    if ( !std::all_of( fileCrcOrder, fileCrcOrder + entryCount, [ & ]( u32 index ) { return index < entryCount; } ) )
+    {
+        return;
+    }
+
+    header = fileHeader;
+    entries = fileEntries;
+    crcOrder = fileCrcOrder;
+    strings = reinterpret_cast< const char * >( crcOrder + header->entryCount );
+}
+
+RomIndex::~RomIndex()
+{
+    if ( data != nullptr )
+    {
+        munmap( const_cast< byte * >( data ), size );
+    }
+}
+
+bool RomIndex::IsOpen() const
+{
+    return header != nullptr;
+}
+
+u32 RomIndex::GetEntryCount() const
+{
+    return ( header != nullptr ) ? header->entryCount : 0;
+}
+
+const romindex::Entry& RomIndex::GetEntry( u32 index ) const
+{
+    return entries[ index ];
+}
+
+const char* RomIndex::GetString( u32 offset ) const
+{
+    return ( offset < header->stringTableSize ) ? &strings[ offset ] : "";
+}
+
+const romindex::Entry* RomIndex::LowerBound( const char *path, const char *entryName ) const
+{
+    return std::lower_bound( entries, entries + GetEntryCount(), 0, [ & ]( const romindex::Entry &entry, i32 )
+    {
+        return ComparePaths( GetString( entry.pathOffset ), GetString( entry.entryNameOffset ), path, entryName ) < 0;
+    } );
+}
+
+const romindex::Entry* RomIndex::FindByPath( const char *path, const char *entryName ) const
+{
+    const romindex::Entry *found = LowerBound( path, entryName );
+    const bool isFound = found != entries + GetEntryCount() && ComparePaths( GetString( found->pathOffset ), GetString( found->entryNameOffset ), path, entryName ) == 0;
+    return isFound ? found : nullptr;
+}
+
+u32 RomIndex::FindFirstOfPath( const char *path ) const
+{
+    /* The empty entry name sorts first */
+    const romindex::Entry *found = LowerBound( path, "" );
+    const bool isFound = found != entries + GetEntryCount() && strcmp( GetString( found->pathOffset ), path ) == 0;
+    return isFound ? static_cast< u32 >( found - entries ) : GetEntryCount();
+}
+
+std::vector< const romindex::Entry* > RomIndex::FindByCrc32( u32 crc32 ) const
+{
+    const u32 *end = crcOrder + GetEntryCount();
+    const u32 *found = std::lower_bound( crcOrder, end, crc32, [ & ]( u32 index, u32 crc )
+    {
+        return entries[ index ].crc32 < crc;
+    } );
+
+    std::vector< const romindex::Entry* > matches;
+    for ( ; found != end && entries[ *found ].crc32 == crc32; ++found )
+    {
+        matches.push_back( &entries[ *found ] );
+    }
+    return matches;
+}
+
+bool RomIndex::Write( const char *fileName, std::vector< romindex::Entry > &indexEntries, const std::string &indexStrings )
+{
+    /* The string table always ends with a zero, the reader relies on it to never run past the mapping */
+    const std::string stringTable = indexStrings + '\0';
+    const auto getString = [ & ]( u32 offset ) { return &stringTable[ offset ]; };
+
+    std::sort( indexEntries.begin(), indexEntries.end(), [ & ]( const romindex::Entry &a, const romindex::Entry &b )
+    {
+        return ComparePaths( getString( a.pathOffset ), getString( a.entryNameOffset ), getString( b.pathOffset ), getString( b.entryNameOffset ) ) < 0;
+    } );
+
+    std::vector< u32 > order( indexEntries.size() );
+    for ( u32 i = 0; i < order.size(); ++i )
+    {
+        order[ i ] = i;
+    }
+    std::stable_sort( order.begin(), order.end(), [ & ]( u32 a, u32 b ) { return indexEntries[ a ].crc32 < indexEntries[ b ].crc32; } );
+
+    romindex::FileHeader fileHeader;
+    fileHeader.magic = romindex::MAGIC;
+    fileHeader.version = romindex::VERSION;
+    fileHeader.entryCount = static_cast< u32 >( indexEntries.size() );
+    fileHeader.stringTableSize = static_cast< u32 >( stringTable.size() );
+
+    /* Written next to the index and renamed over it, readers that mapped the previous one keep it */
+    const std::string temporaryFileName = std::string( fileName ) + ".tmp";
+    FILE *file = fopen( temporaryFileName.c_str(), "wb" );
+    if ( file == nullptr )
+    {
+        return false;
+    }
+
+    bool isWritten = fwrite( &fileHeader, sizeof( fileHeader ), 1, file ) == 1;
+    isWritten = isWritten && fwrite( indexEntries.data(), sizeof( romindex::Entry ), indexEntries.size(), file ) == indexEntries.size();
+    isWritten = isWritten && fwrite( order.data(), sizeof( u32 ), order.size(), file ) == order.size();
+    isWritten = isWritten && fwrite( stringTable.data(), 1, stringTable.size(), file ) == stringTable.size();
+    isWritten = ( fclose( file ) == 0 ) && isWritten;
+
+    if ( !isWritten || rename( temporaryFileName.c_str(), fileName ) != 0 )
+    {
+        remove( temporaryFileName.c_str() );
+        return false;
+    }
+
+    return true;
+}
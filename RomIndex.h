@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Metadata index of a ROM library, written by patnes-scan and mapped read only to look ROMs
+    up without opening them.
+
+    +------------+-------------------+----------------------+--------------------------+
+    | FileHeader | Entry[ count ]    | u32 crcOrder[ count ]| zero terminated strings  |
+    +------------+-------------------+----------------------+--------------------------+
+
+    Entries are sorted by path and entry name, crcOrder lists them by CRC-32, so both lookups
+    are a binary search over the mapping. ROMs inside an archive share the path of the archive
+    and have the name of their archive entry, plain ROMs have an empty entry name. Every entry
+    keeps the size and modification time of its file so a rescan only opens what changed.
+ */
+
+namespace romindex
+{
+    constexpr u32 MAGIC     = 0x50494458; /* 'PIDX' */
+    constexpr u32 VERSION   = 1;
+
+    enum Flags : byte
+    {
+        LOADED          = 0b0000'0001,
+        SUPPORTED       = 0b0000'0010,
+        NES20           = 0b0000'0100,
+        BATTERY         = 0b0000'1000,
+        FROM_DATABASE   = 0b0001'0000,
+    };
+
+    struct FileHeader
+    {
+        u32     magic;
+        u32     version;
+        u32     entryCount;
+        u32     stringTableSize;
+    };
+
+    struct Entry
+    {
+        u64     fileSize;
+        i64     modificationTime;
+
+        /* XXH64 and CRC-32 of the PRG and CHR ROM */
+        u64     payloadHash;
+        u32     crc32;
+
+        /* Offsets in the string table */
+        u32     pathOffset;
+        u32     entryNameOffset;
+
+        u32     prgRomSizeKB;
+        u32     chrRomSizeKB;
+        u16     mapper;
+        byte    submapper;
+        byte    flags;
+        byte    mirroringType;
+        byte    timingRegion;
+        byte    reserved[ 2 ];
+    };
+
+    static_assert( sizeof( FileHeader ) % alignof( Entry ) == 0, "Entries must stay aligned in the mapping" );
+}
+
+
+class RomIndex
+{
+public:
+
+    RomIndex( const char *fileName );
+    ~RomIndex();
+
+    RomIndex( const RomIndex & ) = delete;
+    RomIndex& operator=( const RomIndex & ) = delete;
+
+    bool IsOpen() const;
+    u32 GetEntryCount() const;
+    const romindex::Entry& GetEntry( u32 index ) const;
+    const char* GetString( u32 offset ) const;
+
+    /* nullptr when there is no such entry */
+    const romindex::Entry* FindByPath( const char *path, const char *entryName ) const;
+
+    /* Every copy of a ROM, empty when there is none */
+    std::vector< const romindex::Entry* > FindByCrc32( u32 crc32 ) const;
+
+    /* Index of the first entry of a file, the entries of an archive follow it, GetEntryCount() when there is none */
+    u32 FindFirstOfPath( const char *path ) const;
+
+    /* Sorts the entries, strings holds the zero terminated strings their offsets point to */
+    static bool Write( const char *fileName, std::vector< romindex::Entry > &entries, const std::string &strings );
+
+private:
+
+    const byte*                 data;
+    u64                         size;
+    const romindex::FileHeader* header;
+    const romindex::Entry*      entries;
+    const u32*                  crcOrder;
+    const char*                 strings;
+
+    const romindex::Entry* LowerBound( const char *path, const char *entryName ) const;
+};
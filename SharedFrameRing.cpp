@@ -0,0 +1,176 @@
+#include "SharedFrameRing.h"
+
+#include <assert.h>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+u32 sharedframe::GetSlotSize( u32 width, u32 height, u32 ramSize )
+{
+    const u32 payloadSize = sizeof( SharedFrameSlot ) + width * height * sizeof( RGB ) + ramSize;
+    return ( payloadSize + CACHE_LINE_SIZE - 1 ) & ~( CACHE_LINE_SIZE - 1 );
+}
+
+
+/* ------------------- PUBLISHER -------------------*/
+
+SharedFramePublisher::SharedFramePublisher( const char *name, u32 slotCount, u32 width, u32 height, u32 ramSize )
+    : name( name )
+    , header( nullptr )
+    , slots( nullptr )
+    , mappingSize( 0u )
+    , frameCount( 0u )
+{
+    assert( name != nullptr );
+    assert( slotCount > 0 );
+
+    const u32 slotSize = sharedframe::GetSlotSize( width, height, ramSize );
+    mappingSize = sizeof( sharedframe::SharedFrameHeader ) + static_cast< u64 >( slotSize ) * slotCount;
+
+    const i32 fileDescriptor = shm_open( name, O_CREAT | O_RDWR, 0600 );
+    if ( fileDescriptor < 0 )
+    {
+        return;
+    }
+
+    void *mapping = MAP_FAILED;
+    if ( ftruncate( fileDescriptor, mappingSize ) == 0 )
+    {
+        mapping = mmap( nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0 );
+    }
+    close( fileDescriptor );
+
+    if ( mapping == MAP_FAILED )
+    {
+        shm_unlink( name );
+        return;
+    }
+
+    memset( mapping, 0x00, mappingSize );
+
+    header = new ( mapping ) sharedframe::SharedFrameHeader();
+    header->version = sharedframe::VERSION;
+    header->slotCount = slotCount;
+    header->slotSize = slotSize;
+    header->width = width;
+    header->height = height;
+    header->ramSize = ramSize;
+    header->publishedFrames.store( 0u, std::memory_order_relaxed );
+
+    slots = static_cast< byte * >( mapping ) + sizeof( sharedframe::SharedFrameHeader );
+    for ( u32 i = 0; i < slotCount; ++i )
+    {
+        new ( &slots[ i * slotSize ] ) sharedframe::SharedFrameSlot();
+    }
+
+    /* Readers only trust the layout once the magic is visible */
+    std::atomic_thread_fence( std::memory_order_release );
+    header->magic = sharedframe::MAGIC;
+}
+
+SharedFramePublisher::~SharedFramePublisher()
+{
+    if ( header != nullptr )
+    {
+        munmap( header, mappingSize );
+        shm_unlink( name );
+    }
+}
+
+bool SharedFramePublisher::IsOpen() const
+{
+    return header != nullptr;
+}
+
+void SharedFramePublisher::Publish( const RGB *frameBuffer, const byte *ram )
+{
+    assert( IsOpen() );
+
+    sharedframe::SharedFrameSlot *slot = reinterpret_cast< sharedframe::SharedFrameSlot * >( &slots[ ( frameCount % header->slotCount ) * header->slotSize ] );
+
+    /* Odd sequence: readers of the previous frame in this slot will notice it changed */
+    slot->sequence.store( frameCount * 2 + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    RGB *slotFrameBuffer = slot->GetFrameBuffer();
+    memcpy( slotFrameBuffer, frameBuffer, header->width * header->height * sizeof( RGB ) );
+    memcpy( reinterpret_cast< byte * >( slotFrameBuffer + header->width * header->height ), ram, header->ramSize );
+    slot->frameNumber = frameCount;
+
+    slot->sequence.store( ( frameCount + 1 ) * 2, std::memory_order_release );
+
+    ++frameCount;
+    header->publishedFrames.store( frameCount, std::memory_order_release );
+}
+
+
+/* ------------------- SUBSCRIBER -------------------*/
+
+SharedFrameSubscriber::SharedFrameSubscriber( const char *name )
+    : header( nullptr )
+    , slots( nullptr )
+    , mappingSize( 0u )
+{
+    assert( name != nullptr );
+
+    const i32 fileDescriptor = shm_open( name, O_RDONLY, 0 );
+    if ( fileDescriptor < 0 )
+    {
+        return;
+    }
+
+    struct stat fileStatus;
+    void *mapping = MAP_FAILED;
+    if ( fstat( fileDescriptor, &fileStatus ) == 0 && static_cast< u64 >( fileStatus.st_size ) >= sizeof( sharedframe::SharedFrameHeader ) )
+    {
+        mappingSize = fileStatus.st_size;
+        mapping = mmap( nullptr, mappingSize, PROT_READ, MAP_SHARED, fileDescriptor, 0 );
+    }
+    close( fileDescriptor );
+
+    if ( mapping == MAP_FAILED )
+    {
+        return;
+    }
+
+    const sharedframe::SharedFrameHeader *mappedHeader = static_cast< const sharedframe::SharedFrameHeader * >( mapping );
+    const bool isValid = mappedHeader->magic == sharedframe::MAGIC && mappedHeader->version == sharedframe::VERSION;
+    std::atomic_thread_fence( std::memory_order_acquire );
+
+    if ( !isValid || sizeof( sharedframe::SharedFrameHeader ) + static_cast< u64 >( mappedHeader->slotSize ) * mappedHeader->slotCount > mappingSize )
+    {
+        munmap( mapping, mappingSize );
+        return;
+    }
+
+    header = mappedHeader;
+    slots = static_cast< const byte * >( mapping ) + sizeof( sharedframe::SharedFrameHeader );
+}
+
+SharedFrameSubscriber::~SharedFrameSubscriber()
+{
+    if ( header != nullptr )
+    {
+        munmap( const_cast< sharedframe::SharedFrameHeader * >( header ), mappingSize );
+    }
+}
+
+bool SharedFrameSubscriber::IsOpen() const
+{
+    return header != nullptr;
+}
+
+const sharedframe::SharedFrameHeader* SharedFrameSubscriber::GetHeader() const
+{
+    return header;
+}
+
+u64 SharedFrameSubscriber::GetPublishedFrames() const
+{
+    return header->publishedFrames.load( std::memory_order_acquire );
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+
+#include "Types.h"
+
+
+/*
+    Publishes completed frames ( frame buffer + 2KB of RAM ) into a POSIX shared memory ring
+    so out of process consumers can read them in place without sockets or serialization.
+
+    +-------------------+-------------+-------------+-----+-------------+
+    | SharedFrameHeader | Slot 0      | Slot 1      | ... | Slot N - 1  |
+    +-------------------+-------------+-------------+-----+-------------+
+
+    Every slot is protected by a seqlock. The writer makes the slot sequence odd while it
+    copies a frame and even again once it is done, then bumps publishedFrames. Readers pick
+    the slot of the frame they want, read it in place and accept the data only if the slot
+    sequence was even and didn't change while reading. There is a single writer and any
+    number of readers, readers never block the writer.
+ */
+
+namespace sharedframe
+{
+    constexpr u32 MAGIC             = 0x5041544E; /* 'PATN' */
+    constexpr u32 VERSION           = 1;
+    constexpr u32 CACHE_LINE_SIZE   = 64;
+
+    static_assert( std::atomic< u64 >::is_always_lock_free, "The ring needs lock free atomics to live in shared memory" );
+
+    struct alignas( CACHE_LINE_SIZE ) SharedFrameHeader
+    {
+        u32                 magic;
+        u32                 version;
+        u32                 slotCount;
+        u32                 slotSize;
+        u32                 width;
+        u32                 height;
+        u32                 ramSize;
+        u32                 reserved;
+
+        /* Number of frames written so far, frame N lives in slot N % slotCount */
+        alignas( CACHE_LINE_SIZE ) std::atomic< u64 > publishedFrames;
+    };
+
+    struct alignas( CACHE_LINE_SIZE ) SharedFrameSlot
+    {
+        std::atomic< u64 >  sequence;
+        u64                 frameNumber;
+
+        /* Followed by width * height RGB pixels and ramSize bytes of RAM */
+        const RGB*  GetFrameBuffer() const  { return reinterpret_cast< const RGB * >( this + 1 ); }
+        RGB*        GetFrameBuffer()        { return reinterpret_cast< RGB * >( this + 1 ); }
+    };
+
+    u32 GetSlotSize( u32 width, u32 height, u32 ramSize );
+}
+
+
+class SharedFramePublisher
+{
+public:
+
+    SharedFramePublisher( const char *name, u32 slotCount, u32 width, u32 height, u32 ramSize );
+    SharedFramePublisher( SharedFramePublisher & ) = delete;
+    ~SharedFramePublisher();
+
+    bool IsOpen() const;
+    void Publish( const RGB *frameBuffer, const byte *ram );
+
+private:
+    const char                      *name;
+    sharedframe::SharedFrameHeader  *header;
+    byte                            *slots;
+    u64                             mappingSize;
+    u64                             frameCount;
+};
+
+
+class SharedFrameSubscriber
+{
+public:
+
+    SharedFrameSubscriber( const char *name );
+    SharedFrameSubscriber( SharedFrameSubscriber & ) = delete;
+    ~SharedFrameSubscriber();
+
+    bool IsOpen() const;
+    const sharedframe::SharedFrameHeader* GetHeader() const;
+    u64 GetPublishedFrames() const;
+
+    /*
+        Calls reader( slot, frameBuffer, ram ) with pointers into the shared memory and returns
+        true if the frame wasn't overwritten while the reader was looking at it. A frame that
+        has already been recycled by the writer returns false without calling the reader.
+     */
+    template< typename Reader >
+    bool TryRead( u64 frame, Reader &&reader ) const;
+
+private:
+    const sharedframe::SharedFrameHeader    *header;
+    const byte                              *slots;
+    u64                                     mappingSize;
+};
+
+
+template< typename Reader >
+bool SharedFrameSubscriber::TryRead( u64 frame, Reader &&reader ) const
+{
+    const sharedframe::SharedFrameSlot *slot = reinterpret_cast< const sharedframe::SharedFrameSlot * >( &slots[ ( frame % header->slotCount ) * header->slotSize ] );
+
+    const u64 expectedSequence = ( frame + 1 ) * 2;
+    if ( slot->sequence.load( std::memory_order_acquire ) != expectedSequence )
+    {
+        return false;
+    }
+
+    const RGB *frameBuffer = slot->GetFrameBuffer();
+    const byte *ram = reinterpret_cast< const byte * >( frameBuffer + header->width * header->height );
+    reader( *slot, frameBuffer, ram );
+
+    std::atomic_thread_fence( std::memory_order_acquire );
+    return slot->sequence.load( std::memory_order_relaxed ) == expectedSequence;
+}
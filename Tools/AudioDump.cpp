@@ -0,0 +1,179 @@
+#include <iostream>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+
+#include "../AudioRing.h"
+#include "../Cartridge.h"
+#include "../CpuTypes.h"
+#include "../Emulator.h"
+#include "../Memory.h"
+#include "../WavWriter.h"
+
+
+/*
+    Headless audio sink: runs a rom for a number of frames and writes what the APU produced to
+    a WAV file, so the audio output can be checked in CI without an audio device.
+
+    With --ring the samples go through an AudioRing to a consumer thread playing the part of
+    an audio device whose clock runs a bit faster than the emulated one, and the WAV file gets
+    what that device read. Both threads follow a simulated clock, so the run doesn't take real
+    time, but they really run at the same time on the ring. The producer applies the rate
+    adjustment of the ring every frame, and the run fails if the device ever ran out of
+    samples or the ring overflowed.
+ */
+
+namespace
+{
+    constexpr u32 RING_CAPACITY         = 4096;
+
+    /* The device reads blocks on its own clock, 0.2% faster than the emulation produces */
+    constexpr u32 DEVICE_BLOCK_SIZE     = 256;
+    constexpr r64 DEVICE_CLOCK_SKEW     = 1.002;
+
+    constexpr r64 FRAME_SECONDS         = static_cast< r64 >( AVERAGE_CYCLES_PER_FRAME ) / Audio::CPU_CLOCK_RATE;
+    constexpr r64 BLOCK_SECONDS         = DEVICE_BLOCK_SIZE / ( Audio::SAMPLE_RATE * DEVICE_CLOCK_SKEW );
+
+    /* The device starts once the ring had time to fill half way */
+    constexpr r64 DEVICE_START_SECONDS  = ( RING_CAPACITY / 2 ) / static_cast< r64 >( Audio::SAMPLE_RATE );
+
+    constexpr r64 NO_MORE_EVENTS        = std::numeric_limits< r64 >::max();
+
+    /* Each side only runs its next event once the other side has no earlier one */
+    void WaitForTurn( r64 eventTime, const std::atomic< r64 > &otherEventTime )
+    {
+        while ( eventTime > otherEventTime.load( std::memory_order_acquire ) )
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    int DumpThroughRing( Emulator &emulator, WavWriter &wavWriter, u32 frames )
+    {
+        AudioRing ring( RING_CAPACITY );
+        std::atomic< r64 > producerEventTime( FRAME_SECONDS );
+        std::atomic< r64 > consumerEventTime( DEVICE_START_SECONDS );
+
+        u32 underruns = 0;
+        u32 minimumFill = RING_CAPACITY;
+        u32 maximumFill = 0;
+        bool isWriteFailed = false;
+
+        std::thread device( [ & ]()
+            {
+                const r64 endTime = frames * FRAME_SECONDS;
+                for ( u64 block = 0; ; ++block )
+                {
+                    const r64 eventTime = DEVICE_START_SECONDS + block * BLOCK_SECONDS;
+                    if ( eventTime > endTime )
+                    {
+                        break;
+                    }
+                    consumerEventTime.store( eventTime, std::memory_order_release );
+                    WaitForTurn( eventTime, producerEventTime );
+
+                    const u32 fill = ring.GetAvailable();
+                    minimumFill = ( fill < minimumFill ) ? fill : minimumFill;
+                    maximumFill = ( fill > maximumFill ) ? fill : maximumFill;
+
+                    i16 samples[ DEVICE_BLOCK_SIZE ];
+                    underruns += ( ring.Read( samples, DEVICE_BLOCK_SIZE ) < DEVICE_BLOCK_SIZE ) ? 1 : 0;
+                    isWriteFailed = isWriteFailed || !wavWriter.Write( samples, DEVICE_BLOCK_SIZE );
+                }
+                consumerEventTime.store( NO_MORE_EVENTS, std::memory_order_release );
+            }
+        );
+
+        u32 droppedSamples = 0;
+        for ( u32 frame = 0; frame < frames; ++frame )
+        {
+            const r64 eventTime = ( frame + 1 ) * FRAME_SECONDS;
+            producerEventTime.store( eventTime, std::memory_order_release );
+            WaitForTurn( eventTime, consumerEventTime );
+
+            emulator.RunFrame();
+
+            i16 samples[ 2048 ];
+            const u32 sampleCount = emulator.GetAudio().ReadSamples( samples, 2048 );
+            droppedSamples += sampleCount - ring.Write( samples, sampleCount );
+            emulator.GetAudio().SetRateAdjustment( ring.GetRateAdjustment() );
+        }
+        producerEventTime.store( NO_MORE_EVENTS, std::memory_order_release );
+        device.join();
+
+        if ( isWriteFailed )
+        {
+            std::cout << "The audio dump couldn't be written";
+            return -1;
+        }
+
+        std::cout << "Ring: " << underruns << " underruns, " << droppedSamples << " dropped samples, fill " << minimumFill << " - " << maximumFill
+            << " of " << ring.GetCapacity() << ", rate adjustment " << ring.GetRateAdjustment() << std::endl;
+        return ( underruns == 0 && droppedSamples == 0 ) ? 0 : 1;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc < 3 )
+    {
+        std::cout << "Usage: AudioDump <rom> <output wav file> [--frames <n>] [--ring]";
+        return -1;
+    }
+
+    u32 frames = 600;
+    bool isRingDump = false;
+    for ( i32 i = 3; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--frames" ) == 0 && i + 1 < argc )  { frames = std::stoul( argv[ ++i ] ); }
+        else if ( strcmp( argv[ i ], "--ring" ) == 0 )                { isRingDump = true; }
+        else
+        {
+            std::cout << "Usage: AudioDump <rom> <output wav file> [--frames <n>] [--ring]";
+            return -1;
+        }
+    }
+
+    Cartridge cartridge( argv[ 1 ] );
+    if ( !cartridge.IsLoaded() )
+    {
+        std::cout << "The cartridge couldn't be loaded";
+        return -1;
+    }
+
+    if ( !Memory::IsCartridgeSupported( cartridge ) )
+    {
+        std::cout << "The cartridge isn't supported";
+        return -1;
+    }
+
+    WavWriter wavWriter;
+    if ( !wavWriter.TryOpen( argv[ 2 ], Audio::SAMPLE_RATE, 1 ) )
+    {
+        std::cout << "The audio dump " << argv[ 2 ] << " couldn't be created";
+        return -1;
+    }
+
+    Emulator emulator( &cartridge );
+    if ( isRingDump )
+    {
+        return DumpThroughRing( emulator, wavWriter, frames );
+    }
+
+    for ( u32 frame = 0; frame < frames; ++frame )
+    {
+        emulator.RunFrame();
+
+        i16 samples[ 2048 ];
+        const u32 sampleCount = emulator.GetAudio().ReadSamples( samples, 2048 );
+        if ( !wavWriter.Write( samples, sampleCount ) )
+        {
+            std::cout << "The audio dump couldn't be written";
+            return -1;
+        }
+    }
+
+    return 0;
+}
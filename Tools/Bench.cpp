@@ -0,0 +1,493 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <thread>
+
+#include <sys/resource.h>
+
+#include "../Cartridge.h"
+#include "../Emulator.h"
+#include "../RenderPipeline.h"
+#include "../NtscFilter.h"
+#include "../Debugger/Debugger.h"
+
+
+/*
+    patnes-bench: emulation throughput benchmark.
+
+    Every scenario runs a synthetic NROM program for a fixed amount of frames, so the numbers
+    are comparable between commits. The results are printed and optionally written as JSON,
+    with one scenario per line so a previous run can be passed back with --compare.
+
+    --check-pipeline runs the PPU scenarios on the direct renderer and on the render pipeline
+    side by side instead, and fails when the frame hashes differ.
+
+    Usage: patnes-bench [--frames <n>] [--label <name>] [--json <file>] [--compare <file>] [--max-regression <percent>] [--check-pipeline]
+ */
+
+namespace
+{
+    struct ScenarioResult
+    {
+        std::string     name;
+        u64             instructions;
+        u64             frames;
+        r64             seconds;
+
+        r64 GetInstructionsPerSecond() const    { return instructions / seconds; }
+        r64 GetFramesPerSecond() const          { return frames / seconds; }
+    };
+
+    /* Tight arithmetic loop over the zero page, never touches the PPU */
+    const std::vector< byte > CPU_LOOP_PROGRAM =
+    {
+        0xA2, 0x00,         /* C000: LDX #$00       */
+        0xA0, 0x10,         /* C002: LDY #$10       */
+        0xB5, 0x00,         /* C004: LDA $00,X      */
+        0x69, 0x01,         /* C006: ADC #$01       */
+        0x95, 0x00,         /* C008: STA $00,X      */
+        0xE8,               /* C00A: INX            */
+        0xD0, 0xF7,         /* C00B: BNE $C004      */
+        0x88,               /* C00D: DEY            */
+        0xD0, 0xF4,         /* C00E: BNE $C004      */
+        0x4C, 0x00, 0xC0,   /* C010: JMP $C000      */
+    };
+
+    /* Scroll and VRAM updates in a loop, every instruction but the branches hits a PPU register */
+    const std::vector< byte > PPU_SCROLL_PROGRAM =
+    {
+        0xAD, 0x02, 0x20,   /* C000: LDA $2002      */
+        0xA9, 0x00,         /* C003: LDA #$00       */
+        0x8D, 0x05, 0x20,   /* C005: STA $2005      */
+        0x8D, 0x05, 0x20,   /* C008: STA $2005      */
+        0xA9, 0x20,         /* C00B: LDA #$20       */
+        0x8D, 0x06, 0x20,   /* C00D: STA $2006      */
+        0xA9, 0x00,         /* C010: LDA #$00       */
+        0x8D, 0x06, 0x20,   /* C012: STA $2006      */
+        0xA2, 0x20,         /* C015: LDX #$20       */
+        0x8E, 0x07, 0x20,   /* C017: STX $2007      */
+        0xCA,               /* C01A: DEX            */
+        0xD0, 0xFA,         /* C01B: BNE $C017      */
+        0x4C, 0x00, 0xC0,   /* C01D: JMP $C000      */
+    };
+
+    /* Writes to the cartridge register space as fast as possible, which is where mappers switch banks */
+    const std::vector< byte > BANK_SWITCH_PROGRAM =
+    {
+        0xA2, 0x00,         /* C000: LDX #$00       */
+        0x8A,               /* C002: TXA            */
+        0x9D, 0x00, 0x80,   /* C003: STA $8000,X    */
+        0xE8,               /* C006: INX            */
+        0xD0, 0xF9,         /* C007: BNE $C002      */
+        0x4C, 0x00, 0xC0,   /* C009: JMP $C000      */
+    };
+
+    /* Every sound channel enabled while the timer periods change constantly, plus the sample read back */
+    const std::vector< byte > AUDIO_PROGRAM =
+    {
+        0xA9, 0x0F,         /* C000: LDA #$0F       */
+        0x8D, 0x15, 0x40,   /* C002: STA $4015      */
+        0xA9, 0xBF,         /* C005: LDA #$BF       */
+        0x8D, 0x00, 0x40,   /* C007: STA $4000      */
+        0x8D, 0x04, 0x40,   /* C00A: STA $4004      */
+        0x8D, 0x0C, 0x40,   /* C00D: STA $400C      */
+        0xA9, 0xFF,         /* C010: LDA #$FF       */
+        0x8D, 0x08, 0x40,   /* C012: STA $4008      */
+        0xA9, 0x08,         /* C015: LDA #$08       */
+        0x8D, 0x03, 0x40,   /* C017: STA $4003      */
+        0x8D, 0x07, 0x40,   /* C01A: STA $4007      */
+        0x8D, 0x0B, 0x40,   /* C01D: STA $400B      */
+        0x8D, 0x0F, 0x40,   /* C020: STA $400F      */
+        0xA9, 0x04,         /* C023: LDA #$04       */
+        0x8D, 0x0E, 0x40,   /* C025: STA $400E      */
+        0x8E, 0x02, 0x40,   /* C028: STX $4002      */
+        0x8E, 0x06, 0x40,   /* C02B: STX $4006      */
+        0x8E, 0x0A, 0x40,   /* C02E: STX $400A      */
+        0xE8,               /* C031: INX            */
+        0xD0, 0xF4,         /* C032: BNE $C028      */
+        0x4C, 0x28, 0xC0,   /* C034: JMP $C028      */
+    };
+
+    /* Game like mix: some logic, a VRAM update, reading the controller */
+    const std::vector< byte > FULL_FRAME_PROGRAM =
+    {
+        0xA2, 0x00,         /* C000: LDX #$00       */
+        0xB5, 0x00,         /* C002: LDA $00,X      */
+        0x69, 0x03,         /* C004: ADC #$03       */
+        0x95, 0x00,         /* C006: STA $00,X      */
+        0xE8,               /* C008: INX            */
+        0xD0, 0xF7,         /* C009: BNE $C002      */
+        0xAD, 0x02, 0x20,   /* C00B: LDA $2002      */
+        0xA9, 0x21,         /* C00E: LDA #$21       */
+        0x8D, 0x06, 0x20,   /* C010: STA $2006      */
+        0xA9, 0x00,         /* C013: LDA #$00       */
+        0x8D, 0x06, 0x20,   /* C015: STA $2006      */
+        0xA0, 0x10,         /* C018: LDY #$10       */
+        0x8C, 0x07, 0x20,   /* C01A: STY $2007      */
+        0x88,               /* C01D: DEY            */
+        0xD0, 0xFA,         /* C01E: BNE $C01A      */
+        0xA9, 0x01,         /* C020: LDA #$01       */
+        0x8D, 0x16, 0x40,   /* C022: STA $4016      */
+        0xA9, 0x00,         /* C025: LDA #$00       */
+        0x8D, 0x16, 0x40,   /* C027: STA $4016      */
+        0xAD, 0x16, 0x40,   /* C02A: LDA $4016      */
+        0x4C, 0x00, 0xC0,   /* C02D: JMP $C000      */
+    };
+
+    /* Fills the nametable with every tile, shows the background and spins, the frame only changes on the render side */
+    const std::vector< byte > TILES_PROGRAM =
+    {
+        0xAD, 0x02, 0x20,   /* C000: LDA $2002      */
+        0xA9, 0x3F,         /* C003: LDA #$3F       */
+        0x8D, 0x06, 0x20,   /* C005: STA $2006      */
+        0xA9, 0x00,         /* C008: LDA #$00       */
+        0x8D, 0x06, 0x20,   /* C00A: STA $2006      */
+        0xA9, 0x0F,         /* C00D: LDA #$0F       */
+        0x8D, 0x07, 0x20,   /* C00F: STA $2007      */
+        0xA9, 0x16,         /* C012: LDA #$16       */
+        0x8D, 0x07, 0x20,   /* C014: STA $2007      */
+        0xA9, 0x2A,         /* C017: LDA #$2A       */
+        0x8D, 0x07, 0x20,   /* C019: STA $2007      */
+        0xA9, 0x30,         /* C01C: LDA #$30       */
+        0x8D, 0x07, 0x20,   /* C01E: STA $2007      */
+        0xA9, 0x20,         /* C021: LDA #$20       */
+        0x8D, 0x06, 0x20,   /* C023: STA $2006      */
+        0xA9, 0x00,         /* C026: LDA #$00       */
+        0x8D, 0x06, 0x20,   /* C028: STA $2006      */
+        0xA0, 0x04,         /* C02B: LDY #$04       */
+        0xA2, 0x00,         /* C02D: LDX #$00       */
+        0x8E, 0x07, 0x20,   /* C02F: STX $2007      */
+        0xE8,               /* C032: INX            */
+        0xD0, 0xFA,         /* C033: BNE $C02F      */
+        0x88,               /* C035: DEY            */
+        0xD0, 0xF7,         /* C036: BNE $C02F      */
+        0xA9, 0x00,         /* C038: LDA #$00       */
+        0x8D, 0x05, 0x20,   /* C03A: STA $2005      */
+        0x8D, 0x05, 0x20,   /* C03D: STA $2005      */
+        0xA9, 0x0A,         /* C040: LDA #$0A       */
+        0x8D, 0x01, 0x20,   /* C042: STA $2001      */
+        0x4C, 0x45, 0xC0,   /* C045: JMP $C045      */
+    };
+
+    std::vector< byte > BuildNromImage( const std::vector< byte > &program )
+    {
+        /* NROM-128: 16KB of PRG mirrored at 0x8000 and 0xC000, the program starts at 0xC000 */
+        static constexpr u32 HEADER_SIZE = 16;
+        static constexpr u32 PRG_SIZE = 16_KB;
+        static constexpr u32 CHR_SIZE = 8_KB;
+
+        std::vector< byte > image( HEADER_SIZE + PRG_SIZE + CHR_SIZE, 0x00 );
+        const byte header[] = { 0x4E, 0x45, 0x53, 0x1A, 0x01, 0x01 };
+        memcpy( image.data(), header, sizeof( header ) );
+        memcpy( &image[ HEADER_SIZE ], program.data(), program.size() );
+
+        /* Diagonal steps and solid blocks, so the upscalers see both edges and flat areas */
+        for ( u32 tile = 0; tile < 256; ++tile )
+        {
+            for ( u32 row = 0; row < 8; ++row )
+            {
+                image[ HEADER_SIZE + PRG_SIZE + tile * 16 + row ] = static_cast< byte >( 0xFF << ( ( row + tile ) & 0x07 ) );
+                image[ HEADER_SIZE + PRG_SIZE + tile * 16 + row + 8 ] = ( tile & 0x10 ) ? static_cast< byte >( 0xF0 >> ( row & 0x03 ) ) : 0x00;
+            }
+        }
+
+        /* NMI, RESET and IRQ vectors all point to the program */
+        for ( u32 vector = PRG_SIZE - 6; vector < PRG_SIZE; vector += 2 )
+        {
+            image[ HEADER_SIZE + vector ] = 0x00;
+            image[ HEADER_SIZE + vector + 1 ] = 0xC0;
+        }
+
+        return image;
+    }
+
+    template< typename InstructionHook >
+    ScenarioResult RunScenario( const char *name, const std::vector< byte > &program, u32 frames, InstructionHook &&hook )
+    {
+        const std::vector< byte > image = BuildNromImage( program );
+        Cartridge cartridge( image.data(), static_cast< u32 >( image.size() ), name );
+        Emulator emulator( &cartridge );
+
+        ScenarioResult result = { name, 0u, frames, 0.0 };
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        for ( u32 frame = 0; frame < frames; ++frame )
+        {
+            do
+            {
+                emulator.StepInstruction();
+                hook( emulator );
+                ++result.instructions;
+            }
+            while ( !emulator.IsFrameCompleted() );
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        result.seconds = std::chrono::duration< r64 >( end - start ).count();
+        return result;
+    }
+
+    /* Renders on the pipeline threads, which is attached once the emulator of the scenario exists */
+    ScenarioResult RunRenderPipelineScenario( const char *name, const std::vector< byte > &program, u32 frames, u32 threadCount, Upscaler::Filter filter, u32 scale )
+    {
+        RenderPipeline renderPipeline( threadCount, filter, scale, RenderPipeline::PostProcess::None );
+        Video *attachedVideo = nullptr;
+        const auto attachHook = [ & ]( Emulator &emulator )
+        {
+            if ( attachedVideo != &emulator.GetVideo() )
+            {
+                attachedVideo = &emulator.GetVideo();
+                attachedVideo->SetRenderPipeline( &renderPipeline );
+            }
+        };
+
+        return RunScenario( name, program, frames, attachHook );
+    }
+
+    /* Same program on two emulators, one drawing directly and one recording into the pipeline, the frames must be identical */
+    bool CheckRenderPipeline( const char *name, const std::vector< byte > &program, u32 frames )
+    {
+        const std::vector< byte > image = BuildNromImage( program );
+        Cartridge cartridge( image.data(), static_cast< u32 >( image.size() ), name );
+        Emulator directEmulator( &cartridge );
+        Emulator pipelineEmulator( &cartridge );
+
+        RenderPipeline renderPipeline( 3, Upscaler::Filter::Nearest, 1, RenderPipeline::PostProcess::None );
+        pipelineEmulator.GetVideo().SetRenderPipeline( &renderPipeline );
+
+        for ( u32 frame = 0; frame < frames; ++frame )
+        {
+            for ( Emulator *emulator : { &directEmulator, &pipelineEmulator } )
+            {
+                do
+                {
+                    emulator->StepInstruction();
+                }
+                while ( !emulator->IsFrameCompleted() );
+            }
+
+            const Video &directVideo = directEmulator.GetVideo();
+            const Video &pipelineVideo = pipelineEmulator.GetVideo();
+            const u64 directHash = directVideo.GetFrameHash();
+            const u64 pipelineHash = pipelineVideo.GetFrameHash();
+            const bool isFrameEqual = memcmp( directVideo.GetFrameBuffer(), renderPipeline.GetFrame(), Video::NES_VIDEO_RESOLUTION * sizeof( RGB ) ) == 0;
+            if ( directHash != pipelineHash || !isFrameEqual )
+            {
+                printf( "%-22s frame %u: direct %016llX, pipeline %016llX%s\n", name, frame, directHash, pipelineHash, isFrameEqual ? "" : ", RGB frames differ" );
+                return false;
+            }
+        }
+
+        printf( "%-22s %u frames identical\n", name, frames );
+        return true;
+    }
+
+    /* Decodes every frame as a composite signal on the emulation thread, the goal is 60 frames per second on one core */
+    ScenarioResult RunNtscFilterScenario( const char *name, const std::vector< byte > &program, u32 frames )
+    {
+        NtscFilter ntscFilter;
+        Video *attachedVideo = nullptr;
+        const auto attachHook = [ & ]( Emulator &emulator )
+        {
+            if ( attachedVideo != &emulator.GetVideo() )
+            {
+                attachedVideo = &emulator.GetVideo();
+                attachedVideo->SetNtscFilter( &ntscFilter );
+            }
+        };
+
+        return RunScenario( name, program, frames, attachHook );
+    }
+
+    r64 MeasureMemoryReadNanoseconds()
+    {
+        const std::vector< byte > image = BuildNromImage( CPU_LOOP_PROGRAM );
+        Cartridge cartridge( image.data(), static_cast< u32 >( image.size() ), "memory-read" );
+        Emulator emulator( &cartridge );
+        Memory &memory = emulator.GetMemory();
+
+        /* Alternate RAM and PRG ROM reads, the regions a CPU reads the most */
+        static constexpr u32 READS = 50'000'000;
+        u32 checksum = 0;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for ( u32 i = 0; i < READS; ++i )
+        {
+            const word address = ( i & 1 ) ? static_cast< word >( 0x8000 | ( ( i * 7919 ) & 0x7FFF ) ) : static_cast< word >( ( i * 31 ) & 0x07FF );
+            checksum += memory.Read( address );
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        /* Keep the reads observable so they are not optimized away */
+        volatile u32 sink = checksum;
+        ( void ) sink;
+
+        return std::chrono::duration< r64, std::nano >( end - start ).count() / READS;
+    }
+
+    u64 GetPeakResidentSetKB()
+    {
+        struct rusage usage;
+        getrusage( RUSAGE_SELF, &usage );
+        return static_cast< u64 >( usage.ru_maxrss );
+    }
+
+    void WriteJson( FILE *file, const char *label, const std::vector< ScenarioResult > &results, r64 memoryReadNanoseconds, u64 peakResidentSetKB )
+    {
+        fprintf( file, "{\n" );
+        fprintf( file, "  \"label\": \"%s\",\n", label );
+        fprintf( file, "  \"memoryReadNs\": %.3f,\n", memoryReadNanoseconds );
+        fprintf( file, "  \"peakRssKB\": %llu,\n", peakResidentSetKB );
+        fprintf( file, "  \"scenarios\": [\n" );
+        for ( size_t i = 0; i < results.size(); ++i )
+        {
+            const ScenarioResult &result = results[ i ];
+            fprintf( file, "    { \"name\": \"%s\", \"instructions\": %llu, \"frames\": %llu, \"seconds\": %.6f, \"instructionsPerSecond\": %.1f, \"framesPerSecond\": %.2f }%s\n",
+                result.name.c_str(), result.instructions, result.frames, result.seconds,
+                result.GetInstructionsPerSecond(), result.GetFramesPerSecond(), ( i + 1 < results.size() ) ? "," : "" );
+        }
+        fprintf( file, "  ]\n}\n" );
+    }
+
+    bool FindBaselineFramesPerSecond( const char *baselineFileName, const std::string &name, r64 &framesPerSecond )
+    {
+        std::ifstream baseline( baselineFileName );
+        const std::string key = "\"name\": \"" + name + "\"";
+        std::string line;
+        while ( std::getline( baseline, line ) )
+        {
+            const size_t value = line.find( "\"framesPerSecond\": " );
+            if ( line.find( key ) != std::string::npos && value != std::string::npos )
+            {
+                return sscanf( &line[ value ], "\"framesPerSecond\": %lf", &framesPerSecond ) == 1;
+            }
+        }
+        return false;
+    }
+}
+
+
+int main( int argc, char** argv )
+{
+    u32 frames = 600;
+    const char *label = "unnamed";
+    const char *jsonFileName = nullptr;
+    const char *baselineFileName = nullptr;
+    r64 maxRegressionPercent = 5.0;
+    bool isPipelineCheck = false;
+
+    for ( i32 i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--frames" ) == 0 && i + 1 < argc )                 { frames = std::stoul( argv[ ++i ] ); }
+        else if ( strcmp( argv[ i ], "--label" ) == 0 && i + 1 < argc )             { label = argv[ ++i ]; }
+        else if ( strcmp( argv[ i ], "--json" ) == 0 && i + 1 < argc )              { jsonFileName = argv[ ++i ]; }
+        else if ( strcmp( argv[ i ], "--compare" ) == 0 && i + 1 < argc )           { baselineFileName = argv[ ++i ]; }
+        else if ( strcmp( argv[ i ], "--max-regression" ) == 0 && i + 1 < argc )    { maxRegressionPercent = std::stod( argv[ ++i ] ); }
+        else if ( strcmp( argv[ i ], "--check-pipeline" ) == 0 )                    { isPipelineCheck = true; }
+        else
+        {
+            std::cout << "Usage: patnes-bench [--frames <n>] [--label <name>] [--json <file>] [--compare <file>] [--max-regression <percent>] [--check-pipeline]";
+            return -1;
+        }
+    }
+
+    if ( isPipelineCheck )
+    {
+        bool isIdentical = CheckRenderPipeline( "ppu-scroll", PPU_SCROLL_PROGRAM, frames );
+        isIdentical = CheckRenderPipeline( "full-frame", FULL_FRAME_PROGRAM, frames ) && isIdentical;
+        isIdentical = CheckRenderPipeline( "tiles", TILES_PROGRAM, frames ) && isIdentical;
+        return isIdentical ? 0 : 1;
+    }
+
+    const auto noHook = []( Emulator & ) {};
+
+    /* Same per instruction work Debugger::Update does while running, without the rendering */
+    /* The conditional breakpoint is on the hottest instruction of the program and never true */
+    CpuDebugger cpuDebugger;
+    MemoryDebugger memoryDebugger;
+    DebuggerMode mode = DebuggerMode::RUNNING;
+    std::string breakpointError;
+    if ( !cpuDebugger.TryAddBreakpoint( 0xC002, "x == $80 && [$0300] == $FF", false, breakpointError ) )
+    {
+        std::cout << "The benchmark breakpoint doesn't compile: " << breakpointError;
+        return -1;
+    }
+    const auto debuggerHook = [ & ]( Emulator &emulator )
+    {
+        memoryDebugger.UpdateWatcher( &emulator.GetMemory(), mode );
+        if ( cpuDebugger.ShouldBreak( emulator.GetCpu(), emulator.GetMemory(), emulator.GetVideo() ) )
+        {
+            mode = DebuggerMode::BREAKPOINT;
+        }
+    };
+
+    /* Drains the samples once per frame like an audio device would */
+    i16 samples[ 2048 ];
+    const auto audioHook = [ & ]( Emulator &emulator )
+    {
+        if ( emulator.IsFrameCompleted() )
+        {
+            emulator.GetAudio().ReadSamples( samples, 2048 );
+        }
+    };
+
+    std::vector< ScenarioResult > results;
+    results.push_back( RunScenario( "cpu-loop", CPU_LOOP_PROGRAM, frames, noHook ) );
+    results.push_back( RunScenario( "ppu-scroll", PPU_SCROLL_PROGRAM, frames, noHook ) );
+    results.push_back( RunScenario( "bank-switch", BANK_SWITCH_PROGRAM, frames, noHook ) );
+    results.push_back( RunScenario( "audio", AUDIO_PROGRAM, frames, audioHook ) );
+    results.push_back( RunScenario( "full-frame", FULL_FRAME_PROGRAM, frames, noHook ) );
+    results.push_back( RunScenario( "full-frame-debugger", FULL_FRAME_PROGRAM, frames, debuggerHook ) );
+    results.push_back( RunRenderPipelineScenario( "full-frame-4x", FULL_FRAME_PROGRAM, frames, std::thread::hardware_concurrency(), Upscaler::Filter::Nearest, 4 ) );
+
+    /* Upscalers on two cores, the goal is xBR 4x at 60 frames per second */
+    results.push_back( RunRenderPipelineScenario( "tiles-nearest-4x", TILES_PROGRAM, frames, 2, Upscaler::Filter::Nearest, 4 ) );
+    results.push_back( RunRenderPipelineScenario( "tiles-scale2x", TILES_PROGRAM, frames, 2, Upscaler::Filter::Scale2x, 2 ) );
+    results.push_back( RunRenderPipelineScenario( "tiles-scale3x", TILES_PROGRAM, frames, 2, Upscaler::Filter::Scale3x, 3 ) );
+    results.push_back( RunRenderPipelineScenario( "tiles-hqx-4x", TILES_PROGRAM, frames, 2, Upscaler::Filter::Hqx, 4 ) );
+    results.push_back( RunRenderPipelineScenario( "tiles-xbr-4x", TILES_PROGRAM, frames, 2, Upscaler::Filter::Xbr, 4 ) );
+    results.push_back( RunNtscFilterScenario( "tiles-ntsc", TILES_PROGRAM, frames ) );
+
+    const r64 memoryReadNanoseconds = MeasureMemoryReadNanoseconds();
+    const u64 peakResidentSetKB = GetPeakResidentSetKB();
+
+    bool hasRegressed = false;
+    printf( "%-22s %14s %12s %10s\n", "scenario", "instr/s", "frames/s", "vs base" );
+    for ( const ScenarioResult &result : results )
+    {
+        char comparison[ 32 ] = "";
+        r64 baselineFramesPerSecond;
+        if ( baselineFileName != nullptr && FindBaselineFramesPerSecond( baselineFileName, result.name, baselineFramesPerSecond ) )
+        {
+            const r64 change = ( result.GetFramesPerSecond() / baselineFramesPerSecond - 1.0 ) * 100.0;
+            snprintf( comparison, sizeof( comparison ), "%+.1f%%", change );
+            hasRegressed = hasRegressed || change < -maxRegressionPercent;
+        }
+        printf( "%-22s %14.0f %12.1f %10s\n", result.name.c_str(), result.GetInstructionsPerSecond(), result.GetFramesPerSecond(), comparison );
+    }
+    printf( "Memory::Read: %.2f ns\nPeak RSS: %llu KB\n", memoryReadNanoseconds, peakResidentSetKB );
+
+    if ( jsonFileName != nullptr )
+    {
+        FILE *jsonFile = fopen( jsonFileName, "w" );
+        if ( jsonFile == nullptr )
+        {
+            std::cout << "The results couldn't be written to " << jsonFileName;
+            return -1;
+        }
+        WriteJson( jsonFile, label, results, memoryReadNanoseconds, peakResidentSetKB );
+        fclose( jsonFile );
+    }
+
+    if ( hasRegressed )
+    {
+        printf( "At least one scenario regressed more than %.1f%%\n", maxRegressionPercent );
+        return 1;
+    }
+
+    return 0;
+}
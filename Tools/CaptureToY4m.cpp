@@ -0,0 +1,24 @@
+#include <iostream>
+
+#include "../FrameRecorder.h"
+
+
+/* Converts a delta capture written by PatNes --capture into a Y4m stream and optionally a WAV file, for ffmpeg */
+
+int main( int argc, char** argv )
+{
+    if ( argc < 3 )
+    {
+        std::cout << "Usage: CaptureToY4m <delta capture file> <output y4m file> [output wav file]";
+        return -1;
+    }
+
+    const char *wavFileName = ( argc > 3 ) ? argv[ 3 ] : nullptr;
+    if ( !FrameRecorder::ConvertToY4m( argv[ 1 ], argv[ 2 ], wavFileName ) )
+    {
+        std::cout << "The capture " << argv[ 1 ] << " couldn't be converted";
+        return -1;
+    }
+
+    return 0;
+}
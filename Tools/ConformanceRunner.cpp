@@ -0,0 +1,496 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../Cartridge.h"
+#include "../CpuTypes.h"
+#include "../Emulator.h"
+#include "../InstructionTracer.h"
+
+
+/*
+    Headless conformance harness.
+
+    nestest:    runs nestest.nes in automation mode ( PC = 0xC000 ) and compares the CPU state
+                before every instruction with the golden nestest.log, stopping at the first
+                divergence. A divergence at line N is blamed on the instruction of line N - 1,
+                every instruction whose result matched counts as a pass for its opcode.
+
+    blargg:     runs the test ROMs until they report a result through the 0x6000 protocol:
+                0x6001-0x6003 hold DE B0 61 once the test is running, 0x6000 is 0x80 while
+                running, 0x81 when it wants a reset and the final result code otherwise,
+                0x6004 holds the zero terminated text output.
+
+    Usage: ConformanceRunner [--json <file>] [--ignore-cycles] [--compare-ppu] [--max-frames <n>]
+                             [--nestest <nestest.nes> <nestest.log>] [--blargg <rom>...]
+ */
+
+namespace
+{
+    struct Options
+    {
+        const char  *jsonFileName   = nullptr;
+        bool        compareCycles   = true;
+        bool        comparePpu      = false;
+        u32         maxFrames       = 60 * 60;
+    };
+
+    struct NestestLine
+    {
+        word    pc;
+        byte    opcode;
+        byte    accumulator;
+        byte    xRegister;
+        byte    yRegister;
+        byte    pRegister;
+        byte    stackPointer;
+        u32     scanline;
+        u32     dot;
+        u64     cycle;
+        bool    hasPpu;
+        bool    hasCycle;
+    };
+
+    struct OpcodeResult
+    {
+        u32     verified    = 0;
+        bool    failed      = false;
+    };
+
+    struct RomResult
+    {
+        std::string                     rom;
+        std::string                     mode;
+        bool                            passed = false;
+        std::string                     message;
+
+        /* nestest */
+        u32                             linesMatched = 0;
+        u32                             linesTotal = 0;
+        std::string                     expectedLine;
+        std::string                     actualLine;
+        std::map< byte, OpcodeResult >  opcodes;
+
+        /* blargg */
+        i32                             statusCode = -1;
+        u32                             frames = 0;
+
+        /* Hash of the last frame, the tests that only report on screen can be compared against a known good run */
+        u64                             frameHash = 0;
+        std::string                     output;
+    };
+
+    bool ParseNestestLine( const std::string &line, NestestLine &parsed )
+    {
+        u32 pc, opcode;
+        if ( sscanf( line.c_str(), "%4X %2X", &pc, &opcode ) != 2 )
+        {
+            return false;
+        }
+        parsed.pc = static_cast< word >( pc );
+        parsed.opcode = static_cast< byte >( opcode );
+
+        const size_t registers = line.find( "A:" );
+        u32 a, x, y, p, sp;
+        if ( registers == std::string::npos || sscanf( &line[ registers ], "A:%2X X:%2X Y:%2X P:%2X SP:%2X", &a, &x, &y, &p, &sp ) != 5 )
+        {
+            return false;
+        }
+        parsed.accumulator = static_cast< byte >( a );
+        parsed.xRegister = static_cast< byte >( x );
+        parsed.yRegister = static_cast< byte >( y );
+        parsed.pRegister = static_cast< byte >( p );
+        parsed.stackPointer = static_cast< byte >( sp );
+
+        const size_t ppu = line.find( "PPU:" );
+        parsed.hasPpu = ppu != std::string::npos && sscanf( &line[ ppu ], "PPU:%u,%u", &parsed.scanline, &parsed.dot ) == 2;
+
+        const size_t cycle = line.find( "CYC:" );
+        parsed.hasCycle = cycle != std::string::npos && sscanf( &line[ cycle ], "CYC:%llu", &parsed.cycle ) == 1;
+
+        return true;
+    }
+
+    const char* FindMismatch( const NestestLine &expected, const TraceEntry &actual, const Options &options )
+    {
+        if ( expected.pc != actual.pc )                     return "PC";
+        if ( expected.opcode != actual.opcode )             return "opcode";
+        if ( expected.accumulator != actual.accumulator )   return "A";
+        if ( expected.xRegister != actual.xRegister )       return "X";
+        if ( expected.yRegister != actual.yRegister )       return "Y";
+        if ( expected.pRegister != actual.pRegister )       return "P";
+        if ( expected.stackPointer != actual.stackPointer ) return "SP";
+
+        if ( options.compareCycles && expected.hasCycle && expected.cycle != actual.cycle )
+        {
+            return "CYC";
+        }
+
+        if ( options.comparePpu && expected.hasPpu && ( expected.scanline != actual.scanline || expected.dot != actual.dot ) )
+        {
+            return "PPU";
+        }
+
+        return nullptr;
+    }
+
+    RomResult RunNestest( const char *romFileName, const char *logFileName, const Options &options )
+    {
+        RomResult result;
+        result.rom = romFileName;
+        result.mode = "nestest";
+
+        std::vector< std::string > goldenLines;
+        {
+            std::ifstream logFile( logFileName );
+            std::string line;
+            while ( std::getline( logFile, line ) )
+            {
+                if ( !line.empty() && line.back() == '\r' )
+                {
+                    line.pop_back();
+                }
+                goldenLines.push_back( line );
+            }
+        }
+        result.linesTotal = static_cast< u32 >( goldenLines.size() );
+
+        if ( goldenLines.empty() )
+        {
+            result.message = "The golden log couldn't be read";
+            return result;
+        }
+
+        Cartridge cartridge( romFileName );
+        if ( !cartridge.IsLoaded() || !Memory::IsCartridgeSupported( cartridge ) )
+        {
+            result.message = cartridge.IsLoaded() ? "Unsupported cartridge" : "The ROM couldn't be loaded";
+            return result;
+        }
+
+        Emulator emulator( &cartridge );
+        InstructionTracer tracer( 1, &emulator.GetVideo() );
+        emulator.SetTracer( &tracer );
+
+        /* Automation mode starts at 0xC000 with the state nestest.log was recorded with */
+        emulator.GetCpu().SetPC( 0xC000 );
+        emulator.GetCpu().ClearFlag( Cpu::Flags::Break );
+
+        byte previousOpcode = 0x00;
+        for ( u32 lineNumber = 0; lineNumber < goldenLines.size(); ++lineNumber )
+        {
+            NestestLine expected;
+            if ( !ParseNestestLine( goldenLines[ lineNumber ], expected ) )
+            {
+                result.message = "Line " + std::to_string( lineNumber + 1 ) + " of the golden log couldn't be parsed";
+                return result;
+            }
+
+            std::string exception;
+            try
+            {
+                emulator.StepInstruction();
+            }
+            catch ( const std::exception &e )
+            {
+                exception = e.what();
+            }
+
+            const TraceEntry &actual = tracer.GetEntry( tracer.GetEntryCount() - 1 );
+            const char *mismatch = FindMismatch( expected, actual, options );
+            if ( mismatch != nullptr || !exception.empty() )
+            {
+                char actualLine[ 128 ];
+                InstructionTracer::FormatNestestLine( actual, actualLine, sizeof( actualLine ) );
+                result.expectedLine = goldenLines[ lineNumber ];
+                result.actualLine = actualLine;
+
+                if ( mismatch != nullptr )
+                {
+                    /* The state before this line is wrong, so the previous instruction produced it */
+                    result.message = std::string( "Divergence in " ) + mismatch + " at line " + std::to_string( lineNumber + 1 );
+                    if ( lineNumber > 0 )
+                    {
+                        result.opcodes[ previousOpcode ].failed = true;
+                    }
+                }
+                else
+                {
+                    result.message = "Exception executing line " + std::to_string( lineNumber + 1 ) + ": " + exception;
+                    result.opcodes[ expected.opcode ].failed = true;
+                }
+                return result;
+            }
+
+            if ( lineNumber > 0 )
+            {
+                ++result.opcodes[ previousOpcode ].verified;
+            }
+            previousOpcode = expected.opcode;
+            ++result.linesMatched;
+        }
+
+        /* nestest leaves its own error codes for official and unofficial opcodes in 0x02 and 0x03 */
+        const byte officialResult = emulator.GetMemory().Peek( 0x0002 );
+        const byte unofficialResult = emulator.GetMemory().Peek( 0x0003 );
+        char message[ 64 ];
+        snprintf( message, sizeof( message ), "Result codes 0x02 = 0x%02X, 0x03 = 0x%02X", officialResult, unofficialResult );
+        result.message = message;
+        result.passed = true;
+
+        return result;
+    }
+
+    RomResult RunBlargg( const char *romFileName, const Options &options )
+    {
+        static constexpr word RESULT_STATUS_ADDRESS = 0x6000;
+        static constexpr word RESULT_TEXT_ADDRESS = 0x6004;
+        static constexpr byte STATUS_RUNNING = 0x80;
+        static constexpr byte STATUS_RESET_REQUESTED = 0x81;
+        static constexpr u32 RESET_DELAY_FRAMES = 6;
+
+        RomResult result;
+        result.rom = romFileName;
+        result.mode = "blargg";
+
+        Cartridge cartridge( romFileName );
+        if ( !cartridge.IsLoaded() || !Memory::IsCartridgeSupported( cartridge ) )
+        {
+            result.message = cartridge.IsLoaded() ? "Unsupported cartridge" : "The ROM couldn't be loaded";
+            return result;
+        }
+
+        Emulator emulator( &cartridge );
+        const Memory &memory = emulator.GetMemory();
+
+        u32 resetFrame = 0;
+        bool finished = false;
+        try
+        {
+            for ( result.frames = 0; result.frames < options.maxFrames && !finished; ++result.frames )
+            {
+                emulator.RunFrame();
+
+                const bool hasSignature = memory.Peek( 0x6001 ) == 0xDE && memory.Peek( 0x6002 ) == 0xB0 && memory.Peek( 0x6003 ) == 0x61;
+                if ( !hasSignature )
+                {
+                    continue;
+                }
+
+                const byte status = memory.Peek( RESULT_STATUS_ADDRESS );
+                if ( status == STATUS_RESET_REQUESTED )
+                {
+                    /* The test wants the reset button pressed, which keeps the RAM contents */
+                    if ( resetFrame == 0 )
+                    {
+                        resetFrame = result.frames + RESET_DELAY_FRAMES;
+                    }
+                    else if ( result.frames >= resetFrame )
+                    {
+                        emulator.SoftReset();
+                        resetFrame = 0;
+                    }
+                }
+                else if ( status != STATUS_RUNNING )
+                {
+                    result.statusCode = status;
+                    finished = true;
+                }
+            }
+        }
+        catch ( const std::exception &e )
+        {
+            result.message = std::string( "Exception: " ) + e.what();
+        }
+
+        result.frameHash = emulator.GetVideo().GetFrameHash();
+
+        for ( word address = RESULT_TEXT_ADDRESS; address < 0x8000 && memory.Peek( address ) != 0x00; ++address )
+        {
+            result.output += static_cast< char >( memory.Peek( address ) );
+        }
+
+        if ( finished )
+        {
+            result.passed = result.statusCode == 0;
+        }
+        else if ( result.message.empty() )
+        {
+            result.message = "Timed out after " + std::to_string( result.frames ) + " frames";
+        }
+
+        return result;
+    }
+
+    std::string EscapeJson( const std::string &text )
+    {
+        std::string escaped;
+        for ( const char c : text )
+        {
+            switch ( c )
+            {
+                case '"':   escaped += "\\\""; break;
+                case '\\':  escaped += "\\\\"; break;
+                case '\n':  escaped += "\\n"; break;
+                case '\r':  escaped += "\\r"; break;
+                case '\t':  escaped += "\\t"; break;
+                default:
+                {
+                    if ( static_cast< byte >( c ) < 0x20 )
+                    {
+                        char code[ 8 ];
+                        snprintf( code, sizeof( code ), "\\u%04X", c );
+                        escaped += code;
+                    }
+                    else
+                    {
+                        escaped += c;
+                    }
+                }
+            }
+        }
+        return escaped;
+    }
+
+    void WriteJson( FILE *file, const std::vector< RomResult > &results )
+    {
+        bool allPassed = true;
+        for ( const RomResult &result : results )
+        {
+            allPassed = allPassed && result.passed;
+        }
+
+        fprintf( file, "{\n  \"passed\": %s,\n  \"results\": [\n", allPassed ? "true" : "false" );
+        for ( size_t i = 0; i < results.size(); ++i )
+        {
+            const RomResult &result = results[ i ];
+            fprintf( file, "    {\n" );
+            fprintf( file, "      \"rom\": \"%s\",\n", EscapeJson( result.rom ).c_str() );
+            fprintf( file, "      \"mode\": \"%s\",\n", result.mode.c_str() );
+            fprintf( file, "      \"passed\": %s,\n", result.passed ? "true" : "false" );
+            fprintf( file, "      \"message\": \"%s\",\n", EscapeJson( result.message ).c_str() );
+
+            if ( result.mode == "nestest" )
+            {
+                fprintf( file, "      \"linesMatched\": %u,\n", result.linesMatched );
+                fprintf( file, "      \"linesTotal\": %u,\n", result.linesTotal );
+                fprintf( file, "      \"expected\": \"%s\",\n", EscapeJson( result.expectedLine ).c_str() );
+                fprintf( file, "      \"actual\": \"%s\",\n", EscapeJson( result.actualLine ).c_str() );
+                fprintf( file, "      \"opcodes\": {" );
+
+                /* Every documented opcode is reported, the ones nestest never verified as untested */
+                bool first = true;
+                for ( u32 opcode = 0x00; opcode <= 0xFF; ++opcode )
+                {
+                    std::unordered_map< byte, OpcodeInfo >::const_iterator info = NES_OPCODE_INFO.find( static_cast< byte >( opcode ) );
+                    std::map< byte, OpcodeResult >::const_iterator tested = result.opcodes.find( static_cast< byte >( opcode ) );
+                    if ( info == NES_OPCODE_INFO.end() && tested == result.opcodes.end() )
+                    {
+                        continue;
+                    }
+
+                    const char *mnemonic = ( info != NES_OPCODE_INFO.end() ) ? info->second.mnemonic : "???";
+                    const char *status = "untested";
+                    u32 verified = 0;
+                    if ( tested != result.opcodes.end() )
+                    {
+                        verified = tested->second.verified;
+                        status = tested->second.failed ? "fail" : ( verified > 0 ? "pass" : "untested" );
+                    }
+
+                    fprintf( file, "%s\n        \"%02X\": { \"mnemonic\": \"%s\", \"status\": \"%s\", \"verified\": %u }", first ? "" : ",", opcode, mnemonic, status, verified );
+                    first = false;
+                }
+                fprintf( file, "\n      }\n" );
+            }
+            else
+            {
+                fprintf( file, "      \"statusCode\": %d,\n", result.statusCode );
+                fprintf( file, "      \"frames\": %u,\n", result.frames );
+                fprintf( file, "      \"frameHash\": \"%016llx\",\n", static_cast< unsigned long long >( result.frameHash ) );
+                fprintf( file, "      \"output\": \"%s\"\n", EscapeJson( result.output ).c_str() );
+            }
+
+            fprintf( file, "    }%s\n", ( i + 1 < results.size() ) ? "," : "" );
+        }
+        fprintf( file, "  ]\n}\n" );
+    }
+}
+
+
+int main( int argc, char** argv )
+{
+    Options options;
+    std::vector< RomResult > results;
+
+    for ( i32 i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--json" ) == 0 && i + 1 < argc )
+        {
+            options.jsonFileName = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--ignore-cycles" ) == 0 )
+        {
+            options.compareCycles = false;
+        }
+        else if ( strcmp( argv[ i ], "--compare-ppu" ) == 0 )
+        {
+            options.comparePpu = true;
+        }
+        else if ( strcmp( argv[ i ], "--max-frames" ) == 0 && i + 1 < argc )
+        {
+            options.maxFrames = std::stoul( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--nestest" ) == 0 && i + 2 < argc )
+        {
+            results.push_back( RunNestest( argv[ i + 1 ], argv[ i + 2 ], options ) );
+            i += 2;
+        }
+        else if ( strcmp( argv[ i ], "--blargg" ) == 0 )
+        {
+            while ( i + 1 < argc && strncmp( argv[ i + 1 ], "--", 2 ) != 0 )
+            {
+                results.push_back( RunBlargg( argv[ ++i ], options ) );
+            }
+        }
+        else
+        {
+            std::cout << "Usage: ConformanceRunner [--json <file>] [--ignore-cycles] [--compare-ppu] [--max-frames <n>] "
+                << "[--nestest <nestest.nes> <nestest.log>] [--blargg <rom>...]";
+            return -1;
+        }
+    }
+
+    bool allPassed = !results.empty();
+    for ( const RomResult &result : results )
+    {
+        allPassed = allPassed && result.passed;
+        std::cout << ( result.passed ? "PASS " : "FAIL " ) << result.rom << ": " << result.message << "\n";
+        if ( !result.output.empty() )
+        {
+            std::cout << result.output << "\n";
+        }
+        if ( !result.expectedLine.empty() )
+        {
+            std::cout << "  expected: " << result.expectedLine << "\n  actual:   " << result.actualLine << "\n";
+        }
+    }
+
+    if ( options.jsonFileName != nullptr )
+    {
+        FILE *jsonFile = fopen( options.jsonFileName, "w" );
+        if ( jsonFile == nullptr )
+        {
+            std::cout << "The results couldn't be written to " << options.jsonFileName;
+            return -1;
+        }
+        WriteJson( jsonFile, results );
+        fclose( jsonFile );
+    }
+
+    return allPassed ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+Generates RomDatabaseEntries.h from an NES 2.0 XML database ( nes20db.xml format ):
+
+    <game>
+        <rom size="40976" crc32="..."/>
+        <pcb mapper="0" submapper="0" mirroring="V" battery="0"/>
+        <prgram size="8192"/> <prgnvram .../> <chrram .../> <chrnvram .../>
+        <console type="0" region="0"/>
+    </game>
+
+The key is the CRC-32 of the PRG and CHR ROM ( the rom element ), like Cartridge computes it.
+Entries are sorted by CRC and duplicated CRCs keep their first game, the C++ side checks the
+order at compile time.
+
+Usage: GenerateRomDatabase.py <nes20db.xml> [output header, RomDatabaseEntries.h by default]
+"""
+
+import os
+import sys
+import xml.etree.ElementTree as ElementTree
+
+MIRRORING = {
+    "H": "Horizontal",
+    "V": "Vertical",
+    "4": "FourScreen",
+    "1": "SingleScreenLower",
+}
+
+TIMING = {
+    0: "Ntsc",
+    1: "Pal",
+    2: "MultiRegion",
+    3: "Dendy",
+}
+
+
+def get_size( game, tag ):
+    element = game.find( tag )
+    return int( element.get( "size", "0" ) ) if element is not None else 0
+
+
+def parse_games( file_name ):
+    entries = {}
+    skipped = 0
+    for game in ElementTree.parse( file_name ).getroot().iter( "game" ):
+        rom = game.find( "rom" )
+        pcb = game.find( "pcb" )
+        if rom is None or pcb is None or rom.get( "crc32" ) is None:
+            skipped += 1
+            continue
+
+        crc32 = int( rom.get( "crc32" ), 16 )
+        if crc32 in entries:
+            skipped += 1
+            continue
+
+        console = game.find( "console" )
+        region = int( console.get( "region", "0" ) ) if console is not None else 0
+        entries[ crc32 ] = (
+            int( pcb.get( "mapper", "0" ) ),
+            int( pcb.get( "submapper", "0" ) ),
+            MIRRORING.get( pcb.get( "mirroring", "H" ), "Horizontal" ),
+            pcb.get( "battery", "0" ) == "1",
+            TIMING.get( region, "Ntsc" ),
+            get_size( game, "prgram" ),
+            get_size( game, "prgnvram" ),
+            get_size( game, "chrram" ),
+            get_size( game, "chrnvram" ),
+        )
+    return entries, skipped
+
+
+def write_header( file_name, source_name, entries ):
+    lines = [
+        "#pragma once",
+        "",
+        "/*",
+        "    Generated by Tools/GenerateRomDatabase.py, do not edit.",
+        "    Source: %s" % os.path.basename( source_name ),
+        " */",
+        "",
+        "#include <array>",
+        "",
+        "#include \"RomDatabase.h\"",
+        "",
+        "",
+        "namespace romdatabase",
+        "{",
+    ]
+
+    if not entries:
+        lines.append( "    constexpr std::array< Entry, 0 > ENTRIES = {};" )
+    else:
+        lines.append( "    constexpr std::array< Entry, %d > ENTRIES =" % len( entries ) )
+        lines.append( "    {{" )
+        for crc32 in sorted( entries ):
+            mapper, submapper, mirroring, battery, timing, prg_ram, prg_nvram, chr_ram, chr_nvram = entries[ crc32 ]
+            lines.append( "        { 0x%08X, %d, %d, Cartridge::MirroringType::%s, %s, Cartridge::TimingRegion::%s, %d, %d, %d, %d },"
+                % ( crc32, mapper, submapper, mirroring, "true" if battery else "false", timing, prg_ram, prg_nvram, chr_ram, chr_nvram ) )
+        lines.append( "    }};" )
+
+    lines.append( "}" )
+
+    with open( file_name, "w", newline = "\n" ) as output:
+        output.write( "\n".join( lines ) + "\n" )
+
+
+def main():
+    if len( sys.argv ) < 2:
+        print( "Usage: GenerateRomDatabase.py <nes20db.xml> [output header]" )
+        return 1
+
+    output_name = sys.argv[ 2 ] if len( sys.argv ) > 2 else os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), "..", "RomDatabaseEntries.h" )
+    entries, skipped = parse_games( sys.argv[ 1 ] )
+    write_header( output_name, sys.argv[ 1 ], entries )
+    print( "%d entries written to %s, %d games skipped" % ( len( entries ), output_name, skipped ) )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit( main() )
@@ -0,0 +1,350 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "../Cartridge.h"
+#include "../Hash.h"
+#include "../Memory.h"
+#include "../RomArchive.h"
+#include "../RomIndex.h"
+
+
+/*
+    patnes-scan: builds the metadata index of a ROM library.
+
+    Walks the directory tree, opens every .nes, .zip and .gz file on a pool of threads and
+    writes one index entry per ROM with its header, its payload hashes and whether Memory can
+    map it. Files whose size and modification time match the previous index are not opened
+    again, their entries are copied over. --find looks a CRC-32 up in an existing index.
+
+    Usage: patnes-scan [--index <file>] [--threads <n>] [--full] <rom directory>
+           patnes-scan [--index <file>] --find <crc32>
+ */
+
+namespace
+{
+    struct RomFile
+    {
+        std::string     path;
+        u64             size;
+        i64             modificationTime;
+    };
+
+    struct ScannedRom
+    {
+        std::string     path;
+        std::string     entryName;
+        romindex::Entry entry;
+    };
+
+    bool IsRomFileName( const std::string &fileName )
+    {
+        std::string extension = std::filesystem::path( fileName ).extension().string();
+        std::transform( extension.begin(), extension.end(), extension.begin(), []( char c ) { return static_cast< char >( tolower( c ) ); } );
+        return extension == ".nes" || extension == ".zip" || extension == ".gz";
+    }
+
+    std::vector< RomFile > FindRomFiles( const std::string &directory )
+    {
+        std::vector< RomFile > files;
+        std::error_code error;
+        for ( std::filesystem::recursive_directory_iterator it( directory, std::filesystem::directory_options::skip_permission_denied, error ), end; it != end; it.increment( error ) )
+        {
+            struct stat fileStatus;
+            const std::string path = it->path().string();
+            if ( IsRomFileName( path ) && stat( path.c_str(), &fileStatus ) == 0 && S_ISREG( fileStatus.st_mode ) )
+            {
+                const i64 modificationTime = static_cast< i64 >( fileStatus.st_mtim.tv_sec ) * 1000000000 + fileStatus.st_mtim.tv_nsec;
+                files.push_back( { path, static_cast< u64 >( fileStatus.st_size ), modificationTime } );
+            }
+        }
+        return files;
+    }
+
+    romindex::Entry DescribeCartridge( const Cartridge &cartridge, const RomFile &file )
+    {
+        romindex::Entry entry;
+        memset( &entry, 0, sizeof( entry ) );
+        entry.fileSize = file.size;
+        entry.modificationTime = file.modificationTime;
+
+        if ( !cartridge.IsLoaded() )
+        {
+            return entry;
+        }
+
+        const Cartridge::Header &header = cartridge.GetHeader();
+        entry.flags = romindex::LOADED;
+        entry.flags |= Memory::IsCartridgeSupported( cartridge ) ? romindex::SUPPORTED : 0;
+        entry.flags |= header.isNes20 ? romindex::NES20 : 0;
+        entry.flags |= header.hasPersistentMemory ? romindex::BATTERY : 0;
+        entry.flags |= header.isFromDatabase ? romindex::FROM_DATABASE : 0;
+        entry.crc32 = header.crc32;
+        entry.prgRomSizeKB = header.prgRomSizeKB;
+        entry.chrRomSizeKB = header.chrRomSizeKB;
+        entry.mapper = header.mapper;
+        entry.submapper = header.submapper;
+        entry.mirroringType = static_cast< byte >( header.mirroringType );
+        entry.timingRegion = static_cast< byte >( header.timingRegion );
+
+        /* Same payload the CRC-32 of the header covers, the trainer is not part of the game */
+        const u64 payloadOffset = 16 + ( header.has512BTrainer ? 512 : 0 );
+        const u64 payloadSize = ( static_cast< u64 >( header.prgRomSizeKB ) + header.chrRomSizeKB ) * 1_KB;
+        const u64 availableSize = ( cartridge.GetRomSize() > payloadOffset ) ? cartridge.GetRomSize() - payloadOffset : 0;
+        entry.payloadHash = Hash64( &cartridge.GetRom()[ payloadOffset ], static_cast< size_t >( std::min( payloadSize, availableSize ) ), 0 );
+
+        return entry;
+    }
+
+    /* Every file gets at least one entry, even if it holds no ROM, so it is not opened again by the next scan */
+    void ScanFile( const RomFile &file, std::vector< ScannedRom > &roms )
+    {
+        const RomArchive archive( file.path.c_str() );
+        if ( !archive.IsOpen() )
+        {
+            const Cartridge cartridge( file.path.c_str() );
+            roms.push_back( { file.path, "", DescribeCartridge( cartridge, file ) } );
+            return;
+        }
+
+        bool hasRoms = false;
+        for ( u32 i = 0; i < archive.GetEntries().size(); ++i )
+        {
+            if ( archive.IsRomEntry( i ) )
+            {
+                const Cartridge cartridge( archive, i );
+                roms.push_back( { file.path, archive.GetEntries()[ i ].name, DescribeCartridge( cartridge, file ) } );
+                hasRoms = true;
+            }
+        }
+
+        if ( !hasRoms )
+        {
+            romindex::Entry entry;
+            memset( &entry, 0, sizeof( entry ) );
+            entry.fileSize = file.size;
+            entry.modificationTime = file.modificationTime;
+            roms.push_back( { file.path, "", entry } );
+        }
+    }
+
+    /* Copies the entries of an unchanged file from the previous index, false when the file has to be opened */
+    bool TryReuseEntries( const RomIndex &previousIndex, const RomFile &file, std::vector< ScannedRom > &roms )
+    {
+        u32 index = previousIndex.FindFirstOfPath( file.path.c_str() );
+        if ( index == previousIndex.GetEntryCount() )
+        {
+            return false;
+        }
+
+        const romindex::Entry &first = previousIndex.GetEntry( index );
+        if ( first.fileSize != file.size || first.modificationTime != file.modificationTime )
+        {
+            return false;
+        }
+
+        for ( ; index < previousIndex.GetEntryCount() && strcmp( previousIndex.GetString( previousIndex.GetEntry( index ).pathOffset ), file.path.c_str() ) == 0; ++index )
+        {
+            const romindex::Entry &entry = previousIndex.GetEntry( index );
+            roms.push_back( { file.path, previousIndex.GetString( entry.entryNameOffset ), entry } );
+        }
+        return true;
+    }
+
+    bool WriteIndex( const char *indexFileName, std::vector< ScannedRom > &roms )
+    {
+        /* Offset 0 is the empty string of the ROMs that are not in an archive */
+        std::string strings( 1, '\0' );
+        std::map< std::string, u32 > pathOffsets;
+        std::vector< romindex::Entry > entries;
+        entries.reserve( roms.size() );
+
+        for ( ScannedRom &rom : roms )
+        {
+            std::map< std::string, u32 >::iterator path = pathOffsets.find( rom.path );
+            if ( path == pathOffsets.end() )
+            {
+                path = pathOffsets.emplace( rom.path, static_cast< u32 >( strings.size() ) ).first;
+                strings.append( rom.path.c_str(), rom.path.size() + 1 );
+            }
+
+            rom.entry.pathOffset = path->second;
+            rom.entry.entryNameOffset = 0;
+            if ( !rom.entryName.empty() )
+            {
+                rom.entry.entryNameOffset = static_cast< u32 >( strings.size() );
+                strings.append( rom.entryName.c_str(), rom.entryName.size() + 1 );
+            }
+            entries.push_back( rom.entry );
+        }
+
+        return RomIndex::Write( indexFileName, entries, strings );
+    }
+
+    /* The whole text must be a number that fits in 32 bits */
+    bool TryParseNumber( const char *text, i32 base, u32 &value )
+    {
+        char *end = nullptr;
+        errno = 0;
+        const unsigned long long parsed = strtoull( text, &end, base );
+        if ( errno != 0 || end == text || *end != '\0' || parsed > 0xFFFFFFFF || !isxdigit( static_cast< unsigned char >( text[ 0 ] ) ) )
+        {
+            return false;
+        }
+
+        value = static_cast< u32 >( parsed );
+        return true;
+    }
+
+    void PrintEntry( const RomIndex &index, const romindex::Entry &entry )
+    {
+        printf( "%s%s%s\n", index.GetString( entry.pathOffset ), entry.entryNameOffset != 0 ? " : " : "", index.GetString( entry.entryNameOffset ) );
+        printf( "  crc32 %08X  xxh64 %016llX  mapper %u.%u  PRG %uKB  CHR %uKB  %s  %s%s%s%s\n",
+            entry.crc32, entry.payloadHash, entry.mapper, entry.submapper, entry.prgRomSizeKB, entry.chrRomSizeKB,
+            Cartridge::TimingRegionString[ entry.timingRegion % static_cast< byte >( Cartridge::TimingRegion::Count ) ],
+            ( entry.flags & romindex::SUPPORTED ) ? "supported" : "unsupported",
+            ( entry.flags & romindex::NES20 ) ? ", NES 2.0" : "",
+            ( entry.flags & romindex::BATTERY ) ? ", battery" : "",
+            ( entry.flags & romindex::FROM_DATABASE ) ? ", database header" : "" );
+    }
+}
+
+
+int main( int argc, char** argv )
+{
+    const char *indexFileName = "patnes.idx";
+    const char *directory = nullptr;
+    const char *crcToFind = nullptr;
+    u32 crc32 = 0;
+    u32 threadCount = std::max( 1u, std::thread::hardware_concurrency() );
+    bool isFullScan = false;
+
+    /* Any bad option or number falls through to the usage */
+    for ( i32 i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--index" ) == 0 && i + 1 < argc )           { indexFileName = argv[ ++i ]; }
+        else if ( strcmp( argv[ i ], "--threads" ) == 0 && i + 1 < argc && TryParseNumber( argv[ i + 1 ], 10, threadCount ) && threadCount > 0 ) { ++i; }
+        else if ( strcmp( argv[ i ], "--find" ) == 0 && i + 1 < argc && TryParseNumber( argv[ i + 1 ], 16, crc32 ) ) { crcToFind = argv[ ++i ]; }
+        else if ( strcmp( argv[ i ], "--full" ) == 0 )                       { isFullScan = true; }
+        else if ( argv[ i ][ 0 ] != '-' && directory == nullptr )             { directory = argv[ i ]; }
+        else
+        {
+            directory = nullptr;
+            crcToFind = nullptr;
+            break;
+        }
+    }
+
+    if ( crcToFind != nullptr )
+    {
+        const RomIndex index( indexFileName );
+        if ( !index.IsOpen() )
+        {
+            std::cout << "The index " << indexFileName << " couldn't be opened" << std::endl;
+            return -1;
+        }
+
+        const std::vector< const romindex::Entry* > matches = index.FindByCrc32( crc32 );
+        if ( matches.empty() )
+        {
+            std::cout << "No ROM with CRC-32 " << crcToFind << " in " << indexFileName << std::endl;
+            return 1;
+        }
+
+        for ( const romindex::Entry *match : matches )
+        {
+            PrintEntry( index, *match );
+        }
+        return 0;
+    }
+
+    if ( directory == nullptr )
+    {
+        std::cout << "Usage: patnes-scan [--index <file>] [--threads <n>] [--full] <rom directory>\n"
+                  << "       patnes-scan [--index <file>] --find <crc32>" << std::endl;
+        return -1;
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    /* Absolute paths, so the index matches no matter where the next scan is started from */
+    const std::vector< RomFile > files = FindRomFiles( std::filesystem::absolute( directory ).lexically_normal().string() );
+    const RomIndex previousIndex( isFullScan ? nullptr : indexFileName );
+
+    /* Files are handed out one at a time, ROM sizes vary too much for fixed slices */
+    std::atomic< size_t > nextFile( 0 );
+    std::atomic< u32 > reusedFiles( 0 );
+    std::vector< std::vector< ScannedRom > > threadRoms( threadCount );
+    std::vector< std::thread > workers;
+    for ( u32 t = 0; t < threadCount; ++t )
+    {
+        workers.emplace_back( [ &, t ]()
+        {
+            for ( size_t i = nextFile++; i < files.size(); i = nextFile++ )
+            {
+                if ( TryReuseEntries( previousIndex, files[ i ], threadRoms[ t ] ) )
+                {
+                    ++reusedFiles;
+                }
+                else
+                {
+                    ScanFile( files[ i ], threadRoms[ t ] );
+                }
+            }
+        } );
+    }
+    for ( std::thread &worker : workers )
+    {
+        worker.join();
+    }
+
+    std::vector< ScannedRom > roms;
+    for ( std::vector< ScannedRom > &threadResult : threadRoms )
+    {
+        std::move( threadResult.begin(), threadResult.end(), std::back_inserter( roms ) );
+    }
+
+    if ( !WriteIndex( indexFileName, roms ) )
+    {
+        std::cout << "The index " << indexFileName << " couldn't be written" << std::endl;
+        return -1;
+    }
+
+    /* Mapper census, the unsupported mappers with the most games are the next ones to implement */
+    u32 loadedRoms = 0;
+    u32 supportedRoms = 0;
+    std::map< u16, std::pair< u32, u32 > > mappers;
+    for ( const ScannedRom &rom : roms )
+    {
+        if ( rom.entry.flags & romindex::LOADED )
+        {
+            const bool isSupported = ( rom.entry.flags & romindex::SUPPORTED ) != 0;
+            ++loadedRoms;
+            supportedRoms += isSupported ? 1 : 0;
+            ++mappers[ rom.entry.mapper ].first;
+            mappers[ rom.entry.mapper ].second += isSupported ? 1 : 0;
+        }
+    }
+
+    const r64 seconds = std::chrono::duration< r64 >( std::chrono::steady_clock::now() - start ).count();
+    printf( "%zu files ( %u unchanged ) scanned in %.2fs on %u threads\n", files.size(), reusedFiles.load(), seconds, threadCount );
+    printf( "%u ROMs, %u supported, %zu entries without a ROM, index written to %s\n", loadedRoms, supportedRoms, roms.size() - loadedRoms, indexFileName );
+    for ( const std::pair< const u16, std::pair< u32, u32 > > &mapper : mappers )
+    {
+        printf( "  mapper %3u: %6u ROMs, %6u supported\n", mapper.first, mapper.second.first, mapper.second.second );
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "../SharedFrameRing.h"
+#include "../Video.h"
+
+
+/*
+    Publishes synthetic frames as fast as possible while a reader thread follows them through
+    the shared memory and checks every byte it reads. Reports the publish throughput and how
+    many frames the reader saw intact, torn or lost to the writer lapping it.
+ */
+
+int main( int argc, char** argv )
+{
+    const char *name = "/patnes_shared_frame_benchmark";
+    const u32 frames = ( argc > 1 ) ? std::stoul( argv[ 1 ] ) : 100'000;
+    const u32 slotCount = ( argc > 2 ) ? std::stoul( argv[ 2 ] ) : 8;
+    constexpr u32 RAM_SIZE = 2_KB;
+
+    SharedFramePublisher publisher( name, slotCount, Video::NES_VIDEO_WIDTH, Video::NES_VIDEO_HEIGHT, RAM_SIZE );
+    SharedFrameSubscriber subscriber( name );
+    if ( !publisher.IsOpen() || !subscriber.IsOpen() )
+    {
+        std::cout << "The shared memory couldn't be created";
+        return -1;
+    }
+
+    RGB *frameBuffer = new RGB[ Video::NES_VIDEO_RESOLUTION ];
+    byte *ram = new byte[ RAM_SIZE ];
+
+    std::atomic< bool > done( false );
+    u64 intactFrames = 0, tornFrames = 0, lostFrames = 0, corruptedFrames = 0;
+
+    std::thread reader( [ & ]()
+        {
+            u64 nextFrame = 0;
+            while ( !done.load( std::memory_order_relaxed ) || nextFrame < subscriber.GetPublishedFrames() )
+            {
+                if ( nextFrame >= subscriber.GetPublishedFrames() )
+                {
+                    continue;
+                }
+
+                bool isConsistent = true;
+                const bool isValid = subscriber.TryRead( nextFrame, [ & ]( const sharedframe::SharedFrameSlot &slot, const RGB *slotFrameBuffer, const byte *slotRam )
+                    {
+                        /* Every byte of frame N was filled with N */
+                        const byte expected = static_cast< byte >( slot.frameNumber );
+                        isConsistent = slotRam[ 0 ] == expected && slotRam[ RAM_SIZE - 1 ] == expected && slotFrameBuffer[ Video::NES_VIDEO_RESOLUTION - 1 ].blue == expected;
+                    }
+                );
+
+                const u64 publishedFrames = subscriber.GetPublishedFrames();
+                if ( !isValid && publishedFrames > nextFrame + slotCount )
+                {
+                    /* The writer lapped us, catch up with the oldest frame still in the ring */
+                    const u64 oldestFrame = publishedFrames - slotCount;
+                    lostFrames += oldestFrame - nextFrame;
+                    nextFrame = oldestFrame;
+                    continue;
+                }
+
+                if ( !isValid )
+                {
+                    ++tornFrames;
+                }
+                else
+                {
+                    isConsistent ? ++intactFrames : ++corruptedFrames;
+                }
+                ++nextFrame;
+            }
+        }
+    );
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    for ( u32 frame = 0; frame < frames; ++frame )
+    {
+        memset( frameBuffer, static_cast< byte >( frame ), Video::NES_VIDEO_RESOLUTION * sizeof( RGB ) );
+        memset( ram, static_cast< byte >( frame ), RAM_SIZE );
+        publisher.Publish( frameBuffer, ram );
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    done = true;
+    reader.join();
+
+    const double seconds = std::chrono::duration< double >( end - start ).count();
+    const double frameBytes = Video::NES_VIDEO_RESOLUTION * sizeof( RGB ) + RAM_SIZE;
+    printf( "Published %u frames in %.3f s: %.0f frames/s, %.2f GB/s\n", frames, seconds, frames / seconds, ( frames * frameBytes ) / seconds / 1e9 );
+    printf( "Reader: %llu intact, %llu torn, %llu lost, %llu corrupted\n", intactFrames, tornFrames, lostFrames, corruptedFrames );
+
+    delete[] frameBuffer;
+    delete[] ram;
+
+    return corruptedFrames == 0 ? 0 : -1;
+}
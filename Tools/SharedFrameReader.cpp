@@ -0,0 +1,61 @@
+#include <iostream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+
+#include "../SharedFrameRing.h"
+
+
+/*
+    Minimal consumer of the frames published with PatNes --shm <name>. It follows the latest
+    frame, reads it in place and prints the RAM byte at the requested address.
+ */
+
+int main( int argc, char** argv )
+{
+    if ( argc < 2 )
+    {
+        std::cout << "Usage: SharedFrameReader <shared memory name> [ram address]";
+        return -1;
+    }
+
+    SharedFrameSubscriber subscriber( argv[ 1 ] );
+    if ( !subscriber.IsOpen() )
+    {
+        std::cout << "The shared memory " << argv[ 1 ] << " couldn't be opened";
+        return -1;
+    }
+
+    const u32 ramAddress = ( argc > 2 ) ? std::stoul( argv[ 2 ], nullptr, 16 ) % subscriber.GetHeader()->ramSize : 0;
+
+    u64 nextFrame = subscriber.GetPublishedFrames();
+    while ( true )
+    {
+        const u64 publishedFrames = subscriber.GetPublishedFrames();
+        if ( publishedFrames <= nextFrame )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            continue;
+        }
+
+        /* Skip to the newest frame if we fell behind the writer */
+        const u64 frame = publishedFrames - 1;
+
+        byte ramValue = 0;
+        RGB firstPixel = {};
+        const bool isValid = subscriber.TryRead( frame, [ & ]( const sharedframe::SharedFrameSlot &, const RGB *frameBuffer, const byte *ram )
+            {
+                ramValue = ram[ ramAddress ];
+                firstPixel = frameBuffer[ 0 ];
+            }
+        );
+
+        if ( isValid )
+        {
+            printf( "frame %llu RAM[0x%03X] = 0x%02X pixel(0,0) = #%02X%02X%02X\n", frame, ramAddress, ramValue, firstPixel.red, firstPixel.green, firstPixel.blue );
+        }
+        nextFrame = frame + 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+#include <iostream>
+
+#include "../InstructionTracer.h"
+
+
+/* Converts a binary trace written by PatNes --trace into the nestest.log text format */
+
+int main( int argc, char** argv )
+{
+    if ( argc < 3 )
+    {
+        std::cout << "Usage: TraceToNestestLog <binary trace file> <output log file>";
+        return -1;
+    }
+
+    if ( !InstructionTracer::ConvertToNestestLog( argv[ 1 ], argv[ 2 ] ) )
+    {
+        std::cout << "The trace " << argv[ 1 ] << " couldn't be converted";
+        return -1;
+    }
+
+    return 0;
+}
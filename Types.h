@@ -43,6 +43,7 @@ struct RGB
 namespace color
 {
     constexpr RGB PINK = { 0xFF, 0x00, 0x80 };
+    constexpr RGB BLACK = { 0x00, 0x00, 0x00 };
 }
 
 /* Operators */
@@ -0,0 +1,553 @@
+#include "Upscaler.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdlib>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+    struct BlendEntry
+    {
+        byte    x;
+        byte    y;
+        u16     alpha;
+    };
+
+    struct BaseShape
+    {
+        u32         count;
+        BlendEntry  entries[ 8 ];
+    };
+
+    /*
+        Output pixels of the bottom right corner for every shape, by scale from 2 to 4. The xBR
+        shapes are the ones of the level 2 filter, the HQx alphas are scaled by the blend strength.
+     */
+    constexpr BaseShape BASE_SHAPES[ 3 ][ 7 ] =
+    {
+        {
+            { 3, { { 1, 1, 224 }, { 0, 1, 64 }, { 1, 0, 64 } } },                                      /* xBR left and up */
+            { 2, { { 1, 1, 192 }, { 0, 1, 64 } } },                                                     /* xBR left */
+            { 2, { { 1, 1, 192 }, { 1, 0, 64 } } },                                                     /* xBR up */
+            { 1, { { 1, 1, 128 } } },                                                                   /* xBR diagonal */
+            { 1, { { 1, 1, 64 } } },                                                                    /* xBR weak */
+            { 1, { { 1, 1, 256 } } },                                                                   /* HQx edge */
+            { 1, { { 1, 1, 256 } } },                                                                   /* HQx weak */
+        },
+        {
+            { 5, { { 1, 2, 192 }, { 2, 1, 192 }, { 0, 2, 64 }, { 2, 0, 64 }, { 2, 2, 256 } } },
+            { 4, { { 1, 2, 192 }, { 2, 1, 64 }, { 0, 2, 64 }, { 2, 2, 256 } } },
+            { 4, { { 2, 1, 192 }, { 1, 2, 64 }, { 2, 0, 64 }, { 2, 2, 256 } } },
+            { 3, { { 2, 2, 224 }, { 2, 1, 32 }, { 1, 2, 32 } } },
+            { 1, { { 2, 2, 128 } } },
+            { 3, { { 2, 2, 256 }, { 1, 2, 128 }, { 2, 1, 128 } } },
+            { 1, { { 2, 2, 256 } } },
+        },
+        {
+            { 8, { { 1, 3, 192 }, { 3, 1, 192 }, { 0, 3, 64 }, { 3, 0, 64 }, { 2, 2, 64 }, { 3, 3, 256 }, { 2, 3, 256 }, { 3, 2, 256 } } },
+            { 6, { { 3, 2, 192 }, { 1, 3, 192 }, { 2, 2, 64 }, { 0, 3, 64 }, { 2, 3, 256 }, { 3, 3, 256 } } },
+            { 6, { { 2, 3, 192 }, { 3, 1, 192 }, { 2, 2, 64 }, { 3, 0, 64 }, { 3, 2, 256 }, { 3, 3, 256 } } },
+            { 3, { { 3, 2, 128 }, { 2, 3, 128 }, { 3, 3, 256 } } },
+            { 1, { { 3, 3, 128 } } },
+            { 4, { { 3, 3, 256 }, { 2, 3, 128 }, { 3, 2, 128 }, { 2, 2, 64 } } },
+            { 3, { { 3, 3, 256 }, { 2, 3, 128 }, { 3, 2, 128 } } },
+        },
+    };
+
+    /* Position of the neighbours of the bottom right corner, in the order of Upscaler::Neighbour */
+    constexpr i32 BASE_NEIGHBOURS[][ 2 ] =
+    {
+        { 0, -1 }, { 1, -1 }, { -1, 0 }, { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 }, { 2, 0 }, { 2, 1 }, { 0, 2 }, { 1, 2 },
+    };
+
+    /* Quarter turns clockwise, the y axis points down */
+    void Rotate( i32 &x, i32 &y, u32 rotation )
+    {
+        for ( u32 turn = 0; turn < rotation; ++turn )
+        {
+            const i32 previousX = x;
+            x = -y;
+            y = previousX;
+        }
+    }
+
+    u32 ToPixel( RGB color )
+    {
+        return ( color.red << 16 ) | ( color.green << 8 ) | color.blue;
+    }
+
+    u32 ToYuv( u32 pixel )
+    {
+        const i32 r = ( pixel >> 16 ) & 0xFF;
+        const i32 g = ( pixel >> 8 ) & 0xFF;
+        const i32 b = pixel & 0xFF;
+        const i32 y = ( 299 * r + 587 * g + 114 * b ) / 1000;
+        const i32 u = ( -169 * r - 331 * g + 500 * b ) / 1000 + 128;
+        const i32 v = ( 500 * r - 419 * g - 81 * b ) / 1000 + 128;
+        return ( y << 16 ) | ( u << 8 ) | v;
+    }
+
+    u32 GetDistance( u32 lhs, u32 rhs )
+    {
+        return abs( static_cast< i32 >( ( lhs >> 16 ) & 0xFF ) - static_cast< i32 >( ( rhs >> 16 ) & 0xFF ) )
+             + abs( static_cast< i32 >( ( lhs >> 8 ) & 0xFF ) - static_cast< i32 >( ( rhs >> 8 ) & 0xFF ) )
+             + abs( static_cast< i32 >( lhs & 0xFF ) - static_cast< i32 >( rhs & 0xFF ) );
+    }
+
+    /* The color thresholds of the HQx filters */
+    bool IsSimilar( u32 lhs, u32 rhs )
+    {
+        return abs( static_cast< i32 >( ( lhs >> 16 ) & 0xFF ) - static_cast< i32 >( ( rhs >> 16 ) & 0xFF ) ) <= 48
+            && abs( static_cast< i32 >( ( lhs >> 8 ) & 0xFF ) - static_cast< i32 >( ( rhs >> 8 ) & 0xFF ) ) <= 7
+            && abs( static_cast< i32 >( lhs & 0xFF ) - static_cast< i32 >( rhs & 0xFF ) ) <= 6;
+    }
+
+    u32 Blend( u32 pixel, u32 color, u32 alpha )
+    {
+        const u32 redBlue = ( ( pixel & 0xFF00FF ) * ( 256 - alpha ) + ( color & 0xFF00FF ) * alpha ) >> 8;
+        const u32 green = ( ( pixel & 0x00FF00 ) * ( 256 - alpha ) + ( color & 0x00FF00 ) * alpha ) >> 8;
+        return ( redBlue & 0xFF00FF ) | ( green & 0x00FF00 );
+    }
+
+    u32 Average( u32 lhs, u32 rhs )
+    {
+        return ( ( lhs & 0xFEFEFE ) >> 1 ) + ( ( rhs & 0xFEFEFE ) >> 1 );
+    }
+
+#if defined( __SSE2__ )
+    __m128i Load( const u32 *pixels )
+    {
+        return _mm_loadu_si128( reinterpret_cast< const __m128i * >( pixels ) );
+    }
+
+    void Store( u32 *pixels, __m128i value )
+    {
+        _mm_storeu_si128( reinterpret_cast< __m128i * >( pixels ), value );
+    }
+
+    __m128i Select( __m128i mask, __m128i lhs, __m128i rhs )
+    {
+        return _mm_or_si128( _mm_and_si128( mask, lhs ), _mm_andnot_si128( mask, rhs ) );
+    }
+#endif
+}
+
+
+Upscaler::Upscaler( Filter filter, u32 scale, u32 width, u32 height )
+    : filter( filter )
+    , scale( scale )
+    , width( width )
+    , height( height )
+    , pitch( width + PADDING * 2 )
+{
+    assert( IsScaleSupported( filter, scale ) );
+
+    pixels.resize( pitch * ( height + PADDING * 2 ) );
+    if ( filter == Filter::Hqx || filter == Filter::Xbr )
+    {
+        yuv.resize( pixels.size() );
+    }
+    scaledRows.resize( width * scale * scale );
+
+    InitializeRotations();
+}
+
+bool Upscaler::IsScaleSupported( Filter filter, u32 scale )
+{
+    switch ( filter )
+    {
+        case Filter::Nearest:   { return scale >= 1 && scale <= MAX_SCALE; }
+        case Filter::Scale2x:   { return scale == 2; }
+        case Filter::Scale3x:   { return scale == 3; }
+        case Filter::Hqx:
+        case Filter::Xbr:       { return scale >= 2 && scale <= MAX_SCALE; }
+        default:                { return false; }
+    }
+}
+
+u32 Upscaler::GetHaloRows() const
+{
+    switch ( filter )
+    {
+        case Filter::Nearest:   { return 0; }
+        case Filter::Xbr:       { return 2; }
+        default:                { return 1; }
+    }
+}
+
+void Upscaler::InitializeRotations()
+{
+    for ( u32 rotation = 0; rotation < ROTATIONS; ++rotation )
+    {
+        for ( u32 neighbour = 0; neighbour < NEIGHBOUR_COUNT; ++neighbour )
+        {
+            i32 x = BASE_NEIGHBOURS[ neighbour ][ 0 ];
+            i32 y = BASE_NEIGHBOURS[ neighbour ][ 1 ];
+            Rotate( x, y, rotation );
+            neighbourOffsets[ rotation ][ neighbour ] = y * static_cast< i32 >( pitch ) + x;
+        }
+
+        if ( scale < 2 )
+        {
+            continue;
+        }
+
+        for ( u32 shape = 0; shape < SHAPE_COUNT; ++shape )
+        {
+            /* Rotated around the center of the block, in half pixels so it stays integer */
+            const BaseShape &base = BASE_SHAPES[ scale - 2 ][ shape ];
+            RotatedShape &rotated = shapes[ rotation ][ shape ];
+            rotated.count = base.count;
+            for ( u32 entry = 0; entry < base.count; ++entry )
+            {
+                i32 x = base.entries[ entry ].x * 2 - static_cast< i32 >( scale - 1 );
+                i32 y = base.entries[ entry ].y * 2 - static_cast< i32 >( scale - 1 );
+                Rotate( x, y, rotation );
+                x = ( x + static_cast< i32 >( scale - 1 ) ) / 2;
+                y = ( y + static_cast< i32 >( scale - 1 ) ) / 2;
+                rotated.pixels[ entry ] = static_cast< byte >( y * scale + x );
+                rotated.alphas[ entry ] = base.entries[ entry ].alpha;
+            }
+        }
+    }
+}
+
+void Upscaler::Upscale( const RGB *source, u32 firstRow, u32 lastRow, RGB *output )
+{
+    assert( firstRow < lastRow && lastRow <= height );
+
+    LoadBand( source, firstRow, lastRow );
+
+    const u32 outputWidth = width * scale;
+    for ( u32 row = firstRow; row < lastRow; ++row )
+    {
+        const u32 bandOffset = ( row - firstRow + PADDING ) * pitch + PADDING;
+        const u32 *pixelRow = &pixels[ bandOffset ];
+
+        switch ( filter )
+        {
+            case Filter::Nearest:   { ScaleRowNearest( pixelRow ); break; }
+            case Filter::Scale2x:   { ScaleRowScale2x( pixelRow ); break; }
+            case Filter::Scale3x:   { ScaleRowScale3x( pixelRow ); break; }
+            case Filter::Hqx:       { ScaleRowHqx( pixelRow, &yuv[ bandOffset ] ); break; }
+            case Filter::Xbr:       { ScaleRowXbr( pixelRow, &yuv[ bandOffset ] ); break; }
+            default:                { assert( false ); }
+        }
+
+        StoreRows( &output[ row * scale * outputWidth ] );
+    }
+}
+
+void Upscaler::LoadBand( const RGB *source, u32 firstRow, u32 lastRow )
+{
+    /* Rows and columns outside of the frame repeat the closest edge */
+    const i32 bandRows = static_cast< i32 >( lastRow - firstRow + PADDING * 2 );
+    const i32 halo = static_cast< i32 >( ( GetHaloRows() < PADDING ) ? GetHaloRows() : PADDING );
+    for ( i32 bandRow = PADDING - halo; bandRow < bandRows - static_cast< i32 >( PADDING ) + halo; ++bandRow )
+    {
+        i32 sourceRow = static_cast< i32 >( firstRow ) + bandRow - static_cast< i32 >( PADDING );
+        sourceRow = ( sourceRow < 0 ) ? 0 : ( sourceRow >= static_cast< i32 >( height ) ) ? height - 1 : sourceRow;
+
+        const RGB *sourcePixels = &source[ sourceRow * width ];
+        u32 *row = &pixels[ bandRow * pitch + PADDING ];
+        for ( u32 x = 0; x < width; ++x )
+        {
+            row[ x ] = ToPixel( sourcePixels[ x ] );
+        }
+        for ( u32 x = 1; x <= PADDING; ++x )
+        {
+            row[ -static_cast< i32 >( x ) ] = row[ 0 ];
+            row[ width - 1 + x ] = row[ width - 1 ];
+        }
+
+        if ( !yuv.empty() )
+        {
+            u32 *yuvRow = &yuv[ bandRow * pitch ];
+            const u32 *pixelRow = &pixels[ bandRow * pitch ];
+            for ( u32 x = 0; x < pitch; ++x )
+            {
+                yuvRow[ x ] = ToYuv( pixelRow[ x ] );
+            }
+        }
+    }
+}
+
+void Upscaler::StoreRows( RGB *output ) const
+{
+    const u32 count = width * scale * scale;
+    for ( u32 i = 0; i < count; ++i )
+    {
+        const u32 pixel = scaledRows[ i ];
+        output[ i ] = { static_cast< byte >( pixel >> 16 ), static_cast< byte >( pixel >> 8 ), static_cast< byte >( pixel ) };
+    }
+}
+
+void Upscaler::WriteBlock( const u32 *block, u32 x )
+{
+    const u32 outputWidth = width * scale;
+    for ( u32 y = 0; y < scale; ++y )
+    {
+        for ( u32 subX = 0; subX < scale; ++subX )
+        {
+            scaledRows[ y * outputWidth + x * scale + subX ] = block[ y * scale + subX ];
+        }
+    }
+}
+
+void Upscaler::ScaleRowNearest( const u32 *row )
+{
+    const u32 outputWidth = width * scale;
+    for ( u32 x = 0; x < width; ++x )
+    {
+        for ( u32 subX = 0; subX < scale; ++subX )
+        {
+            scaledRows[ x * scale + subX ] = row[ x ];
+        }
+    }
+
+    for ( u32 y = 1; y < scale; ++y )
+    {
+        std::copy( scaledRows.begin(), scaledRows.begin() + outputWidth, scaledRows.begin() + y * outputWidth );
+    }
+}
+
+void Upscaler::ScaleRowScale2x( const u32 *row )
+{
+    /*
+        A B C       E0 E1
+        D E F  ->   E2 E3
+        G H I
+     */
+    u32 *top = scaledRows.data();
+    u32 *bottom = top + width * 2;
+    const u32 *above = row - pitch;
+    const u32 *below = row + pitch;
+
+    u32 x = 0;
+#if defined( __SSE2__ )
+    for ( ; x + 4 <= width; x += 4 )
+    {
+        const __m128i b = Load( &above[ x ] );
+        const __m128i d = Load( row + x - 1 );
+        const __m128i e = Load( &row[ x ] );
+        const __m128i f = Load( &row[ x + 1 ] );
+        const __m128i h = Load( &below[ x ] );
+
+        const __m128i isCorner = _mm_andnot_si128( _mm_or_si128( _mm_cmpeq_epi32( b, h ), _mm_cmpeq_epi32( d, f ) ), _mm_set1_epi32( -1 ) );
+        const __m128i e0 = Select( _mm_and_si128( isCorner, _mm_cmpeq_epi32( d, b ) ), d, e );
+        const __m128i e1 = Select( _mm_and_si128( isCorner, _mm_cmpeq_epi32( b, f ) ), f, e );
+        const __m128i e2 = Select( _mm_and_si128( isCorner, _mm_cmpeq_epi32( d, h ) ), d, e );
+        const __m128i e3 = Select( _mm_and_si128( isCorner, _mm_cmpeq_epi32( h, f ) ), f, e );
+
+        Store( &top[ x * 2 ], _mm_unpacklo_epi32( e0, e1 ) );
+        Store( &top[ x * 2 + 4 ], _mm_unpackhi_epi32( e0, e1 ) );
+        Store( &bottom[ x * 2 ], _mm_unpacklo_epi32( e2, e3 ) );
+        Store( &bottom[ x * 2 + 4 ], _mm_unpackhi_epi32( e2, e3 ) );
+    }
+#endif
+
+    for ( ; x < width; ++x )
+    {
+        const u32 b = above[ x ], d = *( row + x - 1 ), e = row[ x ], f = row[ x + 1 ], h = below[ x ];
+        const bool isCorner = b != h && d != f;
+        top[ x * 2 ]        = ( isCorner && d == b ) ? d : e;
+        top[ x * 2 + 1 ]    = ( isCorner && b == f ) ? f : e;
+        bottom[ x * 2 ]     = ( isCorner && d == h ) ? d : e;
+        bottom[ x * 2 + 1 ] = ( isCorner && h == f ) ? f : e;
+    }
+}
+
+void Upscaler::ScaleRowScale3x( const u32 *row )
+{
+    /*
+        A B C       E0 E1 E2
+        D E F  ->   E3 E4 E5
+        G H I       E6 E7 E8
+     */
+    const u32 outputWidth = width * 3;
+    const u32 *above = row - pitch;
+    const u32 *below = row + pitch;
+
+    u32 x = 0;
+#if defined( __SSE2__ )
+    for ( ; x + 4 <= width; x += 4 )
+    {
+        const __m128i a = Load( above + x - 1 ), b = Load( &above[ x ] ), c = Load( &above[ x + 1 ] );
+        const __m128i d = Load( row + x - 1 ),   e = Load( &row[ x ] ),   f = Load( &row[ x + 1 ] );
+        const __m128i g = Load( below + x - 1 ), h = Load( &below[ x ] ), i = Load( &below[ x + 1 ] );
+
+        const __m128i isCorner = _mm_andnot_si128( _mm_or_si128( _mm_cmpeq_epi32( b, h ), _mm_cmpeq_epi32( d, f ) ), _mm_set1_epi32( -1 ) );
+        const __m128i db = _mm_and_si128( isCorner, _mm_cmpeq_epi32( d, b ) );
+        const __m128i bf = _mm_and_si128( isCorner, _mm_cmpeq_epi32( b, f ) );
+        const __m128i dh = _mm_and_si128( isCorner, _mm_cmpeq_epi32( d, h ) );
+        const __m128i hf = _mm_and_si128( isCorner, _mm_cmpeq_epi32( h, f ) );
+
+        /* E differs from the corners, compared once as the complement of the equality */
+        const __m128i ea = _mm_cmpeq_epi32( e, a ), ec = _mm_cmpeq_epi32( e, c ), eg = _mm_cmpeq_epi32( e, g ), ei = _mm_cmpeq_epi32( e, i );
+
+        u32 block[ 9 ][ 4 ];
+        Store( block[ 0 ], Select( db, d, e ) );
+        Store( block[ 1 ], Select( _mm_or_si128( _mm_andnot_si128( ec, db ), _mm_andnot_si128( ea, bf ) ), b, e ) );
+        Store( block[ 2 ], Select( bf, f, e ) );
+        Store( block[ 3 ], Select( _mm_or_si128( _mm_andnot_si128( eg, db ), _mm_andnot_si128( ea, dh ) ), d, e ) );
+        Store( block[ 4 ], e );
+        Store( block[ 5 ], Select( _mm_or_si128( _mm_andnot_si128( ei, bf ), _mm_andnot_si128( ec, hf ) ), f, e ) );
+        Store( block[ 6 ], Select( dh, d, e ) );
+        Store( block[ 7 ], Select( _mm_or_si128( _mm_andnot_si128( ei, dh ), _mm_andnot_si128( eg, hf ) ), h, e ) );
+        Store( block[ 8 ], Select( hf, f, e ) );
+
+        for ( u32 lane = 0; lane < 4; ++lane )
+        {
+            u32 *output = &scaledRows[ ( x + lane ) * 3 ];
+            for ( u32 y = 0; y < 3; ++y )
+            {
+                output[ y * outputWidth ]     = block[ y * 3 ][ lane ];
+                output[ y * outputWidth + 1 ] = block[ y * 3 + 1 ][ lane ];
+                output[ y * outputWidth + 2 ] = block[ y * 3 + 2 ][ lane ];
+            }
+        }
+    }
+#endif
+
+    for ( ; x < width; ++x )
+    {
+        const u32 a = *( above + x - 1 ), b = above[ x ], c = above[ x + 1 ];
+        const u32 d = *( row + x - 1 ),   e = row[ x ],   f = row[ x + 1 ];
+        const u32 g = *( below + x - 1 ), h = below[ x ], i = below[ x + 1 ];
+
+        const bool isCorner = b != h && d != f;
+        const bool db = isCorner && d == b, bf = isCorner && b == f, dh = isCorner && d == h, hf = isCorner && h == f;
+
+        u32 *output = &scaledRows[ x * 3 ];
+        output[ 0 ]                     = db ? d : e;
+        output[ 1 ]                     = ( ( db && e != c ) || ( bf && e != a ) ) ? b : e;
+        output[ 2 ]                     = bf ? f : e;
+        output[ outputWidth ]           = ( ( db && e != g ) || ( dh && e != a ) ) ? d : e;
+        output[ outputWidth + 1 ]       = e;
+        output[ outputWidth + 2 ]       = ( ( bf && e != i ) || ( hf && e != c ) ) ? f : e;
+        output[ outputWidth * 2 ]       = dh ? d : e;
+        output[ outputWidth * 2 + 1 ]   = ( ( dh && e != i ) || ( hf && e != g ) ) ? h : e;
+        output[ outputWidth * 2 + 2 ]   = hf ? f : e;
+    }
+}
+
+void Upscaler::ScaleRowHqx( const u32 *row, const u32 *yuvRow )
+{
+    u32 block[ MAX_SCALE * MAX_SCALE ];
+    for ( u32 x = 0; x < width; ++x )
+    {
+        const u32 e = row[ x ];
+        std::fill( block, block + scale * scale, e );
+
+        for ( u32 rotation = 0; rotation < ROTATIONS; ++rotation )
+        {
+            const i32 *offsets = neighbourOffsets[ rotation ];
+            const u32 *center = &row[ x ];
+            const u32 f = center[ offsets[ PF ] ];
+            const u32 h = center[ offsets[ PH ] ];
+            const u32 i = center[ offsets[ PI ] ];
+            if ( f == e && h == e && i == e )
+            {
+                continue;
+            }
+
+            const u32 *yuvCenter = &yuvRow[ x ];
+            const u32 yuvE = yuvCenter[ 0 ];
+            const u32 yuvF = yuvCenter[ offsets[ PF ] ];
+            const u32 yuvH = yuvCenter[ offsets[ PH ] ];
+            const u32 yuvI = yuvCenter[ offsets[ PI ] ];
+            const bool isSimilarF = IsSimilar( yuvE, yuvF );
+            const bool isSimilarH = IsSimilar( yuvE, yuvH );
+
+            if ( !isSimilarF && !isSimilarH && IsSimilar( yuvF, yuvH ) )
+            {
+                /* Both sides of the corner belong to another shape, round the corner toward it */
+                const u32 alpha = IsSimilar( yuvI, yuvF ) ? 192 : 128;
+                ApplyShape( shapes[ rotation ][ HQX_EDGE ], Average( f, h ), alpha, block );
+            }
+            else if ( isSimilarF && isSimilarH && !IsSimilar( yuvE, yuvI ) )
+            {
+                ApplyShape( shapes[ rotation ][ HQX_WEAK ], i, 64, block );
+            }
+        }
+
+        WriteBlock( block, x );
+    }
+}
+
+void Upscaler::ScaleRowXbr( const u32 *row, const u32 *yuvRow )
+{
+    u32 block[ MAX_SCALE * MAX_SCALE ];
+    for ( u32 x = 0; x < width; ++x )
+    {
+        const u32 e = row[ x ];
+        std::fill( block, block + scale * scale, e );
+
+        for ( u32 rotation = 0; rotation < ROTATIONS; ++rotation )
+        {
+            const i32 *offsets = neighbourOffsets[ rotation ];
+
+            /* Flat areas are most of a frame, nothing to do unless E differs from both sides of the corner */
+            const u32 *center = &row[ x ];
+            const u32 pf = center[ offsets[ PF ] ];
+            const u32 ph = center[ offsets[ PH ] ];
+            if ( e == pf || e == ph )
+            {
+                continue;
+            }
+
+            const u32 *yuvCenter = &yuvRow[ x ];
+            const u32 yE = yuvCenter[ 0 ];
+            const u32 yB = yuvCenter[ offsets[ PB ] ], yC = yuvCenter[ offsets[ PC ] ], yD = yuvCenter[ offsets[ PD ] ];
+            const u32 yF = yuvCenter[ offsets[ PF ] ], yG = yuvCenter[ offsets[ PG ] ], yH = yuvCenter[ offsets[ PH ] ];
+            const u32 yI = yuvCenter[ offsets[ PI ] ], yF4 = yuvCenter[ offsets[ F4 ] ], yI4 = yuvCenter[ offsets[ I4 ] ];
+            const u32 yH5 = yuvCenter[ offsets[ H5 ] ], yI5 = yuvCenter[ offsets[ I5 ] ];
+
+            /* Weighted edge strength along both diagonals, the corner is blended when its own diagonal is the weaker one */
+            const u32 edgeAcross = GetDistance( yE, yC ) + GetDistance( yE, yG ) + GetDistance( yI, yH5 ) + GetDistance( yI, yF4 ) + ( GetDistance( yH, yF ) << 2 );
+            const u32 edgeAlong = GetDistance( yH, yD ) + GetDistance( yH, yI5 ) + GetDistance( yF, yI4 ) + GetDistance( yF, yB ) + ( GetDistance( yE, yI ) << 2 );
+            if ( edgeAcross > edgeAlong )
+            {
+                continue;
+            }
+
+            const u32 color = ( GetDistance( yE, yF ) <= GetDistance( yE, yH ) ) ? pf : ph;
+            const bool isEdge = edgeAcross < edgeAlong
+                && ( ( !IsSimilar( yF, yB ) && !IsSimilar( yH, yD ) )
+                  || ( IsSimilar( yE, yI ) && !IsSimilar( yF, yI4 ) && !IsSimilar( yH, yI5 ) )
+                  || IsSimilar( yE, yG ) || IsSimilar( yE, yC ) );
+            if ( !isEdge )
+            {
+                ApplyShape( shapes[ rotation ][ XBR_WEAK ], color, 256, block );
+                continue;
+            }
+
+            /* The slope of the edge decides which neighbours of the corner are blended as well */
+            const u32 pg = center[ offsets[ PG ] ], pc = center[ offsets[ PC ] ];
+            const u32 pd = center[ offsets[ PD ] ], pb = center[ offsets[ PB ] ];
+            const u32 slopeLeft = GetDistance( yF, yG );
+            const u32 slopeUp = GetDistance( yH, yC );
+            const bool isLeft = ( slopeLeft << 1 ) <= slopeUp && e != pg && pd != pg;
+            const bool isUp = slopeLeft >= ( slopeUp << 1 ) && e != pc && pb != pc;
+
+            const Shape shape = ( isLeft && isUp ) ? XBR_LEFT_UP : isLeft ? XBR_LEFT : isUp ? XBR_UP : XBR_DIAGONAL;
+            ApplyShape( shapes[ rotation ][ shape ], color, 256, block );
+        }
+
+        WriteBlock( block, x );
+    }
+}
+
+void Upscaler::ApplyShape( const RotatedShape &shape, u32 color, u32 alpha, u32 *block ) const
+{
+    for ( u32 entry = 0; entry < shape.count; ++entry )
+    {
+        u32 &pixel = block[ shape.pixels[ entry ] ];
+        pixel = Blend( pixel, color, ( shape.alphas[ entry ] * alpha ) >> 8 );
+    }
+}
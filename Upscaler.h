@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Types.h"
+
+
+/*
+    Pixel art upscalers. A frame is scaled one band of rows at a time so several threads can share
+    it, a band reads up to GetHaloRows() rows above and below itself and the pixels outside of the
+    frame repeat its edges. The band is converted to 32 bit pixels once, which lets Scale2x and
+    Scale3x compare four pixels at a time with SSE2, and the result is converted back to RGB one
+    source row at a time.
+
+    Scale2x and Scale3x only copy neighbours, HQx blends the corners that sit on an edge and xBR
+    ( level 2 ) also follows the slope of the edge. The last two compare colors in YUV.
+ */
+
+class Upscaler
+{
+public:
+
+    enum class Filter : byte
+    {
+        Nearest = 0,
+        Scale2x,
+        Scale3x,
+        Hqx,
+        Xbr,
+        Count
+    };
+
+    static constexpr const char* FilterString [ static_cast< size_t >( Filter::Count ) ] =
+    {
+        "nearest",
+        "scale2x",
+        "scale3x",
+        "hqx",
+        "xbr",
+    };
+
+    static constexpr u32 MAX_SCALE = 4;
+
+    Upscaler( Filter filter, u32 scale, u32 width, u32 height );
+
+    static bool IsScaleSupported( Filter filter, u32 scale );
+
+    /* Scales the source rows [firstRow, lastRow) into the same rows of output, which is width * scale pixels wide */
+    void Upscale( const RGB *source, u32 firstRow, u32 lastRow, RGB *output );
+
+    u32 GetHaloRows() const;
+
+private:
+
+    static constexpr u32 PADDING = 2;
+    static constexpr u32 ROTATIONS = 4;
+    static constexpr u32 MAX_CORNER_BLENDS = 8;
+
+    /* Neighbours of the current pixel used by HQx and xBR, the other ones of the 5x5 block are never read */
+    enum Neighbour : byte
+    {
+        PB, PC, PD, PF, PG, PH, PI, F4, I4, H5, I5, NEIGHBOUR_COUNT
+    };
+
+    /* Edge shapes, the same for every corner */
+    enum Shape : byte
+    {
+        XBR_LEFT_UP, XBR_LEFT, XBR_UP, XBR_DIAGONAL, XBR_WEAK, HQX_EDGE, HQX_WEAK, SHAPE_COUNT
+    };
+
+    /* Pixels of the output block blended toward the color found for a corner, 256 replaces the pixel */
+    struct RotatedShape
+    {
+        u32     count;
+        byte    pixels[ MAX_CORNER_BLENDS ];
+        u16     alphas[ MAX_CORNER_BLENDS ];
+    };
+
+    Filter              filter;
+    u32                 scale;
+    u32                 width;
+    u32                 height;
+    u32                 pitch;
+
+    /* Band of source pixels with PADDING pixels around it, plus their YUV for HQx and xBR */
+    std::vector< u32 >  pixels;
+    std::vector< u32 >  yuv;
+
+    /* Scale rows of width * scale pixels produced from one source row */
+    std::vector< u32 >  scaledRows;
+
+    /* Neighbour offsets and shapes for each of the four corners, the bottom right one rotated by 90 degrees steps */
+    i32                 neighbourOffsets[ ROTATIONS ][ NEIGHBOUR_COUNT ];
+    RotatedShape        shapes[ ROTATIONS ][ SHAPE_COUNT ];
+
+    void InitializeRotations();
+    void LoadBand( const RGB *source, u32 firstRow, u32 lastRow );
+    void StoreRows( RGB *output ) const;
+
+    void ScaleRowNearest( const u32 *row );
+    void ScaleRowScale2x( const u32 *row );
+    void ScaleRowScale3x( const u32 *row );
+    void ScaleRowHqx( const u32 *row, const u32 *yuvRow );
+    void ScaleRowXbr( const u32 *row, const u32 *yuvRow );
+
+    void ApplyShape( const RotatedShape &shape, u32 color, u32 alpha, u32 *block ) const;
+    void WriteBlock( const u32 *block, u32 x );
+};
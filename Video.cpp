@@ -6,14 +6,122 @@
 
 #include "Cartridge.h"
 #include "Memory.h"
+#include "Cpu.h"
+#include "PaletteColors.h"
+#include "RenderPipeline.h"
+#include "NtscFilter.h"
+#include "MemoryHeatmap.h"
+#include "Hash.h"
 
 
-Video::Video( Cartridge *cartridge )
+namespace
+{
+    constexpr u32 NO_EVENT = 0xFFFF'FFFF;
+
+    /* CPU cycle where the PPU enters the vertical blank, rounded up */
+    constexpr u32 VBLANK_EVENT_CYCLE = ( Video::VBLANK_SCANLINE * Video::CYCLE_DURATION_PER_SCANLINE + 2 ) / 3;
+    constexpr u32 PRERENDER_SCANLINE = Video::MAX_SCANLINES_PER_FRAME - 1;
+
+    /* PPUCTRL and PPUMASK bits */
+    constexpr byte NAMETABLE_SELECT_MASK        = 0b0000'0011;
+    constexpr byte VRAM_INCREMENT_BIT           = 0b0000'0100;
+    constexpr byte SPRITE_PATTERN_TABLE_BIT     = 0b0000'1000;
+    constexpr byte BACKGROUND_PATTERN_TABLE_BIT = 0b0001'0000;
+    constexpr byte TALL_SPRITES_BIT             = 0b0010'0000;
+    constexpr byte NMI_ENABLE_BIT               = 0b1000'0000;
+    constexpr byte GREYSCALE_BIT                = 0b0000'0001;
+    constexpr byte SHOW_LEFT_BACKGROUND_BIT     = 0b0000'0010;
+    constexpr byte SHOW_LEFT_SPRITES_BIT        = 0b0000'0100;
+    constexpr byte SHOW_BACKGROUND_BIT          = 0b0000'1000;
+    constexpr byte SHOW_SPRITES_BIT             = 0b0001'0000;
+
+    /* Emphasized colors attenuate the two other channels, like the composite signal does */
+    constexpr u32 EMPHASIS_COUNT                = 8;
+    constexpr u32 EMPHASIS_ATTENUATION          = 191; /* 0.746 in 8.8 */
+    constexpr byte BLACK_PALETTE_INDEX          = 0x0F;
+
+    struct EmphasisPalettes
+    {
+        RGB colors[ EMPHASIS_COUNT ][ NES_PALETTE_COLORS_COUNT ];
+    };
+
+    constexpr EmphasisPalettes BuildEmphasisPalettes()
+    {
+        EmphasisPalettes palettes = {};
+        for ( u32 emphasis = 0; emphasis < EMPHASIS_COUNT; ++emphasis )
+        {
+            const u32 red = ( emphasis == 0 || ( emphasis & 0x01 ) ) ? 256 : EMPHASIS_ATTENUATION;
+            const u32 green = ( emphasis == 0 || ( emphasis & 0x02 ) ) ? 256 : EMPHASIS_ATTENUATION;
+            const u32 blue = ( emphasis == 0 || ( emphasis & 0x04 ) ) ? 256 : EMPHASIS_ATTENUATION;
+            for ( u32 index = 0; index < NES_PALETTE_COLORS_COUNT; ++index )
+            {
+                const RGB &color = NES_PALETTE_COLORS[ index ];
+                palettes.colors[ emphasis ][ index ] = { static_cast< byte >( ( color.red * red ) >> 8 ), static_cast< byte >( ( color.green * green ) >> 8 ), static_cast< byte >( ( color.blue * blue ) >> 8 ) };
+            }
+        }
+        return palettes;
+    }
+
+    constexpr EmphasisPalettes EMPHASIS_PALETTES = BuildEmphasisPalettes();
+
+    /* Sprite pixels: palette << 2 | color in the low nibble, 0 is transparent */
+    constexpr byte SPRITE_BEHIND_BACKGROUND     = 0b0001'0000;
+    constexpr u32 MAX_SPRITES_PER_SCANLINE      = 8;
+
+    /* Parts of the v and t registers */
+    constexpr word COARSE_X_MASK                = 0x001F;
+    constexpr word COARSE_Y_MASK                = 0x03E0;
+    constexpr word NAMETABLE_X_BIT              = 0x0400;
+    constexpr word NAMETABLE_Y_BIT              = 0x0800;
+    constexpr word FINE_Y_MASK                  = 0x7000;
+    constexpr word HORIZONTAL_BITS              = NAMETABLE_X_BIT | COARSE_X_MASK;
+    constexpr word VERTICAL_BITS                = FINE_Y_MASK | NAMETABLE_Y_BIT | COARSE_Y_MASK;
+    constexpr word PPU_ADDRESS_MASK             = 0x3FFF;
+    constexpr word NAMETABLE_ADDRESS            = 0x2000;
+    constexpr word PALETTE_ADDRESS              = 0x3F00;
+
+    /* Advances the coarse X of a VRAM address, wrapping into the horizontally adjacent nametable */
+    word AddCoarseX( word address, u32 tiles )
+    {
+        const u32 coarseX = ( address & COARSE_X_MASK ) + tiles;
+        address = ( address & ~COARSE_X_MASK ) | ( coarseX & COARSE_X_MASK );
+        return ( coarseX > COARSE_X_MASK ) ? address ^ NAMETABLE_X_BIT : address;
+    }
+
+    /* Address of the pattern row a sprite shows on the given row, already flipped */
+    word GetSpritePatternAddress( const byte *entry, u32 row, u32 spriteHeight, byte control )
+    {
+        const byte tile = entry[ 1 ];
+        const u32 tileRow = ( entry[ 2 ] & 0b1000'0000 ) ? spriteHeight - 1 - row : row;
+
+        /* 8x16 sprites take the pattern table from bit 0 of the tile index */
+        if ( spriteHeight == 16 )
+        {
+            return ( ( tile & 0x01 ) ? 0x1000 : 0x0000 ) + ( tile & 0xFE ) * 16 + ( tileRow & 0x08 ) * 2 + ( tileRow & 0x07 );
+        }
+        return ( ( control & SPRITE_PATTERN_TABLE_BIT ) ? 0x1000 : 0x0000 ) + tile * 16 + tileRow;
+    }
+
+    /* 0x3F20 - 0x3FFF mirror the 32 palette entries, and 0x3F10/14/18/1C mirror the background colors */
+    word GetPaletteAddress( word address )
+    {
+        address = PALETTE_ADDRESS | ( address & 0x001F );
+        return ( ( address & 0x0013 ) == 0x0010 ) ? address & ~0x0010 : address;
+    }
+}
+
+
+Video::Video( const Cartridge *cartridge )
     : cartridge( cartridge )
-    , ppuCycles( 0u )
-    , currentScanline( 0u )
+    , memory( nullptr )
+    , cpu( nullptr )
+    , renderPipeline( nullptr )
+    , copiedPipelineFrames( 0u )
+    , ntscFilter( nullptr )
+    , memoryHeatmap( nullptr )
 {
     map = new byte[ 16_KB ];
+    indexedFrameBuffer = new byte[ NES_VIDEO_RESOLUTION ];
     frameBuffer = new RGB[ NES_VIDEO_RESOLUTION ];
 
     Reset();
@@ -22,25 +130,58 @@ Video::Video( Cartridge *cartridge )
 Video::~Video()
 {
     delete[] map;
+    delete[] indexedFrameBuffer;
     delete[] frameBuffer;
 }
 
-void Video::Init( Memory *memorySystem )
+void Video::Init( Memory *memorySystem, Cpu *cpuSystem )
 {
     memory = memorySystem;
+    cpu = cpuSystem;
 }
 
 void Video::Reset()
 {
+    /* The timing first, SetMirroring catches up with the frame in progress */
+    SoftReset();
+
     memset( map, 0x00, 16_KB );
+    memset( nametableRam, 0x00, sizeof( nametableRam ) );
+    memset( oam, 0x00, OAM_SIZE );
 
+    MapCartridgeCHRToPPU();
+
+    const Cartridge::Header &header = cartridge->GetHeader();
+    SetMirroring( header.ignoreMirroring ? Cartridge::MirroringType::FourScreen : header.mirroringType );
+}
+
+void Video::SoftReset()
+{
+    oamAddress = 0x00;
+    control = 0x00;
+    mask = 0x00;
+    status = VBLANK_FLAG | SPRITE_OVERFLOW_FLAG;
+    openBus = 0x00;
+    readBuffer = 0x00;
+    vramAddress = 0x0000;
+    temporaryVramAddress = 0x0000;
+    fineX = 0;
+    isSecondWrite = false;
+    dirtyMemory = ALL_MEMORY_DIRTY;
+
+    cpuCycles = 0u;
+    nextEventCycle = VBLANK_EVENT_CYCLE;
+    ppuCycles = 0u;
+    currentScanline = 0u;
+
+    /* The RGB frame buffer stays pink until the first scanline is drawn */
+    memset( indexedFrameBuffer, BLACK_PALETTE_INDEX, NES_VIDEO_RESOLUTION );
+    memset( scanlineEmphasis, 0x00, sizeof( scanlineEmphasis ) );
     for ( u32 i = 0; i < NES_VIDEO_RESOLUTION; ++i )
     {
         frameBuffer[ i ] = color::PINK;
     }
-
-    MapCartridgeCHRToPPU();
-
+    isFrameBufferStale = false;
 }
 
 void Video::MapCartridgeCHRToPPU()
@@ -57,9 +198,78 @@ void Video::MapCartridgeCHRToPPU()
 
 RGB* Video::GetFrameBuffer() const
 {
+    CopyPipelineFrame();
+    if ( isFrameBufferStale )
+    {
+        for ( u32 scanline = 0; scanline < NES_VIDEO_HEIGHT; ++scanline )
+        {
+            ConvertToRGB( &indexedFrameBuffer[ scanline * NES_VIDEO_WIDTH ], scanlineEmphasis[ scanline ], &frameBuffer[ scanline * NES_VIDEO_WIDTH ] );
+        }
+        isFrameBufferStale = false;
+    }
     return frameBuffer;
 }
 
+const byte* Video::GetIndexedFrameBuffer() const
+{
+    CopyPipelineFrame();
+    return indexedFrameBuffer;
+}
+
+const byte* Video::GetScanlineEmphasis() const
+{
+    CopyPipelineFrame();
+    return scanlineEmphasis;
+}
+
+u64 Video::GetFrameHash() const
+{
+    CopyPipelineFrame();
+    return Hash64( indexedFrameBuffer, NES_VIDEO_RESOLUTION, Hash64( scanlineEmphasis, sizeof( scanlineEmphasis ), 0 ) );
+}
+
+void Video::SetNtscFilter( NtscFilter *filter )
+{
+    CatchUp();
+    ntscFilter = filter;
+}
+
+void Video::SetMemoryHeatmap( MemoryHeatmap *heatmap )
+{
+    memoryHeatmap = heatmap;
+}
+
+void Video::SetRenderPipeline( RenderPipeline *pipeline )
+{
+    CatchUp();
+    renderPipeline = pipeline;
+    copiedPipelineFrames = ( pipeline != nullptr ) ? pipeline->GetCompletedFrames() : 0u;
+    dirtyMemory = ALL_MEMORY_DIRTY;
+}
+
+void Video::CopyPipelineFrame() const
+{
+    if ( renderPipeline == nullptr )
+    {
+        return;
+    }
+
+    /* The workers only write the frame in flight, once it is completed it stays untouched until the next submit */
+    renderPipeline->Flush();
+    if ( renderPipeline->GetCompletedFrames() == copiedPipelineFrames )
+    {
+        return;
+    }
+
+    memcpy( indexedFrameBuffer, renderPipeline->GetIndexedFrame(), NES_VIDEO_RESOLUTION );
+    for ( u32 scanline = 0; scanline < NES_VIDEO_HEIGHT; ++scanline )
+    {
+        scanlineEmphasis[ scanline ] = renderPipeline->GetScanlineEmphasis( scanline );
+    }
+    copiedPipelineFrames = renderPipeline->GetCompletedFrames();
+    isFrameBufferStale = true;
+}
+
 const byte * const Video::GetPPUMemory() const
 {
     return map;
@@ -67,29 +277,568 @@ const byte * const Video::GetPPUMemory() const
 
 byte Video::Read( word address ) const
 {
-    return map[ address ];
+    address &= PPU_ADDRESS_MASK;
+    if ( address < NAMETABLE_ADDRESS )
+    {
+        return map[ address ];
+    }
+    else if ( address < PALETTE_ADDRESS )
+    {
+        return ReadNametable( address );
+    }
+    return map[ GetPaletteAddress( address ) ];
 }
 
 void Video::Write( word address, byte data )
 {
-    map[ address ] = data;
+    address &= PPU_ADDRESS_MASK;
+    if ( address < NAMETABLE_ADDRESS )
+    {
+        map[ address ] = data;
+        dirtyMemory |= PATTERN_TABLES_DIRTY;
+    }
+    else if ( address < PALETTE_ADDRESS )
+    {
+        nametables[ ( address >> 10 ) & 0x03 ][ address & 0x03FF ] = data;
+        dirtyMemory |= NAMETABLES_DIRTY;
+    }
+    else
+    {
+        map[ GetPaletteAddress( address ) ] = data;
+        dirtyMemory |= PALETTES_DIRTY;
+    }
+}
+
+void Video::SetMirroring( Cartridge::MirroringType mirroring )
+{
+    /* Which 1KB page of the nametable RAM every nametable uses */
+    static constexpr byte LAYOUTS[ static_cast< size_t >( Cartridge::MirroringType::Count ) ][ 4 ] =
+    {
+        { 0, 0, 1, 1 },     /* Horizontal */
+        { 0, 1, 0, 1 },     /* Vertical */
+        { 0, 0, 0, 0 },     /* Single screen lower */
+        { 1, 1, 1, 1 },     /* Single screen upper */
+        { 0, 1, 2, 3 },     /* Four screen */
+    };
+
+    /* Scanlines already completed were rendered with the previous layout */
+    CatchUp();
+
+    const byte *layout = LAYOUTS[ static_cast< size_t >( mirroring ) ];
+    for ( u32 nametable = 0; nametable < 4; ++nametable )
+    {
+        nametables[ nametable ] = &nametableRam[ layout[ nametable ] * 1_KB ];
+    }
+    dirtyMemory |= NAMETABLES_DIRTY;
 }
 
-void Video::Update( u32 cycles )
+byte Video::ReadRegister( word ppuRegister )
+{
+    switch ( ppuRegister )
+    {
+        case PPUSTATUS_REGISTER:
+        {
+            /* The low bits are not driven by the PPU */
+            openBus = ( status & 0b1110'0000 ) | ( openBus & 0b0001'1111 );
+            status &= ~VBLANK_FLAG;
+            isSecondWrite = false;
+        }
+        break;
+
+        case OAMADATA_REGISTER:
+        {
+            openBus = oam[ oamAddress ];
+        }
+        break;
+
+        case PPUDATA_ADDRESS:
+        {
+            const word address = vramAddress & PPU_ADDRESS_MASK;
+            if ( memoryHeatmap != nullptr )
+            {
+                memoryHeatmap->LogPpuRead( address );
+            }
+
+            if ( address >= PALETTE_ADDRESS )
+            {
+                /* Palettes are returned right away, the buffer gets the nametable byte underneath */
+                openBus = Read( address );
+                readBuffer = Read( address - 0x1000 );
+            }
+            else
+            {
+                openBus = readBuffer;
+                readBuffer = Read( address );
+            }
+            vramAddress += ( control & VRAM_INCREMENT_BIT ) ? 32 : 1;
+        }
+        break;
+
+        default:
+        {
+            // Write only registers return the open bus
+        }
+    }
+
+    return openBus;
+}
+
+void Video::WriteRegister( word ppuRegister, byte data )
+{
+    openBus = data;
+
+    switch ( ppuRegister )
+    {
+        case PPUCTRL_REGISTER:
+        {
+            /* Enabling the NMI during the vblank triggers it right away */
+            const bool wasNmiEnabled = ( control & NMI_ENABLE_BIT ) != 0;
+            control = data;
+            temporaryVramAddress = ( temporaryVramAddress & ~( NAMETABLE_X_BIT | NAMETABLE_Y_BIT ) ) | ( ( data & NAMETABLE_SELECT_MASK ) << 10 );
+
+            if ( !wasNmiEnabled && ( control & NMI_ENABLE_BIT ) && ( status & VBLANK_FLAG ) )
+            {
+                cpu->RaiseNmi();
+            }
+        }
+        break;
+
+        case PPUMASK_REGISTER:
+        {
+            mask = data;
+        }
+        break;
+
+        case OAMA_REGISTER:
+        {
+            oamAddress = data;
+        }
+        break;
+
+        case OAMADATA_REGISTER:
+        {
+            oam[ oamAddress++ ] = data;
+            dirtyMemory |= OAM_DIRTY;
+        }
+        break;
+
+        case PPUSCROLL_REGISTER:
+        {
+            if ( !isSecondWrite )
+            {
+                temporaryVramAddress = ( temporaryVramAddress & ~COARSE_X_MASK ) | ( data >> 3 );
+                fineX = data & 0b0000'0111;
+            }
+            else
+            {
+                temporaryVramAddress = ( temporaryVramAddress & ~( FINE_Y_MASK | COARSE_Y_MASK ) ) | ( ( data & 0b0000'0111 ) << 12 ) | ( ( data & 0b1111'1000 ) << 2 );
+            }
+            isSecondWrite = !isSecondWrite;
+        }
+        break;
+
+        case PPUADDR_REGISTER:
+        {
+            if ( !isSecondWrite )
+            {
+                /* The 6 upper bits of the address, bit 14 of t is cleared */
+                temporaryVramAddress = ( temporaryVramAddress & 0x00FF ) | ( ( data & 0b0011'1111 ) << 8 );
+            }
+            else
+            {
+                temporaryVramAddress = ( temporaryVramAddress & 0xFF00 ) | data;
+                vramAddress = temporaryVramAddress;
+            }
+            isSecondWrite = !isSecondWrite;
+        }
+        break;
+
+        case PPUDATA_ADDRESS:
+        {
+            if ( memoryHeatmap != nullptr )
+            {
+                memoryHeatmap->LogPpuWrite( vramAddress & PPU_ADDRESS_MASK );
+            }
+            Write( vramAddress, data );
+            vramAddress += ( control & VRAM_INCREMENT_BIT ) ? 32 : 1;
+        }
+        break;
+
+        default:
+        {
+            // PPUSTATUS is read only
+        }
+    }
+}
+
+byte Video::PeekRegister( word ppuRegister ) const
+{
+    switch ( ppuRegister )
+    {
+        case PPUCTRL_REGISTER:      { return control; }
+        case PPUMASK_REGISTER:      { return mask; }
+        case PPUSTATUS_REGISTER:    { return ( status & 0b1110'0000 ) | ( openBus & 0b0001'1111 ); }
+        case OAMA_REGISTER:         { return oamAddress; }
+        case OAMADATA_REGISTER:     { return oam[ oamAddress ]; }
+        case PPUDATA_ADDRESS:       { return readBuffer; }
+        default:                    { return openBus; }
+    }
+}
+
+const byte * const Video::GetOAM() const
+{
+    return oam;
+}
+
+void Video::WriteOAMDMA( const byte *page )
+{
+    /* The copy starts at OAMADDR and wraps around, most games set it to 0 first */
+    const u32 firstPart = OAM_SIZE - oamAddress;
+    memcpy( &oam[ oamAddress ], page, firstPart );
+    memcpy( oam, &page[ firstPart ], oamAddress );
+    dirtyMemory |= OAM_DIRTY;
+}
+
+u32 Video::GetCurrentScanline() const
+{
+    return ( cpuCycles * 3 ) / CYCLE_DURATION_PER_SCANLINE;
+}
+
+u32 Video::GetCurrentDot() const
+{
+    return ( cpuCycles * 3 ) % CYCLE_DURATION_PER_SCANLINE;
+}
+
+void Video::CatchUp()
 {
     // 1 CPU Cycles = 3 PPU cycle
-    ppuCycles = cycles * 3;
-    currentScanline = ppuCycles / CYCLE_DURATION_PER_SCANLINE;
+    const u32 targetCycles = cpuCycles * 3;
 
-    if ( currentScanline == VBLANK_SCANLINE )
+    /* Whole scanlines are rendered at once, a scanline in progress is rendered once it is completed */
+    while ( currentScanline < MAX_SCANLINES_PER_FRAME )
     {
-        memory->Write( PPUSTATUS_REGISTER, memory->Read( PPUSTATUS_REGISTER ) & 0b1000'0000 );
+        const u32 scanlineEnd = ( currentScanline + 1 ) * CYCLE_DURATION_PER_SCANLINE;
+        if ( scanlineEnd > targetCycles )
+        {
+            break;
+        }
+
+        FinishScanline( currentScanline );
+
+        ppuCycles = scanlineEnd;
+        ++currentScanline;
+        StartScanline( currentScanline );
+    }
+
+    ppuCycles = ( targetCycles > ppuCycles ) ? targetCycles : ppuCycles;
+}
+
+void Video::EndFrame()
+{
+    /* The emulator frame is a bit shorter than the PPU one, complete the pre-render scanline as well */
+    cpuCycles = ( MAX_SCANLINES_PER_FRAME * CYCLE_DURATION_PER_SCANLINE + 2 ) / 3;
+    CatchUp();
+
+    if ( renderPipeline != nullptr )
+    {
+        renderPipeline->SubmitFrame();
+    }
+
+    cpuCycles = 0u;
+    nextEventCycle = VBLANK_EVENT_CYCLE;
+    ppuCycles = 0u;
+    currentScanline = 0u;
+}
+
+void Video::StartScanline( u32 scanline )
+{
+    if ( scanline == VBLANK_SCANLINE )
+    {
+        status |= VBLANK_FLAG;
+        nextEventCycle = NO_EVENT;
+
+        if ( control & NMI_ENABLE_BIT )
+        {
+            cpu->RaiseNmi();
+        }
     }
-    
-    if ( currentScanline == MAX_SCANLINES_PER_FRAME )
+    else if ( scanline == PRERENDER_SCANLINE )
     {
-        // Reset everything
-        ppuCycles = 0u;
-        currentScanline = 0u;
+        status &= ~( VBLANK_FLAG | SPRITE_0_HIT_FLAG | SPRITE_OVERFLOW_FLAG );
     }
 }
+
+void Video::FinishScanline( u32 scanline )
+{
+    if ( scanline < NES_VIDEO_HEIGHT )
+    {
+        const ScanlineState state = GetScanlineState();
+        const MemoryView view = GetMemoryView();
+        if ( renderPipeline != nullptr )
+        {
+            /* The pipeline draws it later on another thread, only the flags the CPU can read are needed now */
+            renderPipeline->RecordScanline( scanline, state, view, dirtyMemory );
+            dirtyMemory = 0;
+            status |= EvaluateSpriteFlags( scanline, state, view );
+        }
+        else
+        {
+            /* Only the palette indices are written here, the RGB frame buffer is converted when it is read */
+            byte *paletteIndices = &indexedFrameBuffer[ scanline * NES_VIDEO_WIDTH ];
+            status |= RenderScanline( scanline, state, view, paletteIndices );
+            scanlineEmphasis[ scanline ] = mask >> EMPHASIS_SHIFT;
+            isFrameBufferStale = true;
+
+            if ( ntscFilter != nullptr )
+            {
+                ntscFilter->FilterScanline( scanline, paletteIndices, scanlineEmphasis[ scanline ] );
+            }
+        }
+    }
+
+    if ( !IsRenderingEnabled() || ( scanline >= NES_VIDEO_HEIGHT && scanline != PRERENDER_SCANLINE ) )
+    {
+        return;
+    }
+
+    /* What the PPU does to v at dots 256 and 257, and from 280 to 304 of the pre-render scanline */
+    IncrementVerticalPosition();
+    vramAddress = ( vramAddress & ~HORIZONTAL_BITS ) | ( temporaryVramAddress & HORIZONTAL_BITS );
+    if ( scanline == PRERENDER_SCANLINE )
+    {
+        vramAddress = ( vramAddress & ~VERTICAL_BITS ) | ( temporaryVramAddress & VERTICAL_BITS );
+    }
+}
+
+Video::ScanlineState Video::GetScanlineState() const
+{
+    return { vramAddress, fineX, control, mask };
+}
+
+Video::MemoryView Video::GetMemoryView() const
+{
+    return { map, { nametables[ 0 ], nametables[ 1 ], nametables[ 2 ], nametables[ 3 ] }, &map[ PALETTE_ADDRESS ], oam };
+}
+
+bool Video::IsRenderingEnabled() const
+{
+    return ( mask & ( SHOW_BACKGROUND_BIT | SHOW_SPRITES_BIT ) ) != 0;
+}
+
+void Video::IncrementVerticalPosition()
+{
+    if ( ( vramAddress & FINE_Y_MASK ) != FINE_Y_MASK )
+    {
+        vramAddress += 0x1000;
+        return;
+    }
+
+    /* Fine Y overflows into coarse Y, which wraps to the next nametable after the 30 rows */
+    vramAddress &= ~FINE_Y_MASK;
+    u32 coarseY = ( vramAddress & COARSE_Y_MASK ) >> 5;
+    if ( coarseY == 29 )
+    {
+        coarseY = 0;
+        vramAddress ^= NAMETABLE_Y_BIT;
+    }
+    else if ( coarseY == 31 )
+    {
+        /* Rows 30 and 31 are the attribute table, they wrap without switching nametables */
+        coarseY = 0;
+    }
+    else
+    {
+        ++coarseY;
+    }
+    vramAddress = ( vramAddress & ~COARSE_Y_MASK ) | ( coarseY << 5 );
+}
+
+byte Video::RenderScanline( u32 scanline, const ScanlineState &state, const MemoryView &view, byte *paletteIndices )
+{
+    byte flags = 0;
+
+    /* Background pixels: palette << 2 | color, 0 is transparent */
+    byte backgroundPixels[ NES_VIDEO_WIDTH ] = {};
+    if ( state.mask & SHOW_BACKGROUND_BIT )
+    {
+        const byte *patternTable = &view.patternTables[ ( state.control & BACKGROUND_PATTERN_TABLE_BIT ) ? 0x1000 : 0x0000 ];
+        const u32 fineY = ( state.vramAddress & FINE_Y_MASK ) >> 12;
+
+        /* 33 tiles are fetched so the fine X scroll can shift the line by up to 7 pixels */
+        word tileAddress = state.vramAddress;
+        for ( u32 tileColumn = 0; tileColumn <= NES_VIDEO_WIDTH / 8; ++tileColumn )
+        {
+            const byte *nametable = view.nametables[ ( tileAddress >> 10 ) & 0x03 ];
+            const word attributeAddress = 0x03C0 | ( ( tileAddress >> 4 ) & 0x38 ) | ( ( tileAddress >> 2 ) & 0x07 );
+            const byte attributeShift = ( ( tileAddress >> 4 ) & 0x04 ) | ( tileAddress & 0x02 );
+
+            const byte tile = nametable[ tileAddress & 0x03FF ];
+            const byte palette = ( nametable[ attributeAddress ] >> attributeShift ) & 0x03;
+            const byte lowPlane = patternTable[ tile * 16 + fineY ];
+            const byte highPlane = patternTable[ tile * 16 + fineY + 8 ];
+
+            for ( u32 pixel = 0; pixel < 8; ++pixel )
+            {
+                const i32 screenX = static_cast< i32 >( tileColumn * 8 + pixel ) - state.fineX;
+                if ( screenX < 0 || screenX >= static_cast< i32 >( NES_VIDEO_WIDTH ) )
+                {
+                    continue;
+                }
+
+                const u32 bit = 7 - pixel;
+                const byte color = ( ( lowPlane >> bit ) & 0x01 ) | ( ( ( highPlane >> bit ) & 0x01 ) << 1 );
+                backgroundPixels[ screenX ] = color ? ( palette << 2 ) | color : 0;
+            }
+
+            tileAddress = AddCoarseX( tileAddress, 1 );
+        }
+
+        if ( !( state.mask & SHOW_LEFT_BACKGROUND_BIT ) )
+        {
+            memset( backgroundPixels, 0, 8 );
+        }
+    }
+
+    byte spritePixels[ NES_VIDEO_WIDTH ] = {};
+    if ( state.mask & SHOW_SPRITES_BIT )
+    {
+        const u32 spriteHeight = ( state.control & TALL_SPRITES_BIT ) ? 16 : 8;
+        const u32 firstVisibleX = ( state.mask & SHOW_LEFT_SPRITES_BIT ) ? 0 : 8;
+
+        u32 spriteCount = 0;
+        for ( u32 sprite = 0; sprite < OAM_SIZE / 4; ++sprite )
+        {
+            const byte *entry = &view.oam[ sprite * 4 ];
+
+            /* Sprites are drawn one scanline below their Y coordinate */
+            const i32 row = static_cast< i32 >( scanline ) - entry[ 0 ] - 1;
+            if ( row < 0 || row >= static_cast< i32 >( spriteHeight ) )
+            {
+                continue;
+            }
+
+            if ( spriteCount == MAX_SPRITES_PER_SCANLINE )
+            {
+                flags |= SPRITE_OVERFLOW_FLAG;
+                break;
+            }
+            ++spriteCount;
+
+            const byte attributes = entry[ 2 ];
+            const u32 x = entry[ 3 ];
+            const word tileAddress = GetSpritePatternAddress( entry, row, spriteHeight, state.control );
+            const byte lowPlane = view.patternTables[ tileAddress ];
+            const byte highPlane = view.patternTables[ tileAddress + 8 ];
+            const byte palette = attributes & 0x03;
+            const byte priority = ( attributes & 0b0010'0000 ) ? SPRITE_BEHIND_BACKGROUND : 0;
+
+            for ( u32 pixel = 0; pixel < 8 && x + pixel < NES_VIDEO_WIDTH; ++pixel )
+            {
+                const u32 bit = ( attributes & 0b0100'0000 ) ? pixel : 7 - pixel;
+                const byte color = ( ( lowPlane >> bit ) & 0x01 ) | ( ( ( highPlane >> bit ) & 0x01 ) << 1 );
+                const u32 screenX = x + pixel;
+
+                /* Lower OAM indexes win, even over higher priority sprites */
+                if ( color == 0 || screenX < firstVisibleX || spritePixels[ screenX ] != 0 )
+                {
+                    continue;
+                }
+                spritePixels[ screenX ] = priority | ( palette << 2 ) | color;
+
+                if ( sprite == 0 && backgroundPixels[ screenX ] != 0 && screenX != 255 )
+                {
+                    flags |= SPRITE_0_HIT_FLAG;
+                }
+            }
+        }
+    }
+
+    /* The greyscale mode keeps the column of grays of every palette entry */
+    const byte colorMask = ( state.mask & GREYSCALE_BIT ) ? 0x30 : 0x3F;
+    for ( u32 x = 0; x < NES_VIDEO_WIDTH; ++x )
+    {
+        const byte background = backgroundPixels[ x ];
+        const byte sprite = spritePixels[ x ];
+
+        byte paletteIndex = 0x00;
+        if ( sprite != 0 && ( background == 0 || !( sprite & SPRITE_BEHIND_BACKGROUND ) ) )
+        {
+            paletteIndex = 0x10 + ( sprite & 0x0F );
+        }
+        else if ( background != 0 )
+        {
+            paletteIndex = background;
+        }
+
+        paletteIndices[ x ] = view.palettes[ paletteIndex ] & colorMask;
+    }
+
+    return flags;
+}
+
+void Video::ConvertToRGB( const byte *paletteIndices, byte emphasis, RGB *line )
+{
+    const RGB *colors = EMPHASIS_PALETTES.colors[ emphasis & 0x07 ];
+    for ( u32 x = 0; x < NES_VIDEO_WIDTH; ++x )
+    {
+        line[ x ] = colors[ paletteIndices[ x ] ];
+    }
+}
+
+byte Video::EvaluateSpriteFlags( u32 scanline, const ScanlineState &state, const MemoryView &view )
+{
+    if ( !( state.mask & SHOW_SPRITES_BIT ) )
+    {
+        return 0;
+    }
+
+    byte flags = 0;
+    const u32 spriteHeight = ( state.control & TALL_SPRITES_BIT ) ? 16 : 8;
+
+    u32 spriteCount = 0;
+    for ( u32 sprite = 0; sprite < OAM_SIZE / 4; ++sprite )
+    {
+        const u32 row = scanline - view.oam[ sprite * 4 ] - 1;
+        if ( row < spriteHeight && spriteCount++ == MAX_SPRITES_PER_SCANLINE )
+        {
+            flags |= SPRITE_OVERFLOW_FLAG;
+            break;
+        }
+    }
+
+    /* Sprite 0 is always drawn when it is on the scanline, only the background under its 8 pixels matters */
+    const i32 row = static_cast< i32 >( scanline ) - view.oam[ 0 ] - 1;
+    if ( !( state.mask & SHOW_BACKGROUND_BIT ) || row < 0 || row >= static_cast< i32 >( spriteHeight ) )
+    {
+        return flags;
+    }
+
+    const byte attributes = view.oam[ 2 ];
+    const u32 x = view.oam[ 3 ];
+    const word spriteAddress = GetSpritePatternAddress( view.oam, row, spriteHeight, state.control );
+    const u32 firstVisibleX = ( ( state.mask & SHOW_LEFT_SPRITES_BIT ) && ( state.mask & SHOW_LEFT_BACKGROUND_BIT ) ) ? 0 : 8;
+    const byte *patternTable = &view.patternTables[ ( state.control & BACKGROUND_PATTERN_TABLE_BIT ) ? 0x1000 : 0x0000 ];
+    const u32 fineY = ( state.vramAddress & FINE_Y_MASK ) >> 12;
+
+    for ( u32 pixel = 0; pixel < 8 && x + pixel < NES_VIDEO_WIDTH - 1; ++pixel )
+    {
+        const u32 spriteBit = ( attributes & 0b0100'0000 ) ? pixel : 7 - pixel;
+        const u32 screenX = x + pixel;
+        if ( screenX < firstVisibleX || ( ( ( view.patternTables[ spriteAddress ] | view.patternTables[ spriteAddress + 8 ] ) >> spriteBit ) & 0x01 ) == 0 )
+        {
+            continue;
+        }
+
+        const u32 scrolledX = screenX + state.fineX;
+        const word tileAddress = AddCoarseX( state.vramAddress, scrolledX / 8 );
+        const byte tile = view.nametables[ ( tileAddress >> 10 ) & 0x03 ][ tileAddress & 0x03FF ];
+        const u32 backgroundBit = 7 - ( scrolledX % 8 );
+        if ( ( ( ( patternTable[ tile * 16 + fineY ] | patternTable[ tile * 16 + fineY + 8 ] ) >> backgroundBit ) & 0x01 ) != 0 )
+        {
+            flags |= SPRITE_0_HIT_FLAG;
+            break;
+        }
+    }
+
+    return flags;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Types.h"
+#include "Cartridge.h"
 
 /*
 
@@ -42,8 +43,11 @@
 */
 
 
-class Cartridge;
 class Memory;
+class Cpu;
+class RenderPipeline;
+class NtscFilter;
+class MemoryHeatmap;
 
 class Video
 {
@@ -56,6 +60,7 @@ public:
 
     /* NES tiles and objects constants */
     static constexpr u32 NES_PATTERN_TILE_AMOUNT        = 256;
+    static constexpr u32 OAM_SIZE                       = 256;
     static constexpr u32 MAX_SCANLINES_PER_FRAME        = 262;
     static constexpr u32 CYCLE_DURATION_PER_SCANLINE    = 341;
     static constexpr u32 POSTRENDER_SCANLINE            = 241;
@@ -71,36 +76,197 @@ public:
     static constexpr word PPUADDR_REGISTER              = 0x2006;
     static constexpr word PPUDATA_ADDRESS               = 0x2007;
 
+    /* PPUSTATUS flags */
+    static constexpr byte VBLANK_FLAG                   = 0b1000'0000;
+    static constexpr byte SPRITE_0_HIT_FLAG             = 0b0100'0000;
+    static constexpr byte SPRITE_OVERFLOW_FLAG          = 0b0010'0000;
 
-    Video( Cartridge *cartridge );
+    /* PPUMASK emphasis bits, red, green and blue from the lowest once shifted */
+    static constexpr u32 EMPHASIS_SHIFT                 = 5;
+
+    /* Parts of the PPU memory written since the last scanline was rendered */
+    static constexpr byte PATTERN_TABLES_DIRTY          = 0b0000'0001;
+    static constexpr byte NAMETABLES_DIRTY              = 0b0000'0010;
+    static constexpr byte PALETTES_DIRTY                = 0b0000'0100;
+    static constexpr byte OAM_DIRTY                     = 0b0000'1000;
+    static constexpr byte ALL_MEMORY_DIRTY              = 0b0000'1111;
+
+    /* Registers a scanline is rendered with, v is the address at the start of the scanline */
+    struct ScanlineState
+    {
+        word    vramAddress;
+        byte    fineX;
+        byte    control;
+        byte    mask;
+    };
+
+    /* PPU memory a scanline is rendered from, either the live PPU or a RenderPipeline snapshot */
+    struct MemoryView
+    {
+        const byte  *patternTables;     /* 8KB */
+        const byte  *nametables[ 4 ];   /* 1KB each, mirroring already applied */
+        const byte  *palettes;          /* 0x3F00 - 0x3F1F */
+        const byte  *oam;
+    };
+
+
+    Video( const Cartridge *cartridge );
     ~Video();
 
-    void Init( Memory *memorySystem );
+    void Init( Memory *memorySystem, Cpu *cpuSystem );
     void Reset();
 
+    /* Reset button, the registers and the frame timing are reset but the VRAM, palettes and OAM are kept */
+    void SoftReset();
+
+    /* Accounts the CPU cycles of the last instruction, nothing is rendered until the PPU is observed or the vblank starts */
     void Update( u32 cycles );
 
-    /* PPU memory management */
+    /* Renders up to the current cycle, must be called before the CPU or a mapper observes or changes the PPU state */
+    void CatchUp();
+
+    /* Renders the rest of the frame and starts the next one */
+    void EndFrame();
+
+    /* Current position of the PPU in the frame */
+    u32 GetCurrentScanline() const;
+    u32 GetCurrentDot() const;
+
+    /* CPU interface, 0x2000 - 0x2007 */
+    byte ReadRegister( word ppuRegister );
+    void WriteRegister( word ppuRegister, byte data );
+
+    /* Reads a register without side effects, for debugging tools */
+    byte PeekRegister( word ppuRegister ) const;
+
+    /* PPU memory management, nametables and palettes are mirrored */
     const byte * const GetPPUMemory() const;
     byte Read( word address ) const;
     void Write( word address, byte data );
 
-    /* Frame buffer */
+    /* Points the four nametables to the internal VRAM, mappers may change it at any time */
+    void SetMirroring( Cartridge::MirroringType mirroring );
+
+    /* Object attribute memory, 64 sprites of 4 bytes */
+    const byte * const GetOAM() const;
+
+    /* Copies a whole 256 bytes CPU page at once, starting at the current OAM address */
+    void WriteOAMDMA( const byte *page );
+
+    /*
+        Frame buffer, converted from the indexed frame buffer when it changed since the last call.
+        With a render pipeline the frame buffers hold the last submitted frame, these wait for it.
+     */
     RGB* GetFrameBuffer() const;
 
+    /* One 6 bit palette index per pixel plus the PPUMASK emphasis bits of every scanline, what the PPU really outputs */
+    const byte* GetIndexedFrameBuffer() const;
+    const byte* GetScanlineEmphasis() const;
+
+    /* Hash of the indexed frame buffer and the emphasis, for regression tests and frame deduplication */
+    u64 GetFrameHash() const;
+
+    /* Scanlines are recorded into the pipeline instead of being drawn into the frame buffer, nullptr draws them again */
+    void SetRenderPipeline( RenderPipeline *pipeline );
+
+    /* Also decodes every scanline drawn into the frame buffer as a composite video signal, nullptr stops it */
+    void SetNtscFilter( NtscFilter *filter );
+
+    /* Counts the PPU memory accessed through PPUDATA while a heatmap is set, nullptr disables it */
+    void SetMemoryHeatmap( MemoryHeatmap *heatmap );
+
+    /*
+        Draws one scanline as 6 bit palette indices and returns the PPUSTATUS sprite flags it raised.
+        It only reads its arguments so any thread can call it.
+     */
+    static byte RenderScanline( u32 scanline, const ScanlineState &state, const MemoryView &view, byte *paletteIndices );
+    static void ConvertToRGB( const byte *paletteIndices, byte emphasis, RGB *line );
+
+    /* Same flags as RenderScanline without drawing, only the sprites and the background under sprite 0 are decoded */
+    static byte EvaluateSpriteFlags( u32 scanline, const ScanlineState &state, const MemoryView &view );
+
 private:
     /* Associated Systems */
-    Cartridge       *cartridge;
+    const Cartridge *cartridge;
     Memory          *memory;
+    Cpu             *cpu;
 
-    /* PPU memory layout */
+    /* PPU memory layout, the nametable area of the map is unused */
     byte            *map;
 
+    /* 2KB of console VRAM, plus 2KB from the cartridge for four screen games */
+    byte            nametableRam[ 4_KB ];
+    byte            *nametables[ 4 ];
+
+    /* Sprites */
+    byte            oam[ OAM_SIZE ];
+    byte            oamAddress;
+
     /* Frame buffer */
+    byte            *indexedFrameBuffer;
+    mutable byte    scanlineEmphasis[ NES_VIDEO_HEIGHT ];
     RGB             *frameBuffer;
+    mutable bool    isFrameBufferStale;
+    RenderPipeline  *renderPipeline;
+    mutable u64     copiedPipelineFrames;
+    NtscFilter      *ntscFilter;
+    MemoryHeatmap   *memoryHeatmap;
+    byte            dirtyMemory;
+
+    /* Registers */
+    byte            control;
+    byte            mask;
+    byte            status;
+
+    /* Last value seen on the CPU data bus, returned by the write only registers */
+    byte            openBus;
 
+    /* PPUDATA reads outside of the palettes return the previous value read */
+    byte            readBuffer;
+
+    /*
+        Internal registers shared by scrolling and PPUADDR:
+            v: current VRAM address, 0yyy NNYY YYYX XXXX ( fine Y, nametable, coarse Y, coarse X )
+            t: temporary VRAM address, the address v is reloaded from
+            x: fine X scroll
+            w: first or second write toggle of PPUSCROLL and PPUADDR
+     */
+    word            vramAddress;
+    word            temporaryVramAddress;
+    byte            fineX;
+    bool            isSecondWrite;
+
+    /* CPU cycles since the start of the frame, the PPU has only been rendered up to ppuCycles */
+    u32             cpuCycles;
+    u32             nextEventCycle;
     u32             ppuCycles;
     u32             currentScanline;
 
     void MapCartridgeCHRToPPU();
-};
\ No newline at end of file
+    byte ReadNametable( word address ) const;
+    void StartScanline( u32 scanline );
+    void FinishScanline( u32 scanline );
+    /* Copies the palette indices of the last frame the pipeline completed into the indexed frame buffer */
+    void CopyPipelineFrame() const;
+    ScanlineState GetScanlineState() const;
+    MemoryView GetMemoryView() const;
+    bool IsRenderingEnabled() const;
+    void IncrementVerticalPosition();
+};
+
+
+inline void Video::Update( u32 cycles )
+{
+    cpuCycles += cycles;
+
+    /* The start of the vblank is the only thing the CPU can notice without accessing the PPU */
+    if ( cpuCycles >= nextEventCycle )
+    {
+        CatchUp();
+    }
+}
+
+inline byte Video::ReadNametable( word address ) const
+{
+    return nametables[ ( address >> 10 ) & 0x03 ][ address & 0x03FF ];
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "WavWriter.h"
+
+#include <assert.h>
+
+
+namespace
+{
+    constexpr u32 RIFF_SIZE_OFFSET  = 4;
+    constexpr u32 DATA_SIZE_OFFSET  = 40;
+    constexpr u32 HEADER_SIZE       = 44;
+    constexpr u16 PCM_FORMAT        = 1;
+    constexpr u16 BITS_PER_SAMPLE   = 16;
+
+    void WriteU32( FILE *file, u32 value )
+    {
+        fwrite( &value, sizeof( value ), 1, file );
+    }
+
+    void WriteU16( FILE *file, u16 value )
+    {
+        fwrite( &value, sizeof( value ), 1, file );
+    }
+}
+
+
+WavWriter::WavWriter()
+    : file( nullptr )
+    , dataSize( 0u )
+{
+}
+
+WavWriter::~WavWriter()
+{
+    Close();
+}
+
+bool WavWriter::TryOpen( const char *fileName, u32 sampleRate, u16 channels )
+{
+    assert( file == nullptr );
+
+    file = fopen( fileName, "wb" );
+    if ( file == nullptr )
+    {
+        return false;
+    }
+
+    dataSize = 0u;
+    WriteHeader( sampleRate, channels );
+    return true;
+}
+
+bool WavWriter::IsOpen() const
+{
+    return file != nullptr;
+}
+
+bool WavWriter::Write( const i16 *samples, u32 count )
+{
+    assert( file != nullptr );
+
+    const size_t written = fwrite( samples, sizeof( i16 ), count, file );
+    dataSize += static_cast< u32 >( written * sizeof( i16 ) );
+    return written == count;
+}
+
+void WavWriter::Close()
+{
+    if ( file == nullptr )
+    {
+        return;
+    }
+
+    /* Now that the amount of samples is known patch the chunk sizes */
+    fseek( file, RIFF_SIZE_OFFSET, SEEK_SET );
+    WriteU32( file, HEADER_SIZE - 8 + dataSize );
+    fseek( file, DATA_SIZE_OFFSET, SEEK_SET );
+    WriteU32( file, dataSize );
+
+    fclose( file );
+    file = nullptr;
+}
+
+void WavWriter::WriteHeader( u32 sampleRate, u16 channels )
+{
+    const u16 blockAlign = channels * ( BITS_PER_SAMPLE / 8 );
+
+    fwrite( "RIFF", 4, 1, file );
+    WriteU32( file, 0u );
+    fwrite( "WAVE", 4, 1, file );
+
+    fwrite( "fmt ", 4, 1, file );
+    WriteU32( file, 16u );
+    WriteU16( file, PCM_FORMAT );
+    WriteU16( file, channels );
+    WriteU32( file, sampleRate );
+    WriteU32( file, sampleRate * blockAlign );
+    WriteU16( file, blockAlign );
+    WriteU16( file, BITS_PER_SAMPLE );
+
+    fwrite( "data", 4, 1, file );
+    WriteU32( file, 0u );
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdio>
+
+#include "Types.h"
+
+
+/*
+    Headless audio sink, writes 16 bit PCM samples to a RIFF WAVE file. The sizes in the
+    header are patched when the file is closed.
+ */
+
+class WavWriter
+{
+public:
+
+    WavWriter();
+    WavWriter( WavWriter & ) = delete;
+    ~WavWriter();
+
+    bool TryOpen( const char *fileName, u32 sampleRate, u16 channels );
+    bool IsOpen() const;
+    bool Write( const i16 *samples, u32 count );
+    void Close();
+
+private:
+
+    FILE    *file;
+    u32     dataSize;
+
+    void WriteHeader( u32 sampleRate, u16 channels );
+};
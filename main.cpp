@@ -1,10 +1,23 @@
+#include <algorithm>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
 
 #include "Cartridge.h"
-#include "Memory.h"
-#include "Cpu.h"
+#include "Emulator.h"
 #include "CpuTypes.h"
-#include "Video.h"
+#include "SharedFrameRing.h"
+#include "InstructionTracer.h"
+#include "WavWriter.h"
+#include "NtscFilter.h"
+#include "RenderPipeline.h"
+#include "FrameRecorder.h"
+#include "CodeDataLogger.h"
+#include "CycleProfiler.h"
+#include "MemoryHeatmap.h"
 #include "Debugger/Debugger.h"
 
 #include <assert.h>
@@ -14,7 +27,8 @@ int main(int argc, char** argv)
 {
     if ( argc < 2 )
     {
-        std::cout << "Please provide the rom path";
+        std::cout << "Please provide the rom path\n"
+            << "Usage: PatNes <rom> [--shm <shared memory name>] [--trace <binary trace file>] [--wav <audio dump file>] [--filter ntsc] [--scale <1-4>] [--upscaler <nearest|scale2x|scale3x|hqx|xbr>] [--post-process <none|scanlines>] [--capture <delta capture file>] [--capture-y4m <y4m file>] [--cdl <code/data log file>] [--profile <profile report file>] [--heatmap]";
         return -1;
     }
 
@@ -28,20 +42,242 @@ int main(int argc, char** argv)
 
     cartridge.PrintDetails();
 
-    Video video( &cartridge );
-    Memory memory( &cartridge, &video );
-    video.Init( &memory );
-    Cpu cpu( &memory );
+    Emulator emulator( &cartridge );
 
-    Debugger debugger( &cpu, &memory, &video );
+    /* Battery backed games keep their PRG RAM in a save file next to the rom */
+    if ( cartridge.GetHeader().hasPersistentMemory )
+    {
+        const std::string romFileName = argv[ 1 ];
+        const size_t extension = romFileName.find_last_of( '.' );
+        const size_t directory = romFileName.find_last_of( "/\\" );
+        const bool hasExtension = extension != std::string::npos && ( directory == std::string::npos || extension > directory );
+        const std::string saveFileName = ( hasExtension ? romFileName.substr( 0, extension ) : romFileName ) + ".sav";
+        if ( !emulator.GetMemory().TryAttachSaveFile( saveFileName.c_str() ) )
+        {
+            std::cout << "The save file " << saveFileName << " couldn't be opened, the game won't be saved\n";
+        }
+    }
+
+    /* Optionally publish every completed frame for out of process consumers */
+    std::unique_ptr< SharedFramePublisher > framePublisher;
+    const char *sharedMemoryName = nullptr;
+
+    /* Optionally decode the frames as a composite video signal, the published frames are then wider */
+    std::unique_ptr< NtscFilter > ntscFilter;
+
+    /* Optionally draw the frames on worker threads, upscaled and post-processed, the published and captured frames are then that size */
+    std::unique_ptr< RenderPipeline > renderPipeline;
+    bool isRenderPipelineUsed = false;
+    u32 renderScale = 1;
+    Upscaler::Filter upscalerFilter = Upscaler::Filter::Nearest;
+    RenderPipeline::PostProcess postProcess = RenderPipeline::PostProcess::None;
+
+    /* Optionally keep the last instructions executed and dump them when the emulator quits */
+    std::unique_ptr< InstructionTracer > tracer;
+    const char *traceFileName = nullptr;
+
+    /* Optionally dump the audio output, without any rate control so the file is deterministic */
+    WavWriter wavWriter;
+
+    /* Optionally record every frame and its audio, the Y4m audio goes to the same file name plus .wav */
+    std::unique_ptr< FrameRecorder > frameRecorder;
+    FrameRecorder::Format captureFormat = FrameRecorder::Format::Delta;
+    const char *captureFileName = nullptr;
+
+    /* Optionally log which PRG bytes run as code and which are read as data, exported as a .cdl file when the emulator quits */
+    std::unique_ptr< CodeDataLogger > codeDataLogger;
+    const char *codeDataLogFileName = nullptr;
+
+    /* Optionally count the cycles spent per instruction and per function, reported as text when the emulator quits */
+    std::unique_ptr< CycleProfiler > cycleProfiler;
+    const char *profileFileName = nullptr;
+
+    /* Optionally count the accesses to every byte for the heatmap of the memory debugger, the only flag without a value */
+    std::unique_ptr< MemoryHeatmap > memoryHeatmap;
+    for ( i32 i = 2; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--heatmap" ) == 0 )
+        {
+            memoryHeatmap = std::make_unique< MemoryHeatmap >();
+            emulator.SetMemoryHeatmap( memoryHeatmap.get() );
+        }
+    }
+
+    for ( i32 i = 2; i + 1 < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--trace" ) == 0 )
+        {
+            static constexpr u32 TRACE_CAPACITY = 1 << 20;
+            traceFileName = argv[ i + 1 ];
+            tracer = std::make_unique< InstructionTracer >( TRACE_CAPACITY, &emulator.GetVideo() );
+            emulator.SetTracer( tracer.get() );
+        }
+        else if ( strcmp( argv[ i ], "--shm" ) == 0 )
+        {
+            sharedMemoryName = argv[ i + 1 ];
+        }
+        else if ( strcmp( argv[ i ], "--filter" ) == 0 )
+        {
+            if ( strcmp( argv[ i + 1 ], "ntsc" ) != 0 )
+            {
+                std::cout << "Unknown video filter " << argv[ i + 1 ];
+                return -1;
+            }
+            ntscFilter = std::make_unique< NtscFilter >();
+            emulator.GetVideo().SetNtscFilter( ntscFilter.get() );
+        }
+        else if ( strcmp( argv[ i ], "--scale" ) == 0 )
+        {
+            isRenderPipelineUsed = true;
+            renderScale = static_cast< u32 >( strtoul( argv[ i + 1 ], nullptr, 10 ) );
+        }
+        else if ( strcmp( argv[ i ], "--upscaler" ) == 0 )
+        {
+            isRenderPipelineUsed = true;
+            u32 filter = 0;
+            while ( filter < static_cast< u32 >( Upscaler::Filter::Count ) && strcmp( argv[ i + 1 ], Upscaler::FilterString[ filter ] ) != 0 )
+            {
+                ++filter;
+            }
+            if ( filter == static_cast< u32 >( Upscaler::Filter::Count ) )
+            {
+                std::cout << "Unknown upscaler " << argv[ i + 1 ];
+                return -1;
+            }
+            upscalerFilter = static_cast< Upscaler::Filter >( filter );
+        }
+        else if ( strcmp( argv[ i ], "--post-process" ) == 0 )
+        {
+            isRenderPipelineUsed = true;
+            if ( strcmp( argv[ i + 1 ], "none" ) == 0 )
+            {
+                postProcess = RenderPipeline::PostProcess::None;
+            }
+            else if ( strcmp( argv[ i + 1 ], "scanlines" ) == 0 )
+            {
+                postProcess = RenderPipeline::PostProcess::Scanlines;
+            }
+            else
+            {
+                std::cout << "Unknown post-process " << argv[ i + 1 ];
+                return -1;
+            }
+        }
+        else if ( strcmp( argv[ i ], "--capture" ) == 0 || strcmp( argv[ i ], "--capture-y4m" ) == 0 )
+        {
+            captureFileName = argv[ i + 1 ];
+            captureFormat = ( strcmp( argv[ i ], "--capture" ) == 0 ) ? FrameRecorder::Format::Delta : FrameRecorder::Format::Y4m;
+        }
+        else if ( strcmp( argv[ i ], "--cdl" ) == 0 )
+        {
+            codeDataLogFileName = argv[ i + 1 ];
+            codeDataLogger = std::make_unique< CodeDataLogger >( &cartridge, &emulator.GetMemory() );
+            emulator.SetCodeDataLogger( codeDataLogger.get() );
+        }
+        else if ( strcmp( argv[ i ], "--profile" ) == 0 )
+        {
+            profileFileName = argv[ i + 1 ];
+            cycleProfiler = std::make_unique< CycleProfiler >( &cartridge, &emulator.GetMemory() );
+            emulator.SetCycleProfiler( cycleProfiler.get() );
+        }
+        else if ( strcmp( argv[ i ], "--wav" ) == 0 )
+        {
+            if ( !wavWriter.TryOpen( argv[ i + 1 ], Audio::SAMPLE_RATE, 1 ) )
+            {
+                std::cout << "The audio dump " << argv[ i + 1 ] << " couldn't be created";
+                return -1;
+            }
+        }
+    }
+
+    if ( isRenderPipelineUsed )
+    {
+        /* The pipeline draws from its own snapshots and never goes through the NTSC filter */
+        if ( ntscFilter != nullptr )
+        {
+            std::cout << "The NTSC filter can't be combined with --scale, --upscaler or --post-process";
+            return -1;
+        }
+
+        if ( !Upscaler::IsScaleSupported( upscalerFilter, renderScale ) )
+        {
+            std::cout << "The " << Upscaler::FilterString[ static_cast< u32 >( upscalerFilter ) ] << " upscaler doesn't support a scale of " << renderScale;
+            return -1;
+        }
+
+        const u32 threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+        renderPipeline = std::make_unique< RenderPipeline >( threadCount, upscalerFilter, renderScale, postProcess );
+        emulator.GetVideo().SetRenderPipeline( renderPipeline.get() );
+    }
+
+    const u32 frameWidth = ( renderPipeline != nullptr ) ? renderPipeline->GetFrameWidth() : ( ntscFilter != nullptr ) ? NtscFilter::OUTPUT_WIDTH : Video::NES_VIDEO_WIDTH;
+    const u32 frameHeight = ( renderPipeline != nullptr ) ? renderPipeline->GetFrameHeight() : Video::NES_VIDEO_HEIGHT;
+
+    if ( sharedMemoryName != nullptr )
+    {
+        static constexpr u32 SHARED_FRAME_SLOTS = 8;
+        framePublisher = std::make_unique< SharedFramePublisher >( sharedMemoryName, SHARED_FRAME_SLOTS, frameWidth, frameHeight, Emulator::RAM_SIZE );
+        if ( !framePublisher->IsOpen() )
+        {
+            std::cout << "The shared memory " << sharedMemoryName << " couldn't be created";
+            return -1;
+        }
+    }
+
+    if ( captureFileName != nullptr )
+    {
+        const std::string audioFileName = std::string( captureFileName ) + ".wav";
+        frameRecorder = std::make_unique< FrameRecorder >( frameWidth, frameHeight );
+        if ( !frameRecorder->TryOpen( captureFormat, captureFileName, audioFileName.c_str() ) )
+        {
+            std::cout << "The capture " << captureFileName << " couldn't be created";
+            return -1;
+        }
+    }
+
+    Debugger debugger( &emulator.GetCpu(), &emulator.GetMemory(), &emulator.GetVideo() );
+    debugger.SetCodeDataLogger( codeDataLogger.get() );
+    debugger.SetCycleProfiler( cycleProfiler.get() );
+    debugger.SetMemoryHeatmap( memoryHeatmap.get() );
     debugger.StartDebugger();
 
     bool quit = false;
-    u32 currentCycles = 0;
     while ( !quit )
     {
-        currentCycles += cpu.Update();
-        video.Update( currentCycles );
+        const u32 currentCycles = emulator.StepInstruction();
+        if ( emulator.IsFrameCompleted() )
+        {
+            /* The RGB frame is only converted from the palette indices once it is complete, the pipeline finishes the frame it was just given */
+            const RGB *frameBuffer = nullptr;
+            if ( renderPipeline != nullptr )
+            {
+                renderPipeline->Flush();
+                frameBuffer = renderPipeline->GetFrame();
+            }
+            else
+            {
+                frameBuffer = ( ntscFilter != nullptr ) ? ntscFilter->GetFrameBuffer() : emulator.GetVideo().GetFrameBuffer();
+            }
+            if ( framePublisher != nullptr )
+            {
+                framePublisher->Publish( frameBuffer, emulator.GetRam() );
+            }
+
+            if ( wavWriter.IsOpen() || frameRecorder != nullptr )
+            {
+                i16 samples[ FrameRecorder::MAX_FRAME_SAMPLES ];
+                const u32 sampleCount = emulator.GetAudio().ReadSamples( samples, FrameRecorder::MAX_FRAME_SAMPLES );
+                if ( wavWriter.IsOpen() )
+                {
+                    wavWriter.Write( samples, sampleCount );
+                }
+
+                if ( frameRecorder != nullptr )
+                {
+                    frameRecorder->Push( frameBuffer, samples, sampleCount );
+                }
+            }
+        }
 
         const DebuggerUpdateResult result = debugger.Update( 0.f, currentCycles );
         switch ( result )
@@ -55,10 +291,25 @@ int main(int argc, char** argv)
             case DebuggerUpdateResult::RESET:
             {
                 debugger.ResetDebugger();
-                memory.Reset();
-                video.Reset();
-                cpu.Reset();
-                currentCycles = 0;
+                emulator.Reset();
+                if ( tracer != nullptr )
+                {
+                    tracer->Clear();
+                }
+
+                /* The shadow call stack of the profiler doesn't survive a reset, the other logs restart with it */
+                if ( codeDataLogger != nullptr )
+                {
+                    codeDataLogger->Clear();
+                }
+                if ( cycleProfiler != nullptr )
+                {
+                    cycleProfiler->Clear();
+                }
+                if ( memoryHeatmap != nullptr )
+                {
+                    memoryHeatmap->Clear();
+                }
             }
             break;
 
@@ -68,11 +319,27 @@ int main(int argc, char** argv)
                 // Nothing to do here
             }
         }
+    }
 
-        if ( currentCycles >= AVERAGE_CYCLES_PER_FRAME )
-        {
-            currentCycles = 0;
-        }
+    if ( frameRecorder != nullptr && !frameRecorder->Close() )
+    {
+        std::cout << "The capture couldn't be written to " << captureFileName;
+    }
+
+    if ( tracer != nullptr && !tracer->Dump( traceFileName ) )
+    {
+        std::cout << "The trace couldn't be written to " << traceFileName;
+    }
+
+    if ( codeDataLogger != nullptr && !codeDataLogger->Export( codeDataLogFileName ) )
+    {
+        std::cout << "The code/data log couldn't be written to " << codeDataLogFileName;
+    }
+
+    static constexpr u32 PROFILE_REPORT_ROWS = 32;
+    if ( cycleProfiler != nullptr && !cycleProfiler->WriteReport( profileFileName, PROFILE_REPORT_ROWS ) )
+    {
+        std::cout << "The profile couldn't be written to " << profileFileName;
     }
 
     return 0;